@@ -0,0 +1,676 @@
+#include "Distributed.h"
+#include "core/SceneFile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <vector>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const uint32_t kProtocolVersion = 2;
+static const uint32_t kMaxMessage = 1u << 30;
+
+enum MessageType : uint32_t {
+	kHello = 1,
+	kScene,
+	kReady,
+	kJob,
+	kPixels,
+	kFailed,
+	kFinished,
+};
+
+static bool fail(std::string *error, const std::string &message) {
+	if (error) *error = message;
+	return false;
+}
+
+//  Message bodies
+//
+
+struct MessageWriter {
+	std::string bytes;
+	
+	void put32(uint32_t v) {
+		for (int i = 0; i < 4; i++) bytes += char((v >> (8 * i)) & 0xff);
+	}
+	void put64(uint64_t v) { put32(uint32_t(v)); put32(uint32_t(v >> 32)); }
+	void putFloat(float f) {
+		uint32_t v;
+		memcpy(&v, &f, sizeof(v));
+		put32(v);
+	}
+	void putString(const std::string &s) { put32(uint32_t(s.size())); bytes += s; }
+};
+
+// Reading past the end of the body clears ok and returns zeros
+//
+struct MessageReader {
+	explicit MessageReader(const std::string &body) : p(reinterpret_cast<const unsigned char *>(body.data())), size(body.size()) {}
+	
+	uint32_t get32() {
+		if (size - at < 4) {
+			ok = false;
+			return 0;
+		}
+		uint32_t v = uint32_t(p[at]) | uint32_t(p[at + 1]) << 8 | uint32_t(p[at + 2]) << 16 | uint32_t(p[at + 3]) << 24;
+		at += 4;
+		return v;
+	}
+	uint64_t get64() {
+		uint64_t lo = get32();
+		return lo | uint64_t(get32()) << 32;
+	}
+	float getFloat() {
+		uint32_t v = get32();
+		float f;
+		memcpy(&f, &v, sizeof(f));
+		return f;
+	}
+	std::string getString() {
+		uint32_t n = get32();
+		if (!ok || n > size - at) {
+			ok = false;
+			return std::string();
+		}
+		std::string s(reinterpret_cast<const char *>(p) + at, n);
+		at += n;
+		return s;
+	}
+	
+	const unsigned char *p;
+	size_t size;
+	size_t at = 0;
+	bool ok = true;
+};
+
+static std::string message(uint32_t type, const std::string &body) {
+	MessageWriter m;
+	m.put32(type);
+	m.put32(uint32_t(body.size()));
+	return m.bytes + body;
+}
+
+// Everything but the thread count, which is each worker's own
+//
+static void putSettings(MessageWriter &m, const Renderer &r) {
+	m.put32(r.imageWidth);
+	m.put32(r.imageHeight);
+	m.putFloat(r.power);
+	m.put32(r.tileSize);
+	m.put32(r.usePackets);
+	m.put32(r.wavefront);
+	m.put32(r.antialias);
+	m.putFloat(r.aaThreshold);
+	m.put32(r.sampler.seed);
+	m.put32(r.shadows);
+	m.putFloat(r.lightCutoff);
+	m.put32(r.lightSamples);
+	m.put32(r.toneMap.curve);
+	m.putFloat(r.toneMap.exposure);
+	m.putFloat(r.toneMap.white);
+}
+
+static void getSettings(MessageReader &m, Renderer &r) {
+	r.imageWidth = int(m.get32());
+	r.imageHeight = int(m.get32());
+	r.power = m.getFloat();
+	r.tileSize = int(m.get32());
+	r.usePackets = m.get32() != 0;
+	r.wavefront = m.get32() != 0;
+	r.antialias = int(m.get32());
+	r.aaThreshold = m.getFloat();
+	r.sampler.seed = m.get32();
+	r.shadows = m.get32() != 0;
+	r.lightCutoff = m.getFloat();
+	r.lightSamples = int(m.get32());
+	r.toneMap.curve = m.get32() == ToneMap::kReinhard ? ToneMap::kReinhard : ToneMap::kClip;
+	r.toneMap.exposure = m.getFloat();
+	r.toneMap.white = m.getFloat();
+}
+
+//  Files and sockets
+//
+
+// A new, empty file for the scene to pass through on its way to or from the
+// wire; "" if none could be made
+//
+static std::string tempFile() {
+	const char *dir = getenv("TMPDIR");
+	std::string path = std::string(dir && *dir ? dir : "/tmp") + "/rtsceneXXXXXX";
+	std::vector<char> name(path.begin(), path.end());
+	name.push_back(0);
+	int fd = mkstemp(name.data());
+	if (fd < 0) return std::string();
+	close(fd);
+	return name.data();
+}
+
+static bool readFile(const std::string &path, std::string &bytes) {
+	FILE *f = fopen(path.c_str(), "rb");
+	if (!f) return false;
+	bytes.clear();
+	char buffer[65536];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) bytes.append(buffer, n);
+	bool ok = !ferror(f);
+	fclose(f);
+	return ok;
+}
+
+static bool writeFile(const std::string &path, const std::string &bytes) {
+	FILE *f = fopen(path.c_str(), "wb");
+	if (!f) return false;
+	bool ok = fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+	return fclose(f) == 0 && ok;
+}
+
+// Jobs and pixels are small messages that are waited on; don't let Nagle's
+// algorithm hold them back
+//
+static void setNoDelay(int fd) {
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+// Listens on both IPv6 and IPv4 where the system allows, and on IPv4 alone
+// otherwise.  Port 0 is replaced with the one the system picked.
+//
+static int listenOn(int &port, std::string *error) {
+	int fd = socket(AF_INET6, SOCK_STREAM, 0);
+	bool v6 = fd >= 0;
+	if (!v6) fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		fail(error, std::string("could not open a socket: ") + strerror(errno));
+		return -1;
+	}
+	int one = 1, zero = 0;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	
+	sockaddr_storage addr;
+	memset(&addr, 0, sizeof(addr));
+	socklen_t length;
+	if (v6) {
+		setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+		sockaddr_in6 *a = reinterpret_cast<sockaddr_in6 *>(&addr);
+		a->sin6_family = AF_INET6;
+		a->sin6_addr = in6addr_any;
+		a->sin6_port = htons(uint16_t(port));
+		length = sizeof(*a);
+	}
+	else {
+		sockaddr_in *a = reinterpret_cast<sockaddr_in *>(&addr);
+		a->sin_family = AF_INET;
+		a->sin_addr.s_addr = htonl(INADDR_ANY);
+		a->sin_port = htons(uint16_t(port));
+		length = sizeof(*a);
+	}
+	if (bind(fd, reinterpret_cast<sockaddr *>(&addr), length) != 0 || listen(fd, 64) != 0) {
+		fail(error, "could not listen on port " + std::to_string(port) + ": " + strerror(errno));
+		close(fd);
+		return -1;
+	}
+	getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &length);
+	port = ntohs(v6 ? reinterpret_cast<sockaddr_in6 *>(&addr)->sin6_port : reinterpret_cast<sockaddr_in *>(&addr)->sin_port);
+	return fd;
+}
+
+static int connectTo(const std::string &host, const std::string &port) {
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo *found = nullptr;
+	if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0) return -1;
+	int fd = -1;
+	for (addrinfo *a = found; a && fd < 0; a = a->ai_next) {
+		fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+			close(fd);
+			fd = -1;
+		}
+	}
+	freeaddrinfo(found);
+	return fd;
+}
+
+static std::string peerName(const sockaddr_storage &addr, socklen_t length) {
+	char host[NI_MAXHOST], port[NI_MAXSERV];
+	if (getnameinfo(reinterpret_cast<const sockaddr *>(&addr), length, host, sizeof(host), port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV) != 0) {
+		return "?";
+	}
+	std::string name = host;
+	if (name.compare(0, 7, "::ffff:") == 0) name = name.substr(7);    // IPv4 through the IPv6 socket
+	return name + ":" + port;
+}
+
+static bool sendAll(int fd, const std::string &bytes) {
+	size_t sent = 0;
+	while (sent < bytes.size()) {
+		ssize_t n = send(fd, bytes.data() + sent, bytes.size() - sent, 0);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		sent += size_t(n);
+	}
+	return true;
+}
+
+static bool receiveAll(int fd, char *data, size_t size) {
+	size_t got = 0;
+	while (got < size) {
+		ssize_t n = recv(fd, data + got, size - got, 0);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		got += size_t(n);
+	}
+	return true;
+}
+
+// Reads the header at the start of bytes, which must hold at least 8
+//
+static bool readHeader(const std::string &bytes, uint32_t &type, uint32_t &length) {
+	MessageReader m(bytes);
+	type = m.get32();
+	length = m.get32();
+	return length <= kMaxMessage;
+}
+
+static bool receiveMessage(int fd, uint32_t &type, std::string &body) {
+	std::string header(8, '\0');
+	uint32_t length;
+	if (!receiveAll(fd, &header[0], header.size()) || !readHeader(header, type, length)) return false;
+	body.resize(length);
+	return length == 0 || receiveAll(fd, &body[0], length);
+}
+
+//  Coordinator
+//
+
+struct Peer {
+	int fd;
+	std::string name;
+	std::string in, out;      // bytes received and not yet handled, bytes waiting to go
+	bool ready = false;       // has the scene loaded
+	bool gone = false;        // has hung up; what it sent before is still handled
+	std::vector<int> jobs;    // sent and not yet returned
+};
+
+static int64_t nowMs() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// One thread serves every worker: sockets are non-blocking, and poll() says
+// which to read and write.  Each worker's incoming bytes are split into
+// messages as they arrive and outgoing ones queue in Peer::out.
+//
+//--------------------------------------------------------------
+bool Coordinator::render(Renderer &renderer, FrameBuffer &frame, std::string *error) {
+	signal(SIGPIPE, SIG_IGN);
+	
+	std::string scenePath = tempFile();
+	if (scenePath.empty()) return fail(error, "could not create a temporary file");
+	std::string sceneBytes;
+	bool saved = saveScene(renderer.scene, renderer.renderCam, scenePath, error);
+	if (saved && !readFile(scenePath, sceneBytes)) saved = fail(error, "could not read back " + scenePath);
+	remove(scenePath.c_str());
+	if (!saved) return false;
+	MessageWriter scene;
+	putSettings(scene, renderer);
+	scene.putString(sceneBytes);
+	std::string sceneMessage = message(kScene, scene.bytes);
+	
+	renderer.prepare();
+	uint64_t print = renderer.fingerprint();
+	
+	int listener = listenOn(port, error);
+	if (listener < 0) return false;
+	fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK);
+	fprintf(stderr, "coordinator listening on port %d\n", port);
+	
+	// local workers share out this machine's cores
+	std::vector<pid_t> children;
+	std::string address = "127.0.0.1:" + std::to_string(port);
+	std::string threads = std::to_string(std::max(1, ThreadPool::hardwareThreads() / std::max(1, spawn)));
+	for (int i = 0; i < spawn; i++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			close(listener);
+			execlp(program.c_str(), program.c_str(), "--worker", address.c_str(), "--threads", threads.c_str(), (char *)nullptr);
+			_exit(127);
+		}
+		if (pid > 0) children.push_back(pid);
+	}
+	
+	std::vector<Tile> jobs = makeTiles(renderer.imageWidth, renderer.imageHeight, std::max(1, jobSize));
+	std::vector<char> done(jobs.size(), 0);
+	std::vector<int> copies(jobs.size(), 0);       // workers holding each job
+	std::vector<int64_t> issued(jobs.size(), 0);   // when each was last sent
+	std::deque<int> pending;
+	for (size_t j = 0; j < jobs.size(); j++) pending.push_back(int(j));
+	size_t finished = 0;
+	long long traced = 0;
+	int copied = 0, reissued = 0;
+	std::vector<Peer> peers;
+	frame.allocate(renderer.imageWidth, renderer.imageHeight);
+	
+	auto fill = [&](Peer &peer) {
+		while (peer.ready && !peer.gone && peer.jobs.size() < size_t(kPipeline)) {
+			int job = -1;
+			if (!pending.empty()) {
+				job = pending.front();
+				pending.pop_front();
+			}
+			else {
+				// everything is out: copy the job that has been out longest
+				for (size_t j = 0; j < jobs.size(); j++) {
+					if (done[j] || copies[j] >= 2 || std::find(peer.jobs.begin(), peer.jobs.end(), int(j)) != peer.jobs.end()) continue;
+					if (job < 0 || issued[j] < issued[job]) job = int(j);
+				}
+				if (job < 0) return;
+				copied++;
+			}
+			copies[job]++;
+			issued[job] = nowMs();
+			peer.jobs.push_back(job);
+			
+			const Tile &t = jobs[job];
+			MessageWriter m;
+			m.put32(uint32_t(job));
+			m.put32(t.x0);
+			m.put32(t.y0);
+			m.put32(t.x1);
+			m.put32(t.y1);
+			peer.out += message(kJob, m.bytes);
+		}
+	};
+	
+	// false if the worker should be dropped
+	auto handle = [&](Peer &peer, uint32_t type, const std::string &body) {
+		MessageReader m(body);
+		if (type == kHello) {
+			uint32_t version = m.get32();
+			uint32_t count = m.get32();
+			if (!m.ok || version != kProtocolVersion) {
+				fprintf(stderr, "worker %s speaks a different protocol; turned away\n", peer.name.c_str());
+				return false;
+			}
+			fprintf(stderr, "worker %s joined, %u threads\n", peer.name.c_str(), count);
+			peer.out += sceneMessage;
+			return true;
+		}
+		if (type == kReady) {
+			uint64_t theirs = m.get64();
+			if (!m.ok || theirs != print) {
+				fprintf(stderr, "worker %s loaded a different scene (are its texture and mesh files the same?); turned away\n", peer.name.c_str());
+				return false;
+			}
+			peer.ready = true;
+			fill(peer);
+			return true;
+		}
+		if (type == kPixels) {
+			uint32_t job = m.get32();
+			uint64_t samples = m.get64();
+			std::vector<int>::iterator held = std::find(peer.jobs.begin(), peer.jobs.end(), int(job));
+			if (!m.ok || held == peer.jobs.end()) return false;
+			const Tile &t = jobs[job];
+			if (m.size - m.at != size_t(t.width()) * t.height() * 12) return false;
+			peer.jobs.erase(held);
+			copies[job]--;
+			if (!done[job]) {
+				// the job's rows, top first, in the frame's rows, top first
+				int top = renderer.imageHeight - t.y1;
+				for (int y = 0; y < t.height(); y++) {
+					for (int x = t.x0; x < t.x1; x++) {
+						float r = m.getFloat(), g = m.getFloat(), b = m.getFloat();
+						frame.setColor(x, top + y, glm::vec3(r, g, b));
+					}
+				}
+				done[job] = 1;
+				finished++;
+				traced += (long long)samples;
+			}
+			fill(peer);
+			return true;
+		}
+		if (type == kFailed) {
+			std::string reason = m.getString();
+			fprintf(stderr, "worker %s failed: %s\n", peer.name.c_str(), reason.c_str());
+			return false;
+		}
+		return false;
+	};
+	
+	// false if the worker should be dropped.  Messages that came in before it
+	// hung up are still handled, so pixels it sent just before leaving count.
+	auto receive = [&](Peer &peer) {
+		char buffer[65536];
+		for (;;) {
+			ssize_t n = recv(peer.fd, buffer, sizeof(buffer), 0);
+			if (n > 0) {
+				peer.in.append(buffer, size_t(n));
+				continue;
+			}
+			if (n < 0 && errno == EINTR) continue;
+			if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+			peer.gone = true;
+			break;
+		}
+		size_t used = 0;
+		uint32_t type, length;
+		while (peer.in.size() - used >= 8) {
+			if (!readHeader(peer.in.substr(used, 8), type, length)) return false;
+			if (peer.in.size() - used - 8 < length) break;
+			bool ok = handle(peer, type, peer.in.substr(used + 8, length));
+			used += 8 + size_t(length);
+			if (!ok) return false;
+		}
+		peer.in.erase(0, used);
+		return !peer.gone;
+	};
+	
+	auto flush = [&](Peer &peer) {
+		while (!peer.out.empty()) {
+			ssize_t n = send(peer.fd, peer.out.data(), peer.out.size(), 0);
+			if (n < 0 && errno == EINTR) continue;
+			if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+			if (n <= 0) return false;
+			peer.out.erase(0, size_t(n));
+		}
+		return true;
+	};
+	
+	auto drop = [&](size_t p) {
+		Peer &peer = peers[p];
+		int lost = 0;
+		for (size_t i = 0; i < peer.jobs.size(); i++) {
+			int job = peer.jobs[i];
+			if (--copies[job] == 0 && !done[job]) {
+				pending.push_front(job);
+				lost++;
+			}
+		}
+		reissued += lost;
+		if (finished < jobs.size()) {
+			if (lost) fprintf(stderr, "worker %s left; re-issuing %d jobs\n", peer.name.c_str(), lost);
+			else fprintf(stderr, "worker %s left\n", peer.name.c_str());
+		}
+		close(peer.fd);
+		peers.erase(peers.begin() + p);
+	};
+	
+	bool ok = true;
+	std::vector<pollfd> fds;
+	while (finished < jobs.size()) {
+		fds.resize(peers.size() + 1);
+		fds[0].fd = listener;
+		fds[0].events = POLLIN;
+		for (size_t p = 0; p < peers.size(); p++) {
+			fds[p + 1].fd = peers[p].fd;
+			fds[p + 1].events = short(POLLIN | (peers[p].out.empty() ? 0 : POLLOUT));
+		}
+		if (poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR) {
+			ok = fail(error, std::string("poll failed: ") + strerror(errno));
+			break;
+		}
+		
+		// backwards, so that dropping a worker doesn't move the ones still to do
+		for (size_t p = peers.size(); p-- > 0;) {
+			short events = fds[p + 1].revents;
+			bool alive = true;
+			if (events & (POLLIN | POLLHUP | POLLERR)) alive = receive(peers[p]);
+			if (alive && (events & POLLOUT)) alive = flush(peers[p]);
+			if (!alive) drop(p);
+		}
+		// jobs handed back by a worker that left go to whoever has room
+		for (size_t p = 0; p < peers.size(); p++) fill(peers[p]);
+		
+		if (fds[0].revents & POLLIN) {
+			sockaddr_storage addr;
+			socklen_t length = sizeof(addr);
+			int fd;
+			while ((fd = accept(listener, reinterpret_cast<sockaddr *>(&addr), &length)) >= 0) {
+				fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+				setNoDelay(fd);
+				Peer peer;
+				peer.fd = fd;
+				peer.name = peerName(addr, length);
+				peers.push_back(peer);
+				length = sizeof(addr);
+			}
+		}
+		
+		// local workers that all died before finishing would leave us waiting forever
+		for (size_t c = children.size(); c-- > 0;) {
+			if (waitpid(children[c], nullptr, WNOHANG) == children[c]) children.erase(children.begin() + c);
+		}
+		if (spawn > 0 && children.empty() && peers.empty()) {
+			ok = fail(error, "all workers exited before the frame was finished");
+			break;
+		}
+	}
+	
+	for (size_t p = 0; p < peers.size(); p++) {
+		fcntl(peers[p].fd, F_SETFL, fcntl(peers[p].fd, F_GETFL) & ~O_NONBLOCK);
+		sendAll(peers[p].fd, peers[p].out + message(kFinished, std::string()));
+		close(peers[p].fd);
+	}
+	close(listener);
+	// connected workers have been told to stop; the rest have nothing to do
+	for (size_t c = 0; c < children.size(); c++) {
+		kill(children[c], SIGTERM);
+		waitpid(children[c], nullptr, 0);
+	}
+	if (!ok) return false;
+	
+	if (reissued || copied) fprintf(stderr, "%d jobs re-issued after workers left, %d copied to idle workers\n", reissued, copied);
+	renderer.samplesPerPixel = float(double(traced) / (double(renderer.imageWidth) * renderer.imageHeight));
+	return true;
+}
+
+//  Worker
+//
+
+//--------------------------------------------------------------
+bool runWorker(const std::string &address, int threads, std::string *error) {
+	size_t colon = address.rfind(':');
+	if (colon == std::string::npos) return fail(error, "worker address must be host:port");
+	std::string host = address.substr(0, colon), port = address.substr(colon + 1);
+	if (host.size() > 2 && host[0] == '[' && host[host.size() - 1] == ']') host = host.substr(1, host.size() - 2);
+	signal(SIGPIPE, SIG_IGN);
+	
+	// the coordinator may still be starting up
+	int fd = -1;
+	for (int attempt = 0; attempt < 300 && fd < 0; attempt++) {
+		fd = connectTo(host, port);
+		if (fd < 0) usleep(100000);
+	}
+	if (fd < 0) return fail(error, "could not connect to " + address);
+	setNoDelay(fd);
+	
+	Scene scene;
+	RenderCam cam;
+	Renderer renderer(scene, cam);
+	renderer.numThreads = threads;
+	bool loaded = false;
+	
+	MessageWriter hello;
+	hello.put32(kProtocolVersion);
+	hello.put32(uint32_t(threads > 0 ? threads : ThreadPool::hardwareThreads()));
+	bool ok = sendAll(fd, message(kHello, hello.bytes));
+	uint32_t type;
+	std::string body;
+	while (ok) {
+		if (!receiveMessage(fd, type, body)) {
+			ok = fail(error, "lost the connection to " + address);
+			break;
+		}
+		MessageReader m(body);
+		if (type == kFinished) break;
+		
+		if (type == kScene && !loaded) {
+			getSettings(m, renderer);
+			std::string bytes = m.getString();
+			std::string path = tempFile(), reason;
+			if (!m.ok || renderer.imageWidth <= 0 || renderer.imageHeight <= 0 || renderer.tileSize <= 0) reason = "bad scene message";
+			else if (path.empty() || !writeFile(path, bytes)) reason = "could not write a temporary scene file";
+			else loaded = loadScene(scene, cam, path, &reason);
+			if (!path.empty()) remove(path.c_str());
+			if (!loaded) {
+				MessageWriter f;
+				f.putString(reason);
+				sendAll(fd, message(kFailed, f.bytes));
+				ok = fail(error, reason);
+				break;
+			}
+			renderer.prepare();
+			MessageWriter r;
+			r.put64(renderer.fingerprint());
+			ok = sendAll(fd, message(kReady, r.bytes));
+		}
+		else if (type == kJob && loaded) {
+			uint32_t job = m.get32();
+			Tile region;
+			region.x0 = int(m.get32());
+			region.y0 = int(m.get32());
+			region.x1 = int(m.get32());
+			region.y1 = int(m.get32());
+			if (!m.ok || region.x0 < 0 || region.y0 < 0 || region.x1 > renderer.imageWidth || region.y1 > renderer.imageHeight ||
+				region.width() <= 0 || region.height() <= 0) {
+				ok = fail(error, "bad job from " + address);
+				break;
+			}
+			FrameBuffer pixels(region.width(), region.height());
+			long long traced = renderer.renderRegion(pixels, region);
+			
+			MessageWriter r;
+			r.bytes.reserve(12 + size_t(region.width()) * region.height() * 12);
+			r.put32(job);
+			r.put64(uint64_t(traced));
+			for (int y = 0; y < pixels.getHeight(); y++) {
+				const glm::vec3 *row = pixels.getRow(y);
+				for (int x = 0; x < pixels.getWidth(); x++) {
+					r.putFloat(row[x].x);
+					r.putFloat(row[x].y);
+					r.putFloat(row[x].z);
+				}
+			}
+			ok = sendAll(fd, message(kPixels, r.bytes));
+		}
+		else ok = fail(error, "unexpected message from " + address);
+	}
+	close(fd);
+	return ok;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include "core/Renderer.h"
+
+//  Distributed rendering: one frame traced by several worker processes, on
+//  this machine or others.
+//
+//  The coordinator listens on a TCP port.  Each worker that connects is sent
+//  the render settings and the scene (as a binary scene file), loads it once,
+//  and answers with the fingerprint of what it loaded (see
+//  Renderer::fingerprint()).  Textures and meshes go by file name, so
+//  workers must run where the same names lead to the same files: the same
+//  directory on a shared file system, or a copy of it.  The fingerprint
+//  takes in the texels of every texture and the triangles of every mesh, so
+//  a worker that found different files under those names, or older copies,
+//  doesn't match the coordinator's and is turned away.
+//
+//  The frame is split into jobs of jobSize x jobSize pixels.  Each worker is
+//  kept kPipeline jobs ahead, so it never waits on the network between jobs;
+//  it traces each job with renderRegion() on all its threads and sends back
+//  the float pixels.  The coordinator tone maps the whole frame at the end,
+//  so the image is the same bit for bit as one rendered in a single process.
+//
+//  Jobs held by a worker that disconnects or dies are handed to the others.
+//  Once no job is left unissued, idle workers are also given copies of the
+//  jobs that have been out longest, so a hung or slow machine can't hold up
+//  the end of the frame; whichever copy comes back first is used.
+//
+//  Messages are a type and a byte length, then the body, all little endian:
+//
+//      kHello      worker:      protocol version, thread count
+//      kScene      coordinator: render settings, then the scene file
+//      kReady      worker:      fingerprint
+//      kJob        coordinator: job number, region (as in Tile)
+//      kPixels     worker:      job number, samples traced, RGB floats, top row first
+//      kFailed     worker:      error message
+//      kFinished   coordinator: no more jobs
+//
+class Coordinator {
+public:
+	static const int kPipeline = 2;    // jobs sent to a worker before it has finished any
+	
+	int port = 7878;     // 0 picks any free port
+	int jobSize = 128;
+	int spawn = 0;       // local worker processes to start
+	std::string program; // this program, which spawned workers run with --worker
+	
+	// Renders renderer's scene into frame, returning once every job is back
+	bool render(Renderer &renderer, FrameBuffer &frame, std::string *error = nullptr);
+};
+
+// Connects to the coordinator at host:port, retrying for a while if it isn't
+// up yet, and traces jobs until it is told to stop.  threads is as in
+// Renderer::numThreads.
+//
+bool runWorker(const std::string &address, int threads, std::string *error = nullptr);
@@ -0,0 +1,288 @@
+/*
+ Benchmarks for the tracing core: micro-benchmarks of the basic operations
+ and end-to-end renders of generated scenes.  Build with "make bench" in this
+ directory.
+ 
+ Results go to stdout as JSON, one object per line, so runs can be compared
+ by script across releases; progress goes to stderr.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <sys/resource.h>
+#include "core/Scene.h"
+#include "core/Renderer.h"
+
+static void usage(const char *prog) {
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  --micro            run only the micro-benchmarks\n"
+		"  --render           run only the end-to-end renders\n"
+		"  --quick            fewer iterations and smaller scenes, for a smoke test\n"
+		"  --threads <n>      render threads, 0 = one per core (default 0)\n"
+		"  --repeat <n>       runs per benchmark; the fastest is reported (default 5\n"
+		"                     for micro-benchmarks, 1 for renders)\n"
+		"  --filter <text>    only run benchmarks whose name contains text\n"
+		"  --depth-first      render without the wavefront mode\n",
+		prog);
+}
+
+//--------------------------------------------------------------
+static double now() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Peak resident memory of the process so far, in KB
+//
+static long peakMemoryKB() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return long(usage.ru_maxrss / 1024);    // bytes on macOS
+#else
+	return long(usage.ru_maxrss);
+#endif
+}
+
+// Keeps results alive so the compiler can't drop the work that made them
+//
+static volatile float sink;
+
+//  Micro-benchmarks
+//
+
+struct MicroContext {
+	std::vector<Ray> rays;
+	std::vector<glm::vec2> uv;
+	std::vector<glm::vec3> points, normals;
+};
+
+// Runs body(iterations) repeat times and reports the fastest
+//
+template<class Body>
+static void micro(const char *name, const std::string &filter, long iterations, int repeat, Body body) {
+	if (!filter.empty() && std::string(name).find(filter) == std::string::npos) return;
+	double best = 1e30;
+	for (int r = 0; r < repeat; r++) {
+		double start = now();
+		sink = body(iterations);
+		best = std::min(best, now() - start);
+	}
+	double ns = best * 1e9 / iterations;
+	printf("{\"type\":\"micro\",\"name\":\"%s\",\"iterations\":%ld,\"ns_per_op\":%.3f,\"ops_per_s\":%.0f}\n",
+		name, iterations, ns, iterations / best);
+	fflush(stdout);
+	fprintf(stderr, "%-24s %10.2f ns/op\n", name, ns);
+}
+
+//--------------------------------------------------------------
+static void runMicro(const std::string &filter, bool quick, int repeat) {
+	const int kInputs = 4096;    // power of two, indexed with a mask
+	long n = quick ? 200000 : 4000000;
+	
+	Scene scene;
+	buildDefaultScene(scene);
+	RenderCam cam;
+	Renderer renderer(scene, cam);
+	renderer.imageWidth = 1200;
+	renderer.imageHeight = 800;
+	
+	Image image(512, 512);
+	for (int y = 0; y < 512; y++) {
+		for (int x = 0; x < 512; x++) image.setColor(x, y, Color(x / 2, y / 2, (x ^ y) & 255));
+	}
+	scene.textures.add(image);
+	renderer.prepare();
+	const Texture &texture = renderer.renderScene.textures->get(scene.textures.handle(0));
+	
+	// inputs: camera rays over the view, and points on the middle sphere
+	MicroContext c;
+	uint32_t state = 12345;
+	auto random = [&]() {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	};
+	for (int i = 0; i < kInputs; i++) {
+		glm::vec2 uv(random(), random());
+		c.uv.push_back(uv);
+		c.rays.push_back(cam.getRay(uv.x, uv.y));
+		glm::vec3 d = glm::normalize(glm::vec3(random() - 0.5f, random() - 0.5f, random()));
+		c.normals.push_back(d);
+		c.points.push_back(glm::vec3(0, 0, 2) + 2.0f * d);
+	}
+	
+	SceneObject *sphere = scene.objects[1];
+	SceneObject *plane = scene.objects[0];
+	
+	micro("sphere_intersect", filter, n, repeat, [&](long count) {
+		float sum = 0;
+		glm::vec3 p, nrm;
+		for (long i = 0; i < count; i++) {
+			if (sphere->intersect(c.rays[i & (kInputs - 1)], p, nrm)) sum += p.z;
+		}
+		return sum;
+	});
+	micro("plane_intersect", filter, n, repeat, [&](long count) {
+		float sum = 0;
+		glm::vec3 p, nrm;
+		for (long i = 0; i < count; i++) {
+			if (plane->intersect(c.rays[i & (kInputs - 1)], p, nrm)) sum += p.z;
+		}
+		return sum;
+	});
+	micro("get_ray", filter, n, repeat, [&](long count) {
+		float sum = 0;
+		for (long i = 0; i < count; i++) {
+			const glm::vec2 &uv = c.uv[i & (kInputs - 1)];
+			sum += cam.getRay(uv.x, uv.y).d.x;
+		}
+		return sum;
+	});
+	std::vector<Ray> packet(kSimdWidth, c.rays[0]);
+	micro("camera_rays", filter, n, repeat, [&](long count) {
+		float sum = 0;
+		for (long i = 0; i < count; i += kSimdWidth) {
+			renderer.cameraRays.generate(renderer.sampler, &c.uv[i & (kInputs - 1)], kSimdWidth, &packet[0]);
+			sum += packet[0].d.x;
+		}
+		return sum;
+	});
+	micro("scene_intersect", filter, n, repeat, [&](long count) {
+		float sum = 0;
+		Hit hit;
+		for (long i = 0; i < count; i++) {
+			if (renderer.renderScene.intersect(c.rays[i & (kInputs - 1)], hit)) sum += hit.t;
+		}
+		return sum;
+	});
+	micro("scene_intersect_packet", filter, n / kSimdWidth, repeat, [&](long count) {
+		float sum = 0;
+		Hit hits[kSimdWidth];
+		for (long i = 0; i < count; i++) {
+			int base = int(i * kSimdWidth) & (kInputs - 1);
+			sum += renderer.renderScene.intersect(&c.rays[base], kSimdWidth, hits);
+		}
+		return sum;
+	});
+	for (int shadows = 0; shadows < 2; shadows++) {
+		renderer.shadows = shadows != 0;
+		micro(shadows ? "phong_shadows" : "phong", filter, n / 4, repeat, [&](long count) {
+			float sum = 0;
+			for (long i = 0; i < count; i++) {
+				int k = int(i & (kInputs - 1));
+				sum += renderer.phong(c.points[k], c.normals[k], toFloat(Color::orangeRed), glm::vec3(1), 30).x;
+			}
+			return sum;
+		});
+	}
+	micro("texture_lookup", filter, n, repeat, [&](long count) {
+		float sum = 0;
+		for (long i = 0; i < count; i++) {
+			const glm::vec2 &uv = c.uv[i & (kInputs - 1)];
+			sum += renderer.textureLookup(texture, uv.x, uv.y).y;
+		}
+		return sum;
+	});
+}
+
+//  End-to-end renders
+//
+
+struct RenderCase {
+	int spheres, lights, width, height;
+	int lightSamples;    // as in Renderer; 0 = every light
+};
+
+//--------------------------------------------------------------
+static void runRenders(const std::string &filter, bool quick, int repeat, int threads, bool wavefront) {
+	const RenderCase full[] = {
+		{ 1, 1, 320, 240 }, { 1, 4, 1280, 720 },
+		{ 100, 4, 640, 480 }, { 100, 32, 640, 480 },
+		{ 10000, 4, 1280, 720 }, { 10000, 32, 640, 480 },
+		{ 1000000, 1, 640, 480 }, { 1000000, 4, 1280, 720 },
+		{ 100, 1000, 640, 480, 4 }, { 100, 10000, 640, 480, 4 },
+	};
+	const RenderCase small[] = {
+		{ 1, 1, 160, 120 }, { 100, 4, 320, 240 }, { 10000, 4, 320, 240 }, { 100000, 1, 320, 240 },
+	};
+	const RenderCase *cases = quick ? small : full;
+	int count = quick ? int(sizeof(small) / sizeof(small[0])) : int(sizeof(full) / sizeof(full[0]));
+	
+	// smallest first, so that each peak memory reading belongs to its case
+	for (int k = 0; k < count; k++) {
+		const RenderCase &rc = cases[k];
+		char name[96];
+		snprintf(name, sizeof(name), "spheres%d_lights%d_%dx%d", rc.spheres, rc.lights, rc.width, rc.height);
+		if (rc.lightSamples > 0) snprintf(name + strlen(name), sizeof(name) - strlen(name), "_sampled%d", rc.lightSamples);
+		if (!filter.empty() && std::string(name).find(filter) == std::string::npos) continue;
+		
+		double start = now();
+		Scene scene;
+		buildRandomScene(scene, rc.spheres, rc.lights);
+		scene.rebuildAccel();
+		RenderCam cam;
+		Renderer renderer(scene, cam);
+		renderer.imageWidth = rc.width;
+		renderer.imageHeight = rc.height;
+		renderer.numThreads = threads;
+		renderer.wavefront = wavefront;
+		renderer.lightSamples = rc.lightSamples;
+		double buildTime = now() - start;
+		
+		start = now();
+		renderer.prepare();
+		double prepareTime = now() - start;
+		
+		Image image;
+		double best = 1e30;
+		for (int r = 0; r < repeat; r++) {
+			start = now();
+			renderer.render(image);
+			best = std::min(best, now() - start);
+		}
+		
+		// render() takes its own snapshot of the scene; leave that out of the ray rate
+		double traceTime = std::max(best - prepareTime, 1e-9);
+		double rays = double(renderer.samplesPerPixel) * rc.width * rc.height;
+		printf("{\"type\":\"render\",\"name\":\"%s\",\"wavefront\":%s,\"spheres\":%d,\"lights\":%d,\"light_samples\":%d,\"width\":%d,\"height\":%d,"
+			"\"build_s\":%.4f,\"prepare_s\":%.4f,\"render_s\":%.4f,\"primary_rays\":%.0f,\"rays_per_s\":%.0f,"
+			"\"ns_per_ray\":%.2f,\"peak_rss_kb\":%ld}\n",
+			name, wavefront ? "true" : "false", rc.spheres, rc.lights, rc.lightSamples, rc.width, rc.height, buildTime, prepareTime, best, rays,
+			rays / traceTime, traceTime * 1e9 / rays, peakMemoryKB());
+		fflush(stdout);
+		fprintf(stderr, "%-36s %8.3f s %10.0f rays/s\n", name, best, rays / traceTime);
+	}
+}
+
+//========================================================================
+int main(int argc, char **argv) {
+	bool micro = true, render = true, quick = false, wavefront = true;
+	int threads = 0, repeat = 0;
+	std::string filter;
+	
+	for (int a = 1; a < argc; a++) {
+		std::string arg = argv[a];
+		bool hasValue = a + 1 < argc;
+		if (arg == "--micro") render = false;
+		else if (arg == "--render") micro = false;
+		else if (arg == "--quick") quick = true;
+		else if (arg == "--threads" && hasValue) threads = atoi(argv[++a]);
+		else if (arg == "--repeat" && hasValue) repeat = atoi(argv[++a]);
+		else if (arg == "--filter" && hasValue) filter = argv[++a];
+		else if (arg == "--depth-first") wavefront = false;
+		else {
+			usage(argv[0]);
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+	
+	printf("{\"type\":\"info\",\"simd_width\":%d,\"threads\":%d,\"compiler\":\"%s\"}\n",
+		kSimdWidth, threads > 0 ? threads : ThreadPool::hardwareThreads(), __VERSION__);
+	if (micro) runMicro(filter, quick, repeat > 0 ? repeat : 5);
+	if (render) runRenders(filter, quick, repeat > 0 ? repeat : 1, threads, wavefront);
+	return 0;
+}
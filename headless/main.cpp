@@ -0,0 +1,319 @@
+/*
+ Headless renderer: traces a scene straight to an image file, with no window or
+ GL context.  Build with the Makefile in this directory.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <chrono>
+#include "core/Scene.h"
+#include "core/Renderer.h"
+#include "core/SceneFile.h"
+#include "core/ImageStream.h"
+#include "core/SequenceRenderer.h"
+#include "Distributed.h"
+
+static void usage(const char *prog) {
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -o <file>          output image, .png or .ppm (default out.png); for a\n"
+		"                     sequence, the last run of # is the frame number\n"
+		"  --stream           write the image band by band as it is rendered, instead of\n"
+		"                     holding it all in memory; -o must be .ppm or .pfm\n"
+		"  --resume           like --stream, but carry on from where an interrupted\n"
+		"                     render of the same scene to the same file stopped\n"
+		"  -w <pixels>        image width (default 1200)\n"
+		"  -h <pixels>        image height (default 800)\n"
+		"  --power <p>        Blinn-Phong exponent (default 30)\n"
+		"  --threads <n>      render threads, 0 = one per core (default 0)\n"
+		"  --no-packets       trace one ray at a time instead of SIMD packets\n"
+		"  --depth-first      trace and shade each ray in turn, instead of a tile's rays\n"
+		"                     in stages (hits, then shading, then shadow rays)\n"
+		"  --no-shadows       light every point from every light\n"
+		"  --light-cutoff <c> skip lights adding less than c (0 - 255) to a point\n"
+		"                     (default 1: only lights that add nothing)\n"
+		"  --light-samples <n> shade each point from n lights picked at random, as\n"
+		"                     area lights with soft shadows (default 0: every light)\n"
+		"  --aa <n>           antialiasing: up to n x n samples per pixel (default 1)\n"
+		"  --aa-threshold <t> refine pixels whose samples differ by more than t, 0 - 1;\n"
+		"                     0 samples every pixel n x n (default 0.04)\n"
+		"  --seed <n>         seed for sample positions (default 0)\n"
+		"  --exposure <e>     scale colors by e before tone mapping (default 1)\n"
+		"  --reinhard <w>     tone map with extended Reinhard, w mapping to white,\n"
+		"                     instead of clipping at full scale\n"
+		"  --texture <file>   texture the next sphere of the scene (binary PPM); may\n"
+		"                     be repeated\n"
+		"  --mesh <file>      add a triangle mesh (.obj or binary .ply), in its own\n"
+		"                     coordinates; may be repeated\n"
+		"  --instances <n> <file> scatter n copies of a mesh over the ground, each\n"
+		"                     placed, turned, sized and colored at random\n"
+		"  --scene <file>     replace the default scene with a scene file (binary or text)\n"
+		"  --random <n> <l>   replace it with n random spheres and l lights instead\n"
+		"  --save-scene <file> save the scene, as text if the name ends in .txt\n"
+		"  --look-at <x y z> <x y z> move the camera to the first point, looking at the\n"
+		"                     second\n"
+		"  --fov <degrees>    vertical field of view of the camera\n"
+		"  --lens <a> <f>     thin lens of radius a focused at distance f, for depth of\n"
+		"                     field (default: a pinhole)\n"
+		"  --animate <file>   render the frames of an animation file (keyframes of\n"
+		"                     objects, lights and the camera) to numbered images\n"
+		"  --turntable <n>    render n frames of the camera circling the scene\n"
+		"  --frames <a> <b>   render only frames a to b of the sequence\n"
+		"  --stats            write <output>_trace.json (Chrome trace of the tiles, with\n"
+		"                     ray and intersection counts) and <output>_heatmap.png (time\n"
+		"                     per tile); needs rayTracerHeadlessStats, built with make STATS=1\n"
+		"  --coordinator <port> render with worker processes, which connect on port\n"
+		"                     (0 = any free port)\n"
+		"  --spawn <n>        start n workers on this machine too (implies --coordinator)\n"
+		"  --job-size <pixels> size of the square jobs handed to workers (default 128)\n"
+		"  --worker <host:port> trace jobs for the coordinator at host:port; it sends the\n"
+		"                     scene and settings, so only --threads applies\n",
+		prog);
+}
+
+//========================================================================
+int main(int argc, char **argv) {
+	std::string outPath = "out.png";
+	Scene scene;
+	RenderCam renderCam;
+	Renderer renderer(scene, renderCam);
+	renderer.imageWidth = 1200;
+	renderer.imageHeight = 800;
+	
+	buildDefaultScene(scene);
+	size_t textured = 0;    // where to look for the next sphere to texture
+	std::string savePath;
+	bool stream = false, resume = false, writeStats = false;
+	Coordinator coordinator;
+	coordinator.program = argv[0];
+	bool distributed = false;
+	std::string workerAddress;
+	Animation animation;
+	int turntable = 0, firstFrame = 0, lastFrame = -1;
+	
+	for (int a = 1; a < argc; a++) {
+		std::string arg = argv[a];
+		bool hasValue = a + 1 < argc;
+		if (arg == "-o" && hasValue) outPath = argv[++a];
+		else if (arg == "--stream") stream = true;
+		else if (arg == "--resume") stream = resume = true;
+		else if (arg == "-w" && hasValue) renderer.imageWidth = atoi(argv[++a]);
+		else if (arg == "-h" && hasValue) renderer.imageHeight = atoi(argv[++a]);
+		else if (arg == "--power" && hasValue) renderer.power = atof(argv[++a]);
+		else if (arg == "--threads" && hasValue) renderer.numThreads = atoi(argv[++a]);
+		else if (arg == "--no-packets") renderer.usePackets = false;
+		else if (arg == "--depth-first") renderer.wavefront = false;
+		else if (arg == "--no-shadows") renderer.shadows = false;
+		else if (arg == "--light-cutoff" && hasValue) renderer.lightCutoff = atof(argv[++a]);
+		else if (arg == "--light-samples" && hasValue) renderer.lightSamples = atoi(argv[++a]);
+		else if (arg == "--aa" && hasValue) renderer.antialias = atoi(argv[++a]);
+		else if (arg == "--aa-threshold" && hasValue) renderer.aaThreshold = atof(argv[++a]);
+		else if (arg == "--seed" && hasValue) renderer.sampler.seed = uint32_t(strtoul(argv[++a], nullptr, 10));
+		else if (arg == "--exposure" && hasValue) renderer.toneMap.exposure = atof(argv[++a]);
+		else if (arg == "--reinhard" && hasValue) {
+			renderer.toneMap.curve = ToneMap::kReinhard;
+			renderer.toneMap.white = atof(argv[++a]);
+		}
+		else if (arg == "--texture" && hasValue) {
+			Image texture;
+			if (!texture.load(argv[++a])) {
+				fprintf(stderr, "could not load texture %s\n", argv[a]);
+				return 1;
+			}
+			// the first texture goes on the first sphere, and so on
+			while (textured < scene.objects.size() && !dynamic_cast<Sphere *>(scene.objects[textured])) textured++;
+			if (textured < scene.objects.size()) scene.objects[textured++]->texture = scene.textures.add(texture, argv[a]);
+		}
+		else if (arg == "--scene" && hasValue) {
+			std::string error;
+			auto start = std::chrono::steady_clock::now();
+			if (!loadScene(scene, renderCam, argv[++a], &error)) {
+				fprintf(stderr, "%s\n", error.c_str());
+				return 1;
+			}
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			fprintf(stderr, "loaded %s: %zu objects, %zu lights in %.3f s\n", argv[a], scene.objects.size(),
+				scene.lights.size(), elapsed.count());
+			textured = 0;
+		}
+		else if (arg == "--random" && a + 2 < argc) {
+			scene.clearObjects();
+			buildRandomScene(scene, atoi(argv[a + 1]), atoi(argv[a + 2]));
+			a += 2;
+			textured = 0;
+		}
+		else if (arg == "--save-scene" && hasValue) savePath = argv[++a];
+		else if (arg == "--look-at" && a + 6 < argc) {
+			glm::vec3 eye(atof(argv[a + 1]), atof(argv[a + 2]), atof(argv[a + 3]));
+			glm::vec3 target(atof(argv[a + 4]), atof(argv[a + 5]), atof(argv[a + 6]));
+			renderCam.lookAt(eye, target);
+			a += 6;
+		}
+		else if (arg == "--fov" && hasValue) renderCam.setFov(atof(argv[++a]));
+		else if (arg == "--lens" && a + 2 < argc) {
+			renderCam.aperture = atof(argv[a + 1]);
+			renderCam.focusDistance = atof(argv[a + 2]);
+			a += 2;
+		}
+		else if (arg == "--animate" && hasValue) {
+			std::string error;
+			if (!animation.load(argv[++a], &error)) {
+				fprintf(stderr, "%s\n", error.c_str());
+				return 1;
+			}
+		}
+		else if (arg == "--turntable" && hasValue) turntable = atoi(argv[++a]);
+		else if (arg == "--frames" && a + 2 < argc) {
+			firstFrame = atoi(argv[a + 1]);
+			lastFrame = atoi(argv[a + 2]);
+			a += 2;
+		}
+		else if (arg == "--stats") writeStats = true;
+		else if (arg == "--coordinator" && hasValue) {
+			coordinator.port = atoi(argv[++a]);
+			distributed = true;
+		}
+		else if (arg == "--spawn" && hasValue) {
+			coordinator.spawn = atoi(argv[++a]);
+			distributed = true;
+		}
+		else if (arg == "--job-size" && hasValue) coordinator.jobSize = atoi(argv[++a]);
+		else if (arg == "--worker" && hasValue) workerAddress = argv[++a];
+		else if (arg == "--mesh" && hasValue) {
+			std::string error;
+			auto start = std::chrono::steady_clock::now();
+			Mesh *mesh = scene.addMesh(argv[++a], glm::vec3(0, 0, 0), Color::grey, &error);
+			if (!mesh) {
+				fprintf(stderr, "%s\n", error.c_str());
+				return 1;
+			}
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			fprintf(stderr, "loaded %s: %zu triangles in %.3f s\n", argv[a], mesh->triangleCount(), elapsed.count());
+		}
+		else if (arg == "--instances" && a + 2 < argc) {
+			std::string error;
+			Mesh *mesh = new Mesh();
+			if (!mesh->load(argv[a + 2], &error)) {
+				delete mesh;
+				fprintf(stderr, "%s\n", error.c_str());
+				return 1;
+			}
+			int count = atoi(argv[a + 1]);
+			scatterInstances(scene, scene.addPrototype(mesh), count);
+			fprintf(stderr, "%d instances of %s: %zu triangles each\n", count, argv[a + 2], mesh->triangleCount());
+			a += 2;
+		}
+		else {
+			usage(argv[0]);
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+	if (!workerAddress.empty()) {
+		std::string error;
+		if (!runWorker(workerAddress, renderer.numThreads, &error)) {
+			fprintf(stderr, "worker: %s\n", error.c_str());
+			return 1;
+		}
+		return 0;
+	}
+	if (renderer.imageWidth <= 0 || renderer.imageHeight <= 0) {
+		fprintf(stderr, "image size must be positive\n");
+		return 1;
+	}
+	if (renderer.toneMap.white <= 0) {
+		fprintf(stderr, "the Reinhard white point must be positive\n");
+		return 1;
+	}
+#ifndef RAYTRACER_STATS
+	if (writeStats) {
+		fprintf(stderr, "--stats needs rayTracerHeadlessStats, built with make STATS=1\n");
+		return 1;
+	}
+#endif
+	if (distributed && (stream || writeStats)) {
+		fprintf(stderr, "--stream and --stats don't work with --coordinator\n");
+		return 1;
+	}
+	if (turntable > 0) animation.addTurntable(renderCam, turntable);
+	bool sequence = !animation.empty();
+	if (sequence && (stream || writeStats || distributed)) {
+		fprintf(stderr, "--stream, --stats and --coordinator don't work with sequences\n");
+		return 1;
+	}
+	if (sequence && outPath.size() >= 4 && outPath.compare(outPath.size() - 4, 4, ".pfm") == 0) {
+		fprintf(stderr, "sequences are written as .png or .ppm\n");
+		return 1;
+	}
+	if (stream && !ImageStream::supports(outPath)) {
+		fprintf(stderr, "can only stream to .ppm or .pfm files\n");
+		return 1;
+	}
+	
+	if (!savePath.empty()) {
+		std::string error;
+		if (!saveScene(scene, renderCam, savePath, &error)) {
+			fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+	}
+	
+	if (sequence) {
+		SequenceRenderer frames(renderer, animation);
+		frames.firstFrame = firstFrame;
+		frames.lastFrame = lastFrame;
+		std::string error;
+		auto start = std::chrono::steady_clock::now();
+		if (!frames.render(outPath, &error)) {
+			fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		int count = (lastFrame < 0 ? animation.frames - 1 : lastFrame) - firstFrame + 1;
+		fprintf(stderr, "rendered %d frames of %dx%d in %.3f s: %.3f s tracing, %.3f s between frames, %d rebuilt, "
+			"%.2f samples per pixel\n", count, renderer.imageWidth, renderer.imageHeight, elapsed.count(), frames.traceSeconds,
+			frames.waitSeconds, frames.rebuilds, renderer.samplesPerPixel);
+		return 0;
+	}
+	
+	Image image;
+	auto start = std::chrono::steady_clock::now();
+	if (stream) {
+		std::string error;
+		if (!renderer.renderToFile(outPath, resume, &error)) {
+			fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+	}
+	else if (distributed) {
+		FrameBuffer frame;
+		std::string error;
+		if (!coordinator.render(renderer, frame, &error)) {
+			fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+		renderer.toneMap.apply(frame, image);
+	}
+	else renderer.render(image);
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	fprintf(stderr, "rendered %dx%d in %.3f s, %.2f samples per pixel\n", renderer.imageWidth, renderer.imageHeight,
+		elapsed.count(), renderer.samplesPerPixel);
+	if (!stream && !image.save(outPath)) {
+		fprintf(stderr, "could not write %s\n", outPath.c_str());
+		return 1;
+	}
+	if (writeStats) {
+		StatCounters c = renderer.stats.totals();
+		fprintf(stderr, "%llu primary rays, %llu shadow rays, %llu BVH nodes, %llu primitive tests, %llu shaded\n",
+			(unsigned long long)c.primaryRays, (unsigned long long)c.shadowRays, (unsigned long long)c.nodeVisits,
+			(unsigned long long)c.primitiveTests, (unsigned long long)c.shadeCalls);
+		size_t dot = outPath.rfind('.'), slash = outPath.find_last_of("/\\");
+		std::string base = dot != std::string::npos && (slash == std::string::npos || dot > slash) ? outPath.substr(0, dot) : outPath;
+		if (!renderer.stats.save(base)) {
+			fprintf(stderr, "could not write %s_trace.json\n", base.c_str());
+			return 1;
+		}
+	}
+	return 0;
+}
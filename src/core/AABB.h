@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cfloat>
+#include "VecMath.h"
+
+//  Axis-aligned bounding box
+//
+class AABB {
+public:
+	AABB() : min(FLT_MAX), max(-FLT_MAX) {}    // empty box; growing it by anything gives that thing
+	AABB(glm::vec3 min, glm::vec3 max) : min(min), max(max) {}
+	
+	void grow(const glm::vec3 &p) { min = glm::min(min, p); max = glm::max(max, p); }
+	void grow(const AABB &b) { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+	
+	bool empty() const { return min.x > max.x; }
+	bool contains(const glm::vec3 &p) const {
+		return p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y && p.z >= min.z && p.z <= max.z;
+	}
+	glm::vec3 center() const { return (min + max) * 0.5f; }
+	glm::vec3 extent() const { return max - min; }
+	
+	float area() const {
+		if (empty()) return 0;
+		glm::vec3 e = extent();
+		return 2 * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+	
+	// Slab test.  invDir is 1 / ray direction, precomputed once per ray.  On a
+	// hit tNear is where the ray enters the box (0 if it starts inside).
+	//
+	bool intersect(const glm::vec3 &origin, const glm::vec3 &invDir, float tMax, float &tNear) const {
+		float t0 = 0, t1 = tMax;
+		for (int a = 0; a < 3; a++) {
+			float tA = (min[a] - origin[a]) * invDir[a];
+			float tB = (max[a] - origin[a]) * invDir[a];
+			if (tA > tB) std::swap(tA, tB);
+			t0 = tA > t0 ? tA : t0;
+			t1 = tB < t1 ? tB : t1;
+			if (t0 > t1) return false;
+		}
+		tNear = t0;
+		return true;
+	}
+	
+	glm::vec3 min, max;
+};
@@ -0,0 +1,239 @@
+#include "Animation.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+static const unsigned kAnimationFileVersion = 1;
+
+static bool fail(std::string *error, const std::string &message) {
+	if (error) *error = message;
+	return false;
+}
+
+// Linear between the keys either side of frame
+//
+//--------------------------------------------------------------
+glm::vec3 Animation::Track::at(float frame) const {
+	if (keys.empty()) return glm::vec3(0);
+	if (frame <= keys.front().frame) return keys.front().value;
+	if (frame >= keys.back().frame) return keys.back().value;
+	std::vector<Key>::const_iterator next = std::upper_bound(keys.begin(), keys.end(), frame, [](float f, const Key &k) {
+		return f < k.frame;
+	});
+	const Key &a = *(next - 1), &b = *next;
+	float s = (frame - a.frame) / (b.frame - a.frame);
+	return a.value + (b.value - a.value) * s;
+}
+
+// A key at the frame of an existing one replaces it
+//
+//--------------------------------------------------------------
+void Animation::addKey(Target target, int index, Channel channel, float frame, const glm::vec3 &value) {
+	if (target == kCamera) index = 0;
+	Track *track = nullptr;
+	for (size_t i = 0; i < tracks.size() && !track; i++) {
+		if (tracks[i].target == target && tracks[i].index == index && tracks[i].channel == channel) track = &tracks[i];
+	}
+	if (!track) {
+		tracks.push_back(Track());
+		track = &tracks.back();
+		track->target = target;
+		track->index = index;
+		track->channel = channel;
+	}
+	Key key = { frame, value };
+	std::vector<Key>::iterator at = std::lower_bound(track->keys.begin(), track->keys.end(), frame, [](const Key &k, float f) {
+		return k.frame < f;
+	});
+	if (at != track->keys.end() && at->frame == frame) *at = key;
+	else track->keys.insert(at, key);
+	frames = std::max(frames, int(std::floor(frame)) + 1);
+}
+
+// The camera circles the vertical line through the point of its aim nearest
+// the y axis, keyed at every frame so that the path stays round.  The last
+// frame stops one step short of where the first one is, so the sequence
+// loops.
+//
+//--------------------------------------------------------------
+void Animation::addTurntable(const RenderCam &cam, int count) {
+	glm::vec3 target = cam.position + cam.aim;
+	glm::vec3 pivot(0, cam.position.y, 0);
+	float across = cam.aim.x * cam.aim.x + cam.aim.z * cam.aim.z;
+	if (across > 0) {
+		float s = -(cam.position.x * cam.aim.x + cam.position.z * cam.aim.z) / across;
+		pivot = cam.position + cam.aim * s;
+		target = pivot;
+	}
+	for (int k = 0; k < count; k++) {
+		Transform turn = Transform::translate(pivot) * Transform::rotate(6.28318531f * k / count, glm::vec3(0, 1, 0)) *
+			Transform::translate(-pivot);
+		addKey(kCamera, 0, kPosition, float(k), turn.point(cam.position));
+		addKey(kCamera, 0, kLookAt, float(k), turn.point(target));
+	}
+}
+
+// The camera's position and target are settled first and set together, then
+// its field of view
+//
+//--------------------------------------------------------------
+void Animation::apply(Scene &scene, RenderCam &cam, float frame) const {
+	glm::vec3 eye = cam.position, target = cam.position + cam.aim;
+	bool moveCamera = false, lookAt = false;
+	float fov = 0;
+	for (size_t i = 0; i < tracks.size(); i++) {
+		const Track &track = tracks[i];
+		glm::vec3 v = track.at(frame);
+		switch (track.target) {
+			case kObject: {
+				SceneObject *obj = scene.objects[track.index];
+				if (track.channel == kPosition) obj->position = v;
+				else if (track.channel == kRadius) obj->setRadius(v.x);
+				break;
+			}
+			case kLight: {
+				Light *light = scene.lights[track.index];
+				if (track.channel == kPosition) light->position = v;
+				else if (track.channel == kIntensity) light->setIntensity(v.x);
+				break;
+			}
+			case kInstance:
+				if (track.channel == kPosition) scene.instances[track.index].transform.t = v;
+				break;
+			case kCamera:
+				if (track.channel == kPosition) eye = v;
+				else if (track.channel == kLookAt) {
+					target = v;
+					lookAt = true;
+				}
+				else if (track.channel == kFov) fov = v.x;
+				moveCamera = true;
+				break;
+		}
+	}
+	if (!moveCamera) return;
+	if (!lookAt) target = eye + cam.aim;
+	cam.lookAt(eye, target, cam.up);
+	if (fov > 0) cam.setFov(fov);
+}
+
+// Each track has to have something to move, with the value it keys
+//
+//--------------------------------------------------------------
+bool Animation::check(const Scene &scene, std::string *error) const {
+	for (size_t i = 0; i < tracks.size(); i++) {
+		const Track &track = tracks[i];
+		std::string name = std::to_string(track.index);
+		bool ok = true;
+		switch (track.target) {
+			case kObject:
+				if (track.index < 0 || track.index >= int(scene.objects.size())) return fail(error, "there is no object " + name);
+				ok = track.channel == kPosition || (track.channel == kRadius && dynamic_cast<Sphere *>(scene.objects[track.index]));
+				name = "object " + name;
+				break;
+			case kLight:
+				if (track.index < 0 || track.index >= int(scene.lights.size())) return fail(error, "there is no light " + name);
+				ok = track.channel == kPosition || track.channel == kIntensity;
+				name = "light " + name;
+				break;
+			case kInstance:
+				if (track.index < 0 || track.index >= int(scene.instances.size())) return fail(error, "there is no instance " + name);
+				ok = track.channel == kPosition;
+				name = "instance " + name;
+				break;
+			case kCamera:
+				ok = track.channel == kPosition || track.channel == kLookAt || track.channel == kFov;
+				name = "the camera";
+				break;
+		}
+		if (!ok) return fail(error, name + " can't be animated that way");
+	}
+	return true;
+}
+
+// RenderScene copies spheres and planes, and refers to anything else
+//
+//--------------------------------------------------------------
+bool Animation::movesShared(const Scene &scene) const {
+	for (size_t i = 0; i < tracks.size(); i++) {
+		if (tracks[i].target != kObject) continue;
+		SceneObject *obj = scene.objects[tracks[i].index];
+		if (!dynamic_cast<Sphere *>(obj) && !dynamic_cast<Plane *>(obj)) return true;
+	}
+	return false;
+}
+
+//--------------------------------------------------------------
+bool Animation::load(const std::string &path, std::string *error) {
+	MappedFile file;
+	if (!file.open(path)) return fail(error, "could not open " + path);
+	
+	*this = Animation();
+	int declared = 0;    // frame count given in the file, if any
+	bool haveVersion = false;
+	int lineNumber = 0;
+	for (const char *p = file.data(); p < file.end(); ) {
+		const char *eol = static_cast<const char *>(memchr(p, '\n', file.end() - p));
+		if (!eol) eol = file.end();
+		std::string line(p, eol);
+		p = eol + 1;
+		lineNumber++;
+		
+		size_t comment = line.find('#');
+		if (comment != std::string::npos) line.erase(comment);
+		std::istringstream in(line);
+		std::string keyword;
+		if (!(in >> keyword)) continue;
+		std::string where = path + ":" + std::to_string(lineNumber) + ": ";
+		
+		if (!haveVersion) {
+			unsigned version;
+			if (keyword != "rtanim" || !(in >> version)) return fail(error, path + ": not an animation file");
+			if (version == 0 || version > kAnimationFileVersion) return fail(error, path + ": unsupported version " + std::to_string(version));
+			haveVersion = true;
+			continue;
+		}
+		
+		if (keyword == "frames") {
+			if (!(in >> declared) || declared < 1) return fail(error, where + "bad frame count");
+			continue;
+		}
+		if (keyword != "key") return fail(error, where + "unknown keyword " + keyword);
+		
+		float frame;
+		std::string target, channel;
+		int index = 0;
+		if (!(in >> frame >> target) || frame < 0) return fail(error, where + "bad key");
+		Target t;
+		if (target == "object") t = kObject;
+		else if (target == "light") t = kLight;
+		else if (target == "instance") t = kInstance;
+		else if (target == "camera") t = kCamera;
+		else return fail(error, where + "unknown target " + target);
+		if (t != kCamera && !(in >> index)) return fail(error, where + "bad key");
+		if (!(in >> channel)) return fail(error, where + "bad key");
+		
+		Channel c;
+		if (channel == "position") c = kPosition;
+		else if (channel == "target" && t == kCamera) c = kLookAt;
+		else if (channel == "radius") c = kRadius;
+		else if (channel == "intensity") c = kIntensity;
+		else if (channel == "fov" && t == kCamera) c = kFov;
+		else return fail(error, where + "unknown value " + channel);
+		int values = c == kPosition || c == kLookAt ? 3 : 1;
+		
+		glm::vec3 value(0);
+		for (int k = 0; k < values; k++) {
+			if (!(in >> value[k])) return fail(error, where + "bad " + channel);
+		}
+		std::string extra;
+		if (in >> extra) return fail(error, where + "unexpected " + extra);
+		addKey(t, index, c, frame, value);
+	}
+	if (!haveVersion) return fail(error, path + ": not an animation file");
+	if (declared > 0) frames = declared;
+	return true;
+}
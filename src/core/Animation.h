@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Scene.h"
+
+//  Keyframed changes to a scene and its camera, for rendering a sequence of
+//  frames (see SequenceRenderer).
+//
+//  A track moves one value of one thing: an object's position or radius, a
+//  light's position or intensity, an instance's position, or the camera's
+//  position, target (the point it looks at) or field of view.  Its keys give
+//  the value at some frames; in between it is interpolated linearly, and
+//  before the first key or after the last it holds.  apply() sets every
+//  track's value for a frame and leaves everything else as it was.  The
+//  camera keeps its aim when only its position is keyed.
+//
+//  Objects, lights and instances are given by their index in the scene's
+//  lists, which for a scene just loaded is their order in the file.  All
+//  of these are values RenderScene::refit() picks up, so frames after the
+//  first don't sort the scene again.
+//
+//  The text form has one key a line, with # starting a comment:
+//
+//      rtanim 1
+//      frames <n>
+//      key <frame> object <n> position <x y z>
+//      key <frame> object <n> radius <r>       spheres only
+//      key <frame> light <n> position <x y z>
+//      key <frame> light <n> intensity <i>
+//      key <frame> instance <n> position <x y z>
+//      key <frame> camera position <x y z>
+//      key <frame> camera target <x y z>
+//      key <frame> camera fov <degrees>
+//
+//  Frames are numbered from 0, and keys may fall between them.
+//
+class Animation {
+public:
+	enum Target { kObject, kLight, kInstance, kCamera };
+	enum Channel { kPosition, kRadius, kIntensity, kLookAt, kFov };
+	
+	struct Key {
+		float frame;
+		glm::vec3 value;    // only x for channels of one number
+	};
+	
+	struct Track {
+		Target target;
+		int index;    // into the scene's objects, lights or instances; 0 for the camera
+		Channel channel;
+		std::vector<Key> keys;    // in frame order
+		
+		glm::vec3 at(float frame) const;
+	};
+	
+	void addKey(Target target, int index, Channel channel, float frame, const glm::vec3 &value);
+	void addTurntable(const RenderCam &cam, int count);    // one turn of the camera about the vertical, over count frames
+	void apply(Scene &scene, RenderCam &cam, float frame) const;
+	bool check(const Scene &scene, std::string *error = nullptr) const;    // false if a track refers to something scene lacks
+	bool movesShared(const Scene &scene) const;    // moves objects RenderScene points to rather than copies
+	bool empty() const { return tracks.empty(); }
+	
+	bool load(const std::string &path, std::string *error = nullptr);
+	
+	std::vector<Track> tracks;
+	int frames = 1;
+};
@@ -0,0 +1,147 @@
+#include "BVH.h"
+
+#include <algorithm>
+
+static const int kBins = 16;
+static const int kMaxDepth = 48;    // keeps the traversal stack in closestHit() bounded
+
+//--------------------------------------------------------------
+void BVH::build(const std::vector<AABB> &bounds, int maxLeafSize) {
+	clear();
+	leafSize = maxLeafSize;
+	if (bounds.empty()) return;
+	
+	std::vector<glm::vec3> centers(bounds.size());
+	prims.resize(bounds.size());
+	for (size_t i = 0; i < bounds.size(); i++) {
+		centers[i] = bounds[i].center();
+		prims[i] = int(i);
+	}
+	nodes.reserve(2 * bounds.size());
+	buildNode(bounds, centers, 0, int(bounds.size()), 0);
+}
+
+// Builds the subtree over prims[start, end) and returns its node index.
+// Splits are chosen with the surface area heuristic, evaluated on kBins
+// equal-width bins of primitive centers along each axis.
+//
+int BVH::buildNode(const std::vector<AABB> &bounds, const std::vector<glm::vec3> &centers, int start, int end, int depth) {
+	int index = int(nodes.size());
+	nodes.push_back(Node());
+	
+	AABB box, centerBox;
+	for (int i = start; i < end; i++) {
+		box.grow(bounds[prims[i]]);
+		centerBox.grow(centers[prims[i]]);
+	}
+	nodes[index].box = box;
+	
+	int count = end - start;
+	if (count <= leafSize || depth >= kMaxDepth) {
+		nodes[index].start = start;
+		nodes[index].count = count;
+		return index;
+	}
+	
+	// find the cheapest split over all axes
+	int bestAxis = -1, bestBin = 0;
+	float bestCost = FLT_MAX;
+	glm::vec3 extent = centerBox.extent();
+	for (int axis = 0; axis < 3; axis++) {
+		if (extent[axis] <= 0) continue;
+		AABB binBox[kBins];
+		int binCount[kBins] = { 0 };
+		float scale = kBins / extent[axis];
+		for (int i = start; i < end; i++) {
+			int b = std::min(kBins - 1, int((centers[prims[i]][axis] - centerBox.min[axis]) * scale));
+			binBox[b].grow(bounds[prims[i]]);
+			binCount[b]++;
+		}
+		
+		// sweep from the right to get the cost of everything right of each plane
+		float rightArea[kBins];
+		int rightCount[kBins];
+		AABB acc;
+		int n = 0;
+		for (int b = kBins - 1; b > 0; b--) {
+			acc.grow(binBox[b]);
+			n += binCount[b];
+			rightArea[b] = acc.area();
+			rightCount[b] = n;
+		}
+		acc = AABB();
+		n = 0;
+		for (int b = 1; b < kBins; b++) {
+			acc.grow(binBox[b - 1]);
+			n += binCount[b - 1];
+			float cost = n * acc.area() + rightCount[b] * rightArea[b];
+			if (n > 0 && rightCount[b] > 0 && cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = b;
+			}
+		}
+	}
+	
+	// a leaf is cheaper than the best split (in units of one primitive test per
+	// unit of area), or all centers coincide
+	float leafCost = count * box.area();
+	if (bestAxis < 0 || (bestCost >= leafCost && count <= 2 * leafSize)) {
+		if (bestAxis < 0 && count > leafSize) {
+			// identical centers: split down the middle so leaves stay small
+			int mid = (start + end) / 2;
+			buildNode(bounds, centers, start, mid, depth + 1);
+			int right = buildNode(bounds, centers, mid, end, depth + 1);
+			nodes[index].start = right;
+			nodes[index].count = 0;
+			return index;
+		}
+		nodes[index].start = start;
+		nodes[index].count = count;
+		return index;
+	}
+	
+	float scale = kBins / extent[bestAxis];
+	float minC = centerBox.min[bestAxis];
+	int *mid = std::partition(&prims[start], &prims[0] + end, [&](int p) {
+		return std::min(kBins - 1, int((centers[p][bestAxis] - minC) * scale)) < bestBin;
+	});
+	int split = int(mid - &prims[0]);
+	
+	buildNode(bounds, centers, start, split, depth + 1);
+	int right = buildNode(bounds, centers, split, end, depth + 1);
+	nodes[index].start = right;
+	nodes[index].count = 0;
+	return index;
+}
+
+// Children come after their parent, so walking the nodes backwards updates
+// every child before the parent that encloses it.
+//
+void BVH::refit(const std::vector<AABB> &bounds) {
+	for (int n = int(nodes.size()) - 1; n >= 0; n--) {
+		Node &node = nodes[n];
+		AABB box;
+		if (node.count > 0) {
+			for (int i = node.start; i < node.start + node.count; i++) box.grow(bounds[prims[i]]);
+		}
+		else {
+			box.grow(nodes[n + 1].box);
+			box.grow(nodes[node.start].box);
+		}
+		node.box = box;
+	}
+}
+
+// The expected number of nodes visited and primitives tested by a ray that
+// crosses the root, if rays are spread evenly: each node is reached in
+// proportion to its area.  Moving primitives apart without changing the tree
+// makes boxes overlap, and this grows.
+//
+float BVH::cost() const {
+	if (nodes.empty()) return 0;
+	float sum = 0;
+	for (size_t n = 0; n < nodes.size(); n++) sum += nodes[n].box.area() * std::max(nodes[n].count, 1);
+	float root = nodes[0].box.area();
+	return root > 0 ? sum / root : 0;
+}
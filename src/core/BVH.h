@@ -0,0 +1,279 @@
+#pragma once
+
+#include <vector>
+#include "AABB.h"
+#include "Ray.h"
+#include "PacketIntersect.h"
+#include "RenderStats.h"
+
+//  Bounding volume hierarchy over a list of primitive bounding boxes.
+//
+//  The BVH only knows about boxes and primitive indices; what a primitive is
+//  and how to intersect it is up to the caller, which passes an intersect
+//  function to the queries.  That lets the same structure serve the renderer,
+//  picking in the app, and anything else that needs a spatial index.
+//
+//  build() uses binned SAH construction.  refit() recomputes the boxes for the
+//  same primitives after they have moved or changed size, keeping the tree
+//  topology; that is much cheaper than a rebuild but the tree gets worse the
+//  further things move, so call build() again after large edits or when
+//  primitives are added or removed.  cost() tells how far a refitted tree
+//  has fallen behind a fresh one.
+//
+class BVH {
+public:
+	void build(const std::vector<AABB> &bounds, int maxLeafSize = 4);
+	void refit(const std::vector<AABB> &bounds);
+	void clear() { nodes.clear(); prims.clear(); }
+	
+	bool empty() const { return nodes.empty(); }
+	int primitiveCount() const { return int(prims.size()); }
+	AABB bounds() const { return empty() ? AABB() : nodes[0].box; }
+	float cost() const;    // surface area heuristic cost, relative to the root's area
+	
+	// Finds the closest primitive along the ray.  intersect(prim, tMax) tests
+	// primitive prim and returns true only for a hit closer than tMax, in which
+	// case it also lowers tMax to the hit distance.  Returns true if anything
+	// was hit; tMax is then the distance to the closest hit.
+	//
+	template<class Intersect>
+	bool closestHit(const Ray &ray, float &tMax, Intersect intersect) const;
+	
+	// Same, but intersectLeaf(start, count, tMax) is called once per leaf with
+	// the leaf's range of prims.  Useful when the primitives have been stored in
+	// leaf order, so that a leaf can be tested as one contiguous block.
+	//
+	template<class IntersectLeaf>
+	bool closestHitLeaves(const Ray &ray, float &tMax, IntersectLeaf intersectLeaf) const;
+	
+	// Occlusion query: returns true as soon as any primitive is hit before
+	// tMax, without looking for the closest one.  intersect(prim, tMax) and
+	// intersectLeaf(start, count, tMax) are as above.
+	//
+	template<class Intersect>
+	bool anyHit(const Ray &ray, float tMax, Intersect intersect) const;
+	template<class IntersectLeaf>
+	bool anyHitLeaves(const Ray &ray, float tMax, IntersectLeaf intersectLeaf) const;
+	
+	// Calls visit(prim) for the primitives of every leaf whose box contains
+	// point.  The caller checks each one exactly.
+	//
+	template<class Visit>
+	void containing(const glm::vec3 &point, Visit visit) const;
+	
+	// Packet version: a node is visited while any lane still enters it before
+	// that lane's tMax.  intersect(prim, tMax) tests the primitive against the
+	// whole packet, lowering tMax for the lanes it hits.
+	//
+	template<class Intersect>
+	void closestHit(const RayPacket &rays, SimdFloat &tMax, Intersect intersect) const;
+	
+	// Packet occlusion query: intersect(prim, tMax) tests the primitive against
+	// the whole packet and returns the lanes it hits before their tMax.  Those
+	// lanes drop out, and the traversal ends once every lane has been
+	// blocked.  Returns the blocked lanes.
+	//
+	template<class Intersect>
+	SimdFloat anyHit(const RayPacket &rays, SimdFloat tMax, Intersect intersect) const;
+	
+	struct Node {
+		AABB box;
+		int start;    // leaf: first entry in prims; interior: index of the right child (left is the next node)
+		int count;    // leaf: number of primitives; 0 for interior nodes
+	};
+	
+	std::vector<Node> nodes;    // depth first, so children always come after their parent
+	std::vector<int> prims;     // primitive indices, grouped by leaf
+	
+private:
+	int leafSize = 4;
+	int buildNode(const std::vector<AABB> &bounds, const std::vector<glm::vec3> &centers, int start, int end, int depth);
+};
+
+//--------------------------------------------------------------
+template<class Intersect>
+bool BVH::closestHit(const Ray &ray, float &tMax, Intersect intersect) const {
+	return closestHitLeaves(ray, tMax, [&](int start, int count, float &t) {
+		bool hit = false;
+		for (int i = start; i < start + count; i++) {
+			if (intersect(prims[i], t)) hit = true;
+		}
+		return hit;
+	});
+}
+
+//--------------------------------------------------------------
+template<class IntersectLeaf>
+bool BVH::closestHitLeaves(const Ray &ray, float &tMax, IntersectLeaf intersectLeaf) const {
+	if (nodes.empty()) return false;
+	
+	glm::vec3 invDir = 1.0f / ray.d;
+	bool hit = false;
+	float tNear;
+	int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	
+	while (top > 0) {
+		const Node &node = nodes[stack[--top]];
+		RT_COUNT(nodeVisits, 1);
+		if (!node.box.intersect(ray.p, invDir, tMax, tNear)) continue;
+		
+		if (node.count > 0) {
+			if (intersectLeaf(node.start, node.count, tMax)) hit = true;
+			continue;
+		}
+		
+		// visit the nearer child first so that tMax shrinks early
+		int left = int(&node - &nodes[0]) + 1;
+		int right = node.start;
+		float tLeft, tRight;
+		bool hitLeft = nodes[left].box.intersect(ray.p, invDir, tMax, tLeft);
+		bool hitRight = nodes[right].box.intersect(ray.p, invDir, tMax, tRight);
+		if (hitLeft && hitRight) {
+			if (tLeft < tRight) std::swap(left, right);
+			stack[top++] = left;
+			stack[top++] = right;
+		}
+		else if (hitLeft) stack[top++] = left;
+		else if (hitRight) stack[top++] = right;
+	}
+	return hit;
+}
+
+//--------------------------------------------------------------
+template<class Intersect>
+bool BVH::anyHit(const Ray &ray, float tMax, Intersect intersect) const {
+	return anyHitLeaves(ray, tMax, [&](int start, int count, float &t) {
+		for (int i = start; i < start + count; i++) {
+			if (intersect(prims[i], t)) return true;
+		}
+		return false;
+	});
+}
+
+// Children are pushed in any order: the first hit ends the search, so there
+// is nothing to gain from visiting the nearer one first.
+//
+template<class IntersectLeaf>
+bool BVH::anyHitLeaves(const Ray &ray, float tMax, IntersectLeaf intersectLeaf) const {
+	if (nodes.empty()) return false;
+	
+	glm::vec3 invDir = 1.0f / ray.d;
+	int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	
+	while (top > 0) {
+		int index = stack[--top];
+		const Node &node = nodes[index];
+		RT_COUNT(nodeVisits, 1);
+		float tNear;
+		if (!node.box.intersect(ray.p, invDir, tMax, tNear)) continue;
+		
+		if (node.count > 0) {
+			float t = tMax;
+			if (intersectLeaf(node.start, node.count, t)) return true;
+			continue;
+		}
+		stack[top++] = node.start;
+		stack[top++] = index + 1;
+	}
+	return false;
+}
+
+//--------------------------------------------------------------
+template<class Visit>
+void BVH::containing(const glm::vec3 &point, Visit visit) const {
+	if (nodes.empty()) return;
+	
+	int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	
+	while (top > 0) {
+		int index = stack[--top];
+		const Node &node = nodes[index];
+		if (!node.box.contains(point)) continue;
+		
+		if (node.count > 0) {
+			for (int i = node.start; i < node.start + node.count; i++) visit(prims[i]);
+			continue;
+		}
+		stack[top++] = node.start;
+		stack[top++] = index + 1;
+	}
+}
+
+//--------------------------------------------------------------
+template<class Intersect>
+void BVH::closestHit(const RayPacket &rays, SimdFloat &tMax, Intersect intersect) const {
+	if (nodes.empty()) return;
+	
+	SimdFloat tNear;
+	int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	
+	while (top > 0) {
+		const Node &node = nodes[stack[--top]];
+		RT_COUNT(nodeVisits, 1);
+		if (moveMask(intersectBox(rays, node.box, tMax, tNear)) == 0) continue;
+		
+		if (node.count > 0) {
+			for (int i = node.start; i < node.start + node.count; i++) {
+				intersect(prims[i], tMax);
+			}
+			continue;
+		}
+		
+		// order the children by where the first ray (always active) enters them
+		int left = int(&node - &nodes[0]) + 1;
+		int right = node.start;
+		SimdFloat tLeft, tRight;
+		bool hitLeft = moveMask(intersectBox(rays, nodes[left].box, tMax, tLeft)) != 0;
+		bool hitRight = moveMask(intersectBox(rays, nodes[right].box, tMax, tRight)) != 0;
+		if (hitLeft && hitRight) {
+			if (tLeft[0] < tRight[0]) std::swap(left, right);
+			stack[top++] = left;
+			stack[top++] = right;
+		}
+		else if (hitLeft) stack[top++] = left;
+		else if (hitRight) stack[top++] = right;
+	}
+}
+
+//--------------------------------------------------------------
+template<class Intersect>
+SimdFloat BVH::anyHit(const RayPacket &rays, SimdFloat tMax, Intersect intersect) const {
+	SimdFloat blocked(0.0f);
+	if (nodes.empty()) return blocked;
+	
+	int all = moveMask(rays.active);
+	SimdFloat tNear;
+	int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	
+	while (top > 0) {
+		const Node &node = nodes[stack[--top]];
+		RT_COUNT(nodeVisits, 1);
+		if (moveMask(intersectBox(rays, node.box, tMax, tNear)) == 0) continue;
+		
+		if (node.count > 0) {
+			for (int i = node.start; i < node.start + node.count; i++) {
+				SimdFloat hit = intersect(prims[i], tMax);
+				if (moveMask(hit) == 0) continue;
+				
+				// a negative tMax keeps blocked lanes out of every box
+				blocked = blocked | hit;
+				tMax = select(hit, SimdFloat(-1.0f), tMax);
+				if (moveMask(blocked) == all) return blocked;
+			}
+			continue;
+		}
+		stack[top++] = node.start;
+		stack[top++] = int(&node - &nodes[0]) + 1;
+	}
+	return blocked;
+}
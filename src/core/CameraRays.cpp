@@ -0,0 +1,71 @@
+#include "CameraRays.h"
+
+#include <algorithm>
+#include <cmath>
+
+// The view point for (u, v) is the default camera's, relative to the
+// camera, turned onto the camera's basis (see RenderCam::toWorld())
+//
+//--------------------------------------------------------------
+void CameraRays::setup(RenderCam &cam) {
+	glm::vec3 right, top, forward;
+	cam.getBasis(right, top, forward);
+	ViewPlane &view = cam.view;
+	position = cam.position;
+	corner = right * (view.min.x - position.x) + top * (view.min.y - position.y) - forward * (view.position.z - position.z);
+	du = right * view.width();
+	dv = top * view.height();
+	lens = cam.aperture > 0;
+	lensU = right * cam.aperture;
+	lensV = top * cam.aperture;
+	float distance = cam.viewDistance();
+	focus = cam.focusDistance > 0 && distance > 0 ? cam.focusDistance / distance : 1;
+}
+
+// Lanes past count repeat the first ray and are thrown away
+//
+//--------------------------------------------------------------
+void CameraRays::generate(const Sampler &sampler, const glm::vec2 *uv, size_t count, Ray *rays) const {
+	float u[kSimdWidth], v[kSimdWidth];
+	float lx[kSimdWidth], ly[kSimdWidth], lz[kSimdWidth];
+	float dx[kSimdWidth], dy[kSimdWidth], dz[kSimdWidth];
+	for (size_t base = 0; base < count; base += kSimdWidth) {
+		int n = int(std::min(count - base, size_t(kSimdWidth)));
+		for (int k = 0; k < kSimdWidth; k++) {
+			const glm::vec2 &p = uv[base + (k < n ? k : 0)];
+			u[k] = p.x;
+			v[k] = p.y;
+		}
+		SimdFloat su = SimdFloat::load(u), sv = SimdFloat::load(v);
+		SimdFloat x = SimdFloat(corner.x) + su * SimdFloat(du.x) + sv * SimdFloat(dv.x);
+		SimdFloat y = SimdFloat(corner.y) + su * SimdFloat(du.y) + sv * SimdFloat(dv.y);
+		SimdFloat z = SimdFloat(corner.z) + su * SimdFloat(du.z) + sv * SimdFloat(dv.z);
+		
+		// from a point on the lens (uniform over its disk) to where the
+		// pinhole ray meets the focus plane
+		if (lens) {
+			for (int k = 0; k < kSimdWidth; k++) {
+				glm::vec2 s = sampler.get2D(Sampler::key(u[k], v[k]), 0, kLensSamples);
+				float r = std::sqrt(s.x);
+				float phi = 6.28318531f * s.y;
+				glm::vec3 offset = lensU * (r * std::cos(phi)) + lensV * (r * std::sin(phi));
+				lx[k] = offset.x;
+				ly[k] = offset.y;
+				lz[k] = offset.z;
+			}
+			SimdFloat f(focus);
+			x = x * f - SimdFloat::load(lx);
+			y = y * f - SimdFloat::load(ly);
+			z = z * f - SimdFloat::load(lz);
+		}
+		
+		SimdFloat scale = SimdFloat(1.0f) / sqrt(x * x + y * y + z * z);
+		(x * scale).store(dx);
+		(y * scale).store(dy);
+		(z * scale).store(dz);
+		for (int k = 0; k < n; k++) {
+			glm::vec3 origin = lens ? position + glm::vec3(lx[k], ly[k], lz[k]) : position;
+			rays[base + k] = Ray(origin, glm::vec3(dx[k], dy[k], dz[k]));
+		}
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "SceneObject.h"
+#include "Sampler.h"
+
+//  Primary ray generation for a frame, worked out once from a RenderCam.
+//
+//  setup() reduces the camera to its position, the direction to the view's
+//  corner and how that direction changes along u and v, so the direction
+//  through any image position is two multiply-adds per coordinate, whatever
+//  way the camera faces.  generate() makes rays kSimdWidth at a time and
+//  normalizes them together, one square root and divide per ray.
+//
+//  With a lens, each ray also starts at a point on the lens, from Sampler
+//  dimension kLensSamples keyed on its image position, and is aimed at the
+//  point its pinhole ray reaches at the focus distance.
+//
+//  Every ray is made the same way however many are asked for at once, so
+//  tracing a sample alone or in a batch gives the same ray to the bit.
+//
+class CameraRays {
+public:
+	void setup(RenderCam &cam);
+	void generate(const Sampler &sampler, const glm::vec2 *uv, size_t count, Ray *rays) const;
+	
+	glm::vec3 position;    // of the camera, at the lens center
+	
+private:
+	glm::vec3 corner;      // direction to the view at (0, 0), not normalized
+	glm::vec3 du, dv;      // its change from u = 0 to 1 and v = 0 to 1
+	glm::vec3 lensU, lensV;    // lens radius along the image's right and up; zero for a pinhole
+	float focus = 1;       // distance to the focus plane, in multiples of the view's
+	bool lens = false;
+};
@@ -0,0 +1,12 @@
+#include "Color.h"
+
+const Color Color::black(0, 0, 0);
+const Color Color::white(255, 255, 255);
+const Color Color::grey(128, 128, 128);
+const Color Color::lightGray(211, 211, 211);
+const Color Color::dimGrey(105, 105, 105);
+const Color Color::darkOrchid(153, 50, 204);
+const Color Color::orangeRed(255, 69, 0);
+const Color Color::cornflowerBlue(100, 149, 237);
+const Color Color::paleGreen(152, 251, 152);
+const Color Color::darkGoldenRod(184, 134, 11);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <algorithm>
+
+//  8-bit RGB color used by the tracing core for scene colors and image pixels.
+//  Shading is done in float color instead (see FrameBuffer.h).
+//
+//  This mirrors the arithmetic of ofColor (every operation clamps to [0, 255] and
+//  truncates back to unsigned char), as the app does its own color math with
+//  ofColor.
+//
+class Color {
+public:
+	Color() {}
+	Color(float r, float g, float b) : r(clampChannel(r)), g(clampChannel(g)), b(clampChannel(b)) {}
+	
+	Color operator+(const Color &c) const { return Color(float(r) + c.r, float(g) + c.g, float(b) + c.b); }
+	Color &operator+=(const Color &c) { *this = *this + c; return *this; }
+	Color operator*(float s) const { return Color(r * s, g * s, b * s); }
+	Color &operator*=(float s) { *this = *this * s; return *this; }
+	Color operator/(float s) const { return Color(r / s, g / s, b / s); }
+	bool operator==(const Color &c) const { return r == c.r && g == c.g && b == c.b; }
+	bool operator!=(const Color &c) const { return !(*this == c); }
+	
+	unsigned char r = 0, g = 0, b = 0;
+	
+	// the subset of ofColor's named colors the scene code uses
+	static const Color black, white, grey, lightGray, dimGrey;
+	static const Color darkOrchid, orangeRed, cornflowerBlue, paleGreen, darkGoldenRod;
+	
+private:
+	static unsigned char clampChannel(float v) {
+		return (unsigned char)std::min(std::max(v, 0.0f), 255.0f);
+	}
+};
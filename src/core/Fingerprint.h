@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "VecMath.h"
+
+//  FNV-1a hash of a run of values, for telling whether two renders would
+//  come out the same (see Renderer::fingerprint()).  Values are hashed as
+//  their bytes, so only plain data should go in.
+//
+struct Fingerprint {
+	uint64_t hash = 14695981039346656037ull;
+	
+	void add(const void *data, size_t bytes) {
+		const unsigned char *p = static_cast<const unsigned char *>(data);
+		for (size_t i = 0; i < bytes; i++) {
+			hash ^= p[i];
+			hash *= 1099511628211ull;
+		}
+	}
+	template<class T> void add(const T &value) { add(&value, sizeof(value)); }
+	void add(const glm::vec3 &v) { add(v.x); add(v.y); add(v.z); }
+	template<class T> void addArray(const std::vector<T> &v, size_t count) { add(v.data(), count * sizeof(T)); }
+};
@@ -0,0 +1,42 @@
+#include "FrameBuffer.h"
+
+#include <algorithm>
+
+//--------------------------------------------------------------
+void FrameBuffer::allocate(int w, int h) {
+	width = w;
+	height = h;
+	pixels.assign(size_t(w) * h, glm::vec3(0));
+}
+
+static inline glm::vec3 toneCurve(const ToneMap &t, const glm::vec3 &c) {
+	glm::vec3 v = glm::max(c * t.exposure, glm::vec3(0));
+	if (t.curve == ToneMap::kReinhard) {
+		v = v * (glm::vec3(1) + v * (1 / (t.white * t.white))) / (glm::vec3(1) + v);
+	}
+	return glm::min(v, glm::vec3(1)) * 255.0f + glm::vec3(0.5f);
+}
+
+//--------------------------------------------------------------
+Color ToneMap::apply(const glm::vec3 &c) const {
+	glm::vec3 v = toneCurve(*this, c);
+	return Color(v.x, v.y, v.z);
+}
+
+//--------------------------------------------------------------
+void ToneMap::apply(const glm::vec3 *in, int count, unsigned char *out) const {
+	for (int i = 0; i < count; i++) {
+		glm::vec3 v = toneCurve(*this, in[i]);
+		out[3 * i] = (unsigned char)v.x;
+		out[3 * i + 1] = (unsigned char)v.y;
+		out[3 * i + 2] = (unsigned char)v.z;
+	}
+}
+
+//--------------------------------------------------------------
+void ToneMap::apply(const FrameBuffer &in, Image &out) const {
+	out.allocate(in.getWidth(), in.getHeight());
+	for (int y = 0; y < in.getHeight(); y++) {
+		apply(in.getRow(y), in.getWidth(), out.getPixels() + size_t(y) * in.getWidth() * 3);
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include "VecMath.h"
+#include "Color.h"
+#include "Image.h"
+
+//  Linear float RGB image that the renderer shades and accumulates into.
+//
+//  Colors here are floats with 1 as full scale (255 in an 8-bit Color), and
+//  nothing is clamped: a pixel lit by several bright lights can go well over
+//  1.  The image is converted to 8 bits once, by a ToneMap, when it is
+//  written out.  Rows are stored from the top, like Image.
+//
+class FrameBuffer {
+public:
+	FrameBuffer() {}
+	FrameBuffer(int w, int h) { allocate(w, h); }
+	
+	void allocate(int w, int h);
+	
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	
+	const glm::vec3 &getColor(int x, int y) const { return pixels[size_t(y) * width + x]; }
+	void setColor(int x, int y, const glm::vec3 &c) { pixels[size_t(y) * width + x] = c; }
+	
+	const glm::vec3 *getRow(int y) const { return &pixels[size_t(y) * width]; }
+	
+private:
+	int width = 0;
+	int height = 0;
+	std::vector<glm::vec3> pixels;
+};
+
+// Scene colors (materials, lights) in the float scale of a FrameBuffer
+inline glm::vec3 toFloat(const Color &c) {
+	return glm::vec3(c.r, c.g, c.b) * (1.0f / 255);
+}
+
+//  Maps float colors to 8 bits.  Colors are scaled by exposure, then either
+//  clipped at 1 (kClip, which is how the renderer has always looked) or
+//  rolled off with extended Reinhard, c (1 + c / white^2) / (1 + c), which
+//  brings everything up to white down into range and keeps the detail in
+//  highlights.  The result is rounded to the nearest 8-bit value.
+//
+struct ToneMap {
+	enum Curve { kClip, kReinhard };
+	
+	Curve curve = kClip;
+	float exposure = 1;
+	float white = 4;    // kReinhard: the level that maps to full scale
+	
+	Color apply(const glm::vec3 &c) const;
+	void apply(const glm::vec3 *in, int count, unsigned char *out) const;    // count pixels, to packed RGB
+	void apply(const FrameBuffer &in, Image &out) const;
+};
@@ -0,0 +1,147 @@
+#include "Image.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cctype>
+#include <algorithm>
+
+//--------------------------------------------------------------
+void Image::allocate(int w, int h) {
+	width = w;
+	height = h;
+	pixels.assign(size_t(w) * h * 3, 0);
+}
+
+//--------------------------------------------------------------
+void Image::setFromPixels(const unsigned char *rgb, int w, int h) {
+	width = w;
+	height = h;
+	pixels.assign(rgb, rgb + size_t(w) * h * 3);
+}
+
+static bool hasExtension(const std::string &path, const char *ext) {
+	size_t n = strlen(ext);
+	if (path.size() < n) return false;
+	for (size_t i = 0; i < n; i++) {
+		if (tolower(path[path.size() - n + i]) != ext[i]) return false;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+bool Image::save(const std::string &path) const {
+	if (hasExtension(path, ".ppm")) return savePPM(path);
+	return savePNG(path);
+}
+
+//--------------------------------------------------------------
+bool Image::load(const std::string &path) {
+	FILE *f = fopen(path.c_str(), "rb");
+	if (!f) return false;
+	int w, h, maxval;
+	if (fscanf(f, "P6 %d %d %d", &w, &h, &maxval) != 3 || maxval != 255 || w <= 0 || h <= 0) {
+		fclose(f);
+		return false;
+	}
+	fgetc(f);    // single whitespace byte between header and data
+	allocate(w, h);
+	bool ok = fread(pixels.data(), 1, pixels.size(), f) == pixels.size();
+	fclose(f);
+	return ok;
+}
+
+//--------------------------------------------------------------
+bool Image::savePPM(const std::string &path) const {
+	FILE *f = fopen(path.c_str(), "wb");
+	if (!f) return false;
+	fprintf(f, "P6\n%d %d\n255\n", width, height);
+	bool ok = fwrite(pixels.data(), 1, pixels.size(), f) == pixels.size();
+	fclose(f);
+	return ok;
+}
+
+// PNG writer.  The image data is stored in uncompressed deflate blocks, which
+// keeps the core free of a zlib dependency at the cost of file size.
+//
+static uint32_t crc32(uint32_t crc, const unsigned char *data, size_t n) {
+	static uint32_t table[256];
+	static bool init = false;
+	if (!init) {
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+		init = true;
+	}
+	crc = ~crc;
+	for (size_t i = 0; i < n; i++) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void putBE32(std::vector<unsigned char> &out, uint32_t v) {
+	out.push_back(v >> 24); out.push_back(v >> 16); out.push_back(v >> 8); out.push_back(v);
+}
+
+static void writeChunk(FILE *f, const char *type, const std::vector<unsigned char> &data) {
+	std::vector<unsigned char> chunk;
+	putBE32(chunk, uint32_t(data.size()));
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	putBE32(chunk, crc32(0, &chunk[4], chunk.size() - 4));
+	fwrite(chunk.data(), 1, chunk.size(), f);
+}
+
+//--------------------------------------------------------------
+bool Image::savePNG(const std::string &path) const {
+	FILE *f = fopen(path.c_str(), "wb");
+	if (!f) return false;
+	static const unsigned char signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+	fwrite(signature, 1, 8, f);
+	
+	std::vector<unsigned char> header;
+	putBE32(header, width);
+	putBE32(header, height);
+	header.push_back(8);    // bit depth
+	header.push_back(2);    // color type: RGB
+	header.push_back(0);    // compression
+	header.push_back(0);    // filter
+	header.push_back(0);    // interlace
+	writeChunk(f, "IHDR", header);
+	
+	// scanlines, each prefixed by filter type 0 (none)
+	std::vector<unsigned char> raw;
+	size_t stride = size_t(width) * 3;
+	raw.reserve((stride + 1) * height);
+	for (int y = 0; y < height; y++) {
+		raw.push_back(0);
+		raw.insert(raw.end(), pixels.begin() + y * stride, pixels.begin() + (y + 1) * stride);
+	}
+	
+	// zlib stream of stored blocks
+	std::vector<unsigned char> z;
+	z.push_back(0x78);
+	z.push_back(0x01);
+	size_t pos = 0;
+	do {
+		size_t n = std::min<size_t>(65535, raw.size() - pos);
+		z.push_back(pos + n == raw.size() ? 1 : 0);
+		z.push_back(n & 0xff); z.push_back(n >> 8);
+		z.push_back(~n & 0xff); z.push_back((~n >> 8) & 0xff);
+		z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + n);
+		pos += n;
+	} while (pos < raw.size());
+	uint32_t a = 1, b = 0;
+	for (size_t i = 0; i < raw.size(); i++) {
+		a = (a + raw[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	putBE32(z, (b << 16) | a);
+	writeChunk(f, "IDAT", z);
+	writeChunk(f, "IEND", std::vector<unsigned char>());
+	
+	bool ok = ferror(f) == 0;
+	fclose(f);
+	return ok;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Color.h"
+
+//  8-bit RGB image for render output and textures.
+//
+//  Stands in for ofImage in the tracing core.  Pixels are stored row by row from
+//  the top, three bytes per pixel, so getPixels() can be handed straight to
+//  ofImage::setFromPixels() by the app.
+//
+class Image {
+public:
+	Image() {}
+	Image(int w, int h) { allocate(w, h); }
+	
+	void allocate(int w, int h);
+	bool isAllocated() const { return width > 0 && height > 0; }
+	
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	
+	Color getColor(int x, int y) const {
+		const unsigned char *p = &pixels[(size_t(y) * width + x) * 3];
+		return Color(p[0], p[1], p[2]);
+	}
+	void setColor(int x, int y, const Color &c) {
+		unsigned char *p = &pixels[(size_t(y) * width + x) * 3];
+		p[0] = c.r; p[1] = c.g; p[2] = c.b;
+	}
+	
+	unsigned char *getPixels() { return pixels.data(); }
+	const unsigned char *getPixels() const { return pixels.data(); }
+	void setFromPixels(const unsigned char *rgb, int w, int h);
+	
+	// Format is picked from the extension: .png or .ppm.  Loading supports
+	// binary PPM (P6) only; the app decodes other formats through ofImage.
+	//
+	bool save(const std::string &path) const;
+	bool load(const std::string &path);
+	
+	bool savePPM(const std::string &path) const;
+	bool savePNG(const std::string &path) const;
+	
+private:
+	int width = 0;
+	int height = 0;
+	std::vector<unsigned char> pixels;
+};
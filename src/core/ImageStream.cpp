@@ -0,0 +1,129 @@
+#include "ImageStream.h"
+
+#include <cstring>
+#include <cctype>
+#include <cstdint>
+
+#ifdef _WIN32
+#define fseeko _fseeki64
+#define ftello _ftelli64
+#endif
+
+static bool fail(std::string *error, const std::string &message) {
+	if (error) *error = message;
+	return false;
+}
+
+static bool hasExtension(const std::string &path, const char *ext) {
+	size_t n = strlen(ext);
+	if (path.size() < n) return false;
+	for (size_t i = 0; i < n; i++) {
+		if (tolower(path[path.size() - n + i]) != ext[i]) return false;
+	}
+	return true;
+}
+
+static bool littleEndian() {
+	uint16_t one = 1;
+	return *reinterpret_cast<unsigned char *>(&one) == 1;
+}
+
+//--------------------------------------------------------------
+bool ImageStream::supports(const std::string &path) {
+	return hasExtension(path, ".ppm") || hasExtension(path, ".pfm");
+}
+
+//--------------------------------------------------------------
+bool ImageStream::create(const std::string &path, int width, int height, std::string *error) {
+	return open(path, width, height, false, error);
+}
+
+//--------------------------------------------------------------
+bool ImageStream::reopen(const std::string &path, int width, int height, std::string *error) {
+	return open(path, width, height, true, error);
+}
+
+//--------------------------------------------------------------
+bool ImageStream::open(const std::string &path, int w, int h, bool existing, std::string *error) {
+	close();
+	if (!supports(path)) return fail(error, path + ": can only stream to .ppm or .pfm");
+	pfm = hasExtension(path, ".pfm");
+	width = w;
+	height = h;
+	long long rowBytes = (long long)width * (pfm ? 12 : 3);
+	
+	file = fopen(path.c_str(), existing ? "r+b" : "w+b");
+	if (!file) return fail(error, "could not open " + path);
+	
+	if (existing) {
+		int fw = 0, fh = 0;
+		bool ok;
+		if (pfm) {
+			float scale;
+			ok = fscanf(file, "PF %d %d %f", &fw, &fh, &scale) == 3 && (scale < 0) == littleEndian();
+		}
+		else {
+			int maxval;
+			ok = fscanf(file, "P6 %d %d %d", &fw, &fh, &maxval) == 3 && maxval == 255;
+		}
+		fgetc(file);    // single whitespace byte between header and data
+		dataStart = ftello(file);
+		fseeko(file, 0, SEEK_END);
+		if (!ok || fw != width || fh != height || ftello(file) < dataStart + rowBytes * height) {
+			close();
+			return fail(error, path + ": not a partial render of this size");
+		}
+		return true;
+	}
+	
+	// PFM stores rows bottom to top, and its scale's sign gives the byte order
+	if (pfm) fprintf(file, "PF\n%d %d\n%s\n", width, height, littleEndian() ? "-1.0" : "1.0");
+	else fprintf(file, "P6\n%d %d\n255\n", width, height);
+	dataStart = ftello(file);
+	
+	// size the file now; rows not written yet read back as black
+	bool ok = rowBytes * height == 0 ||
+		(fseeko(file, dataStart + rowBytes * height - 1, SEEK_SET) == 0 && fputc(0, file) != EOF);
+	if (!ok) {
+		close();
+		return fail(error, "could not write " + path);
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+bool ImageStream::writeRows(int top, const FrameBuffer &rows, const ToneMap &toneMap) {
+	if (!file || rows.getWidth() != width || top < 0 || top + rows.getHeight() > height) return false;
+	
+	if (!pfm) {
+		byteRows.resize(size_t(width) * 3 * rows.getHeight());
+		for (int r = 0; r < rows.getHeight(); r++) {
+			toneMap.apply(rows.getRow(r), width, &byteRows[size_t(r) * width * 3]);
+		}
+		return fseeko(file, dataStart + (long long)top * width * 3, SEEK_SET) == 0 &&
+			fwrite(byteRows.data(), 1, byteRows.size(), file) == byteRows.size();
+	}
+	
+	// glm::vec3 is three packed floats, so a row goes out as it is
+	for (int r = 0; r < rows.getHeight(); r++) {
+		long long fileRow = height - 1 - (top + r);
+		if (fseeko(file, dataStart + fileRow * width * 12, SEEK_SET) != 0 ||
+			fwrite(rows.getRow(r), sizeof(glm::vec3), width, file) != size_t(width)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+bool ImageStream::flush() {
+	return file && fflush(file) == 0;
+}
+
+//--------------------------------------------------------------
+bool ImageStream::close() {
+	if (!file) return true;
+	bool ok = fclose(file) == 0;
+	file = nullptr;
+	return ok;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "FrameBuffer.h"
+
+//  Image file written a band of rows at a time, for renders too big to hold
+//  in memory.  The file is laid out in full when it is created, so bands can
+//  be written in any order, and a file left by an interrupted render can be
+//  reopened to fill in the rest.
+//
+//  .ppm files are binary 8-bit PPM, tone mapped, and .pfm files 32-bit float
+//  PFM holding the float colors as they are, highlights over 1 included.
+//  Both are a short header followed by raw rows, which is what puts every row
+//  at a fixed place in the file.
+//
+class ImageStream {
+public:
+	ImageStream() {}
+	~ImageStream() { close(); }
+	ImageStream(const ImageStream &) = delete;
+	ImageStream &operator=(const ImageStream &) = delete;
+	
+	static bool supports(const std::string &path);    // .ppm or .pfm
+	
+	bool create(const std::string &path, int width, int height, std::string *error = nullptr);
+	bool reopen(const std::string &path, int width, int height, std::string *error = nullptr);    // fails unless the file has this size
+	
+	// rows.getHeight() rows starting at row top, counted from the top;
+	// toneMap is used for .ppm only
+	bool writeRows(int top, const FrameBuffer &rows, const ToneMap &toneMap);
+	bool flush();
+	bool close();
+	
+private:
+	bool open(const std::string &path, int width, int height, bool existing, std::string *error);
+	
+	FILE *file = nullptr;
+	bool pfm = false;
+	int width = 0;
+	int height = 0;
+	long long dataStart = 0;      // file offset of the first row
+	std::vector<unsigned char> byteRows;    // conversion buffer for PPM
+};
@@ -0,0 +1,145 @@
+#include "LightTree.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const float kBackFacing = 0.05f;    // the least share a light's cosine bound gets
+
+//--------------------------------------------------------------
+void LightTree::build(const std::vector<Light> &lights) {
+	std::vector<AABB> bounds;
+	setLights(lights, bounds);
+	bvh.build(bounds, 1);
+	summarize();
+}
+
+// Lights that have moved a long way leave a looser tree, which picks less
+// well but still picks fairly
+//
+//--------------------------------------------------------------
+void LightTree::refit(const std::vector<Light> &lights) {
+	if (lights.size() != lightData.size()) {
+		build(lights);
+		return;
+	}
+	std::vector<AABB> bounds;
+	setLights(lights, bounds);
+	bvh.refit(bounds);
+	summarize();
+}
+
+// Fills lightData, and bounds with each light's sphere
+//
+//--------------------------------------------------------------
+void LightTree::setLights(const std::vector<Light> &lights, std::vector<AABB> &bounds) {
+	lightData.resize(lights.size());
+	bounds.resize(lights.size());
+	for (size_t i = 0; i < lights.size(); i++) {
+		const Light &light = lights[i];
+		NodeData &d = lightData[i];
+		d.center = light.position;
+		d.radius = light.radius;
+		d.intensity = light.intensity;
+		if (light.range > 0) d.reach = AABB(light.position - glm::vec3(light.range), light.position + glm::vec3(light.range));
+		else d.reach = AABB(glm::vec3(-FLT_MAX), glm::vec3(FLT_MAX));
+		bounds[i] = AABB(light.position - glm::vec3(light.radius), light.position + glm::vec3(light.radius));
+	}
+}
+
+// Children come after their parents, so going backwards sums them first
+//
+//--------------------------------------------------------------
+void LightTree::summarize() {
+	nodeData.resize(bvh.nodes.size());
+	for (size_t k = bvh.nodes.size(); k-- > 0;) {
+		const BVH::Node &node = bvh.nodes[k];
+		NodeData &d = nodeData[k];
+		d.center = node.box.center();
+		d.radius = 0.5f * glm::length(node.box.extent());
+		d.intensity = 0;
+		d.reach = AABB();
+		if (node.count > 0) {
+			for (int i = node.start; i < node.start + node.count; i++) {
+				d.intensity += lightData[bvh.prims[i]].intensity;
+				d.reach.grow(lightData[bvh.prims[i]].reach);
+			}
+		}
+		else {
+			const NodeData &left = nodeData[k + 1], &right = nodeData[node.start];
+			d.intensity = left.intensity + right.intensity;
+			d.reach = left.reach;
+			d.reach.grow(right.reach);
+		}
+	}
+}
+
+// Intensity times the largest cosine between n and the direction to any
+// point of the node's sphere: the cosine of the angle to its center, less
+// the half angle the sphere covers
+//
+//--------------------------------------------------------------
+float LightTree::importance(const NodeData &d, const glm::vec3 &p, const glm::vec3 &n) const {
+	if (!d.reach.contains(p)) return 0;
+	glm::vec3 toCenter = d.center - p;
+	float dist2 = glm::dot(toCenter, toCenter);
+	float r2 = d.radius * d.radius;
+	float cosBound = 1;
+	if (dist2 > r2) {
+		float cosN = glm::dot(n, toCenter) / std::sqrt(dist2);
+		float sinB2 = r2 / dist2;
+		float cosB = std::sqrt(1 - sinB2);
+		if (cosN < cosB) {
+			float sinN = std::sqrt(std::max(0.0f, 1 - cosN * cosN));
+			cosBound = cosN * cosB + sinN * std::sqrt(sinB2);
+		}
+	}
+	return d.intensity * std::max(cosBound, kBackFacing);
+}
+
+// u is stretched back to [0, 1) after each choice, so one number serves
+// the whole walk down
+//
+//--------------------------------------------------------------
+int LightTree::sample(const glm::vec3 &p, const glm::vec3 &n, float u, float &pdf) const {
+	pdf = 0;
+	if (bvh.empty()) return -1;
+	float prob = 1;
+	int k = 0;
+	while (bvh.nodes[k].count == 0) {
+		int left = k + 1, right = bvh.nodes[k].start;
+		float wLeft = importance(nodeData[left], p, n);
+		float wRight = importance(nodeData[right], p, n);
+		if (wLeft + wRight <= 0) return -1;
+		float pLeft = wLeft / (wLeft + wRight);
+		if (u < pLeft) {
+			u /= pLeft;
+			prob *= pLeft;
+			k = left;
+		}
+		else {
+			u = (u - pLeft) / (1 - pLeft);
+			prob *= 1 - pLeft;
+			k = right;
+		}
+		u = std::min(u, 0.99999994f);
+	}
+	
+	// a leaf of one light, unless the BVH couldn't split them
+	const BVH::Node &leaf = bvh.nodes[k];
+	float total = 0;
+	for (int i = leaf.start; i < leaf.start + leaf.count; i++) total += importance(lightData[bvh.prims[i]], p, n);
+	if (total <= 0) return -1;
+	float target = u * total;
+	int picked = -1;
+	float weight = 0;
+	for (int i = leaf.start; i < leaf.start + leaf.count; i++) {
+		float w = importance(lightData[bvh.prims[i]], p, n);
+		if (w <= 0) continue;
+		picked = bvh.prims[i];
+		weight = w;
+		if (target < w) break;
+		target -= w;
+	}
+	pdf = prob * weight / total;
+	return picked;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include "BVH.h"
+
+//  Picks lights at random for a shading point, in proportion to a bound on
+//  what each could add there, so that scenes with thousands of lights can be
+//  shaded from a few of them.
+//
+//  The lights go in a binary tree (a BVH over their spheres).  Each node
+//  keeps the total intensity of its lights, a sphere around them and the
+//  box their ranges reach.  sample() walks down from the root, at each node
+//  choosing a child with probability in proportion to its importance: the
+//  intensity times the largest cosine any of its lights could make with the
+//  normal, or nothing where the point is out of every light's range.  That
+//  takes O(log n) steps for n lights.  The probability of the light picked
+//  is the product of the choices, and dividing its contribution by it gives
+//  an unbiased estimate of the sum over every light.
+//
+//  Lights behind the surface keep a small share, since the highlight term
+//  can still see them.
+//
+class LightTree {
+public:
+	struct Light {
+		glm::vec3 position;
+		float radius;
+		float intensity;
+		float range;    // 0 = no limit
+	};
+	
+	void build(const std::vector<Light> &lights);
+	void refit(const std::vector<Light> &lights);    // the same lights, moved or changed; keeps the tree
+	bool empty() const { return lightData.empty(); }
+	
+	// Picks a light for point p with unit normal n, using u (uniform in
+	// [0, 1)).  Returns its index, with its probability in pdf, or -1 if no
+	// light reaches p.
+	int sample(const glm::vec3 &p, const glm::vec3 &n, float u, float &pdf) const;
+	
+private:
+	struct NodeData {
+		glm::vec3 center;    // of a sphere holding the lights
+		float radius;
+		float intensity;     // sum over the lights
+		AABB reach;          // where any of them reaches
+	};
+	
+	void setLights(const std::vector<Light> &lights, std::vector<AABB> &bounds);
+	void summarize();
+	float importance(const NodeData &d, const glm::vec3 &p, const glm::vec3 &n) const;
+	
+	std::vector<NodeData> lightData;    // each light as a node of its own
+	std::vector<NodeData> nodeData;     // by node of bvh
+	BVH bvh;
+};
@@ -0,0 +1,74 @@
+#include "MappedFile.h"
+
+#include <cstdio>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+//--------------------------------------------------------------
+bool MappedFile::open(const std::string &path) {
+	close();
+	
+#ifndef _WIN32
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		::close(fd);
+		return false;
+	}
+	length = size_t(st.st_size);
+	if (length == 0) {
+		::close(fd);
+		ptr = buffer.data();
+		return true;
+	}
+	void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (p != MAP_FAILED) {
+		// parsers read front to back
+		madvise(p, length, MADV_SEQUENTIAL);
+		ptr = static_cast<const char *>(p);
+		mapped = true;
+		return true;
+	}
+	length = 0;
+#endif
+	
+	// no mmap: read the whole file instead
+	FILE *f = fopen(path.c_str(), "rb");
+	if (!f) return false;
+	fseek(f, 0, SEEK_END);
+	long n = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if (n < 0) {
+		fclose(f);
+		return false;
+	}
+	buffer.resize(size_t(n));
+	bool ok = fread(buffer.data(), 1, buffer.size(), f) == buffer.size();
+	fclose(f);
+	if (!ok) {
+		buffer.clear();
+		return false;
+	}
+	ptr = buffer.data();
+	length = buffer.size();
+	return true;
+}
+
+//--------------------------------------------------------------
+void MappedFile::close() {
+#ifndef _WIN32
+	if (mapped) munmap(const_cast<char *>(ptr), length);
+#endif
+	mapped = false;
+	ptr = nullptr;
+	length = 0;
+	buffer.clear();
+	buffer.shrink_to_fit();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+//  Read-only view of a whole file, memory mapped where the platform allows it
+//  (read into memory otherwise).  The data is not NUL terminated, so parsers
+//  working on it must stop at end().
+//
+class MappedFile {
+public:
+	MappedFile() {}
+	~MappedFile() { close(); }
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+	
+	bool open(const std::string &path);
+	void close();
+	
+	const char *data() const { return ptr; }
+	const char *end() const { return ptr + length; }
+	size_t size() const { return length; }
+	
+private:
+	const char *ptr = nullptr;
+	size_t length = 0;
+	bool mapped = false;
+	std::vector<char> buffer;    // used when the file could not be mapped
+};
@@ -0,0 +1,132 @@
+#include "Mesh.h"
+#include "MeshLoader.h"
+#include "Fingerprint.h"
+
+#include <utility>
+
+// One ray vs one triangle (Moller-Trumbore).  Lowers tHit and returns true if
+// the triangle is hit in front of the origin and closer than tHit.
+//
+static inline bool intersectTriangle(const Ray &ray, const glm::vec3 &v0, const glm::vec3 &v1, const glm::vec3 &v2, float &tHit) {
+	glm::vec3 e1 = v1 - v0;
+	glm::vec3 e2 = v2 - v0;
+	glm::vec3 p = glm::cross(ray.d, e2);
+	float det = glm::dot(e1, p);
+	if (det == 0) return false;    // edge on
+	float invDet = 1.0f / det;
+	
+	glm::vec3 tv = ray.p - v0;
+	float u = glm::dot(tv, p) * invDet;
+	if (u < 0 || u > 1) return false;
+	glm::vec3 q = glm::cross(tv, e1);
+	float v = glm::dot(ray.d, q) * invDet;
+	if (v < 0 || u + v > 1) return false;
+	float t = glm::dot(e2, q) * invDet;
+	if (!(t > 0 && t < tHit)) return false;
+	tHit = t;
+	return true;
+}
+
+//--------------------------------------------------------------
+bool Mesh::load(const std::string &path, std::string *error) {
+	std::vector<glm::vec3> v;
+	std::vector<uint32_t> i;
+	if (!loadMesh(path, v, i, error)) return false;
+	setTriangles(std::move(v), std::move(i));
+	this->path = path;
+	return true;
+}
+
+//--------------------------------------------------------------
+void Mesh::setTriangles(std::vector<glm::vec3> v, std::vector<uint32_t> i) {
+	vertices = std::move(v);
+	indices = std::move(i);
+	indices.resize(indices.size() - indices.size() % 3);
+	buildAccel();
+}
+
+// Builds the BVH, then stores the triangles in its leaf order so that the
+// BVH's primitive numbers are simply triangle numbers.
+//
+void Mesh::buildAccel() {
+	size_t count = triangleCount();
+	localBounds = AABB();
+	std::vector<AABB> bounds(count);
+	for (size_t n = 0; n < count; n++) {
+		const uint32_t *tri = &indices[3 * n];
+		bounds[n].grow(vertices[tri[0]]);
+		bounds[n].grow(vertices[tri[1]]);
+		bounds[n].grow(vertices[tri[2]]);
+		localBounds.grow(bounds[n]);
+	}
+	bvh.build(bounds);
+	std::vector<AABB>().swap(bounds);
+	
+	std::vector<uint32_t> ordered(indices.size());
+	for (size_t n = 0; n < count; n++) {
+		const uint32_t *tri = &indices[3 * bvh.prims[n]];
+		ordered[3 * n] = tri[0];
+		ordered[3 * n + 1] = tri[1];
+		ordered[3 * n + 2] = tri[2];
+		bvh.prims[n] = int(n);
+	}
+	indices.swap(ordered);
+	
+	Fingerprint f;
+	f.add(vertices.size());
+	f.addArray(vertices, vertices.size());
+	f.addArray(indices, indices.size());
+	hash = f.hash;
+}
+
+// The normal returned faces back along the ray, so that triangles are lit
+// from whichever side they are seen, whatever the winding in the file.
+//
+bool Mesh::intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) {
+	Ray local(ray.p - position, ray.d);
+	float tHit = FLT_MAX;
+	int nearest = -1;
+	bvh.closestHit(local, tHit, [&](int n, float &t) {
+		const uint32_t *tri = &indices[3 * n];
+		if (!intersectTriangle(local, vertices[tri[0]], vertices[tri[1]], vertices[tri[2]], t)) return false;
+		nearest = n;
+		return true;
+	});
+	if (nearest < 0) return false;
+	
+	const uint32_t *tri = &indices[3 * nearest];
+	normal = glm::normalize(glm::cross(vertices[tri[1]] - vertices[tri[0]], vertices[tri[2]] - vertices[tri[0]]));
+	if (glm::dot(normal, ray.d) > 0) normal = -normal;
+	point = ray.evalPoint(tHit);
+	return true;
+}
+
+//--------------------------------------------------------------
+SimdFloat Mesh::intersect(const RayPacket &rays, SimdFloat &tHit) {
+	RayPacket local = rays;
+	local.ox = rays.ox - SimdFloat(position.x);
+	local.oy = rays.oy - SimdFloat(position.y);
+	local.oz = rays.oz - SimdFloat(position.z);
+	SimdFloat hit(0.0f);
+	bvh.closestHit(local, tHit, [&](int n, SimdFloat &tMax) {
+		const uint32_t *tri = &indices[3 * n];
+		hit = hit | intersectTriangle(local, vertices[tri[0]], vertices[tri[1]], vertices[tri[2]], tMax);
+	});
+	return hit;
+}
+
+//--------------------------------------------------------------
+bool Mesh::occludes(const Ray &ray, float maxDist) {
+	Ray local(ray.p - position, ray.d);
+	return bvh.anyHit(local, maxDist, [&](int n, float &t) {
+		const uint32_t *tri = &indices[3 * n];
+		return intersectTriangle(local, vertices[tri[0]], vertices[tri[1]], vertices[tri[2]], t);
+	});
+}
+
+//--------------------------------------------------------------
+bool Mesh::getBounds(AABB &box) {
+	if (localBounds.empty()) return false;
+	box = AABB(localBounds.min + position, localBounds.max + position);
+	return true;
+}
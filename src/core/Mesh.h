@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "SceneObject.h"
+#include "BVH.h"
+
+//  Indexed triangle mesh: shared vertex positions plus three indices per
+//  triangle, 12 bytes a vertex and 12 a triangle.  Vertices are in object
+//  space; the mesh is placed in the scene by moving its position, like the
+//  other objects.
+//
+//  The mesh has its own BVH over its triangles.  Once it is built the
+//  triangles are reordered to follow the BVH's leaves, so each leaf reads a
+//  contiguous run of the index array.
+//
+class Mesh : public SceneObject {
+public:
+	Mesh() {}
+	
+	// Loads an OBJ or binary PLY file (see MeshLoader.h) and builds the BVH.
+	bool load(const std::string &path, std::string *error = nullptr);
+	void setTriangles(std::vector<glm::vec3> vertices, std::vector<uint32_t> indices);
+	
+	bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal);
+	SimdFloat intersect(const RayPacket &rays, SimdFloat &tHit);
+	bool occludes(const Ray &ray, float maxDist);
+	bool getBounds(AABB &box);
+	
+	const std::vector<glm::vec3> &getVertices() const { return vertices; }
+	const std::vector<uint32_t> &getIndices() const { return indices; }
+	size_t triangleCount() const { return indices.size() / 3; }
+	const std::string &getPath() const { return path; }    // file loaded from, empty if built with setTriangles()
+	uint64_t contentHash() const { return hash; }          // of the triangles, for Renderer::fingerprint()
+	
+private:
+	void buildAccel();
+	
+	std::vector<glm::vec3> vertices;
+	std::vector<uint32_t> indices;
+	BVH bvh;
+	AABB localBounds;
+	std::string path;
+	uint64_t hash = 0;
+};
@@ -0,0 +1,515 @@
+#include "MeshLoader.h"
+#include "MappedFile.h"
+
+#include <cmath>
+#include <cctype>
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+
+//--------------------------------------------------------------
+static bool fail(std::string *error, const std::string &message, std::vector<glm::vec3> &vertices, std::vector<uint32_t> &indices) {
+	if (error) *error = message;
+	vertices.clear();
+	indices.clear();
+	return false;
+}
+
+// Final checks shared by both formats: every index refers to a vertex, and
+// the arrays don't hold more memory than they need.
+//
+static bool finish(const std::string &path, std::string *error, std::vector<glm::vec3> &vertices, std::vector<uint32_t> &indices) {
+	if (indices.empty()) return fail(error, path + ": no faces", vertices, indices);
+	uint32_t count = uint32_t(vertices.size());
+	for (size_t i = 0; i < indices.size(); i++) {
+		if (indices[i] >= count) return fail(error, path + ": face refers to a missing vertex", vertices, indices);
+	}
+	vertices.shrink_to_fit();
+	indices.shrink_to_fit();
+	return true;
+}
+
+//--------------------------------------------------------------
+bool loadMesh(const std::string &path, std::vector<glm::vec3> &vertices, std::vector<uint32_t> &indices, std::string *error) {
+	std::string ext;
+	size_t dot = path.rfind('.');
+	if (dot != std::string::npos) ext = path.substr(dot);
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	
+	if (ext == ".obj") return loadObj(path, vertices, indices, error);
+	if (ext == ".ply") return loadPly(path, vertices, indices, error);
+	return fail(error, path + ": unknown mesh format (expected .obj or .ply)", vertices, indices);
+}
+
+//  OBJ
+//
+//  The parser walks the mapped text with pointers; numbers are converted
+//  directly from the characters, since strtof() and friends need a NUL
+//  terminated string and respect the C locale.
+//
+
+static inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+static inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+static inline const char *skipBlanks(const char *p, const char *end) {
+	while (p < end && isBlank(*p)) p++;
+	return p;
+}
+
+static inline const char *nextLine(const char *p, const char *end) {
+	const void *newline = memchr(p, '\n', end - p);
+	return newline ? static_cast<const char *>(newline) + 1 : end;
+}
+
+static const double kPowersOf10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Decimal number with optional sign, fraction and exponent.  Advances p past
+// it on success.
+//
+static bool parseFloat(const char *&p, const char *end, float &value) {
+	const char *s = p;
+	bool negative = false;
+	if (s < end && (*s == '-' || *s == '+')) negative = *s++ == '-';
+	
+	// digits beyond what the mantissa can hold only move the exponent
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	bool digits = false;
+	for (; s < end && isDigit(*s); s++) {
+		digits = true;
+		if (mantissa < 100000000000000000ULL) mantissa = mantissa * 10 + (*s - '0');
+		else exponent++;
+	}
+	if (s < end && *s == '.') {
+		for (s++; s < end && isDigit(*s); s++) {
+			digits = true;
+			if (mantissa < 100000000000000000ULL) {
+				mantissa = mantissa * 10 + (*s - '0');
+				exponent--;
+			}
+		}
+	}
+	if (!digits) return false;
+	
+	if (s < end && (*s == 'e' || *s == 'E')) {
+		const char *e = s + 1;
+		bool negativeExp = false;
+		if (e < end && (*e == '-' || *e == '+')) negativeExp = *e++ == '-';
+		if (e < end && isDigit(*e)) {
+			int n = 0;
+			for (; e < end && isDigit(*e); e++) {
+				if (n < 10000) n = n * 10 + (*e - '0');
+			}
+			exponent += negativeExp ? -n : n;
+			s = e;
+		}
+	}
+	
+	double v = double(mantissa);
+	if (exponent < 0) v = exponent >= -22 ? v / kPowersOf10[-exponent] : v * std::pow(10.0, exponent);
+	else if (exponent > 0) v = exponent <= 22 ? v * kPowersOf10[exponent] : v * std::pow(10.0, exponent);
+	value = float(negative ? -v : v);
+	p = s;
+	return true;
+}
+
+//--------------------------------------------------------------
+static bool parseInt(const char *&p, const char *end, int64_t &value) {
+	const char *s = p;
+	bool negative = false;
+	if (s < end && (*s == '-' || *s == '+')) negative = *s++ == '-';
+	if (s >= end || !isDigit(*s)) return false;
+	int64_t n = 0;
+	for (; s < end && isDigit(*s); s++) {
+		if (n < (int64_t(1) << 40)) n = n * 10 + (*s - '0');
+	}
+	value = negative ? -n : n;
+	p = s;
+	return true;
+}
+
+//--------------------------------------------------------------
+bool loadObj(const std::string &path, std::vector<glm::vec3> &vertices, std::vector<uint32_t> &indices, std::string *error) {
+	vertices.clear();
+	indices.clear();
+	MappedFile file;
+	if (!file.open(path)) return fail(error, "could not open " + path, vertices, indices);
+	const char *begin = file.data();
+	const char *end = file.end();
+	
+	// First pass: count vertex and face lines to size the arrays.  Faces are
+	// taken to be triangles; larger polygons make the index array grow.
+	size_t vertexCount = 0, faceCount = 0;
+	for (const char *p = begin; p < end; p = nextLine(p, end)) {
+		p = skipBlanks(p, end);
+		if (end - p < 2 || !isBlank(p[1])) continue;
+		if (p[0] == 'v') vertexCount++;
+		else if (p[0] == 'f') faceCount++;
+	}
+	vertices.reserve(vertexCount);
+	indices.reserve(faceCount * 3);
+	
+	int lineNumber = 0;
+	for (const char *p = begin; p < end; ) {
+		const char *next = nextLine(p, end);
+		lineNumber++;
+		p = skipBlanks(p, next);
+		if (next - p < 2 || !isBlank(p[1])) {
+			p = next;
+			continue;
+		}
+		
+		if (p[0] == 'v') {
+			glm::vec3 v;
+			p++;
+			for (int a = 0; a < 3; a++) {
+				p = skipBlanks(p, next);
+				if (!parseFloat(p, next, v[a])) {
+					return fail(error, path + ":" + std::to_string(lineNumber) + ": bad vertex", vertices, indices);
+				}
+			}
+			vertices.push_back(v);
+		}
+		else if (p[0] == 'f') {
+			// v, v/vt, v//vn or v/vt/vn per corner; only v is used.  Negative
+			// indices count back from the latest vertex.
+			uint32_t first = 0, prev = 0;
+			int corners = 0;
+			p++;
+			for (;;) {
+				p = skipBlanks(p, next);
+				if (p >= next || *p == '\n' || *p == '#') break;
+				int64_t index;
+				if (!parseInt(p, next, index)) {
+					return fail(error, path + ":" + std::to_string(lineNumber) + ": bad face", vertices, indices);
+				}
+				while (p < next && !isBlank(*p) && *p != '\n') p++;
+				
+				int64_t resolved = index > 0 ? index - 1 : int64_t(vertices.size()) + index;
+				if (index == 0 || resolved < 0 || resolved >= int64_t(UINT32_MAX)) {
+					return fail(error, path + ":" + std::to_string(lineNumber) + ": face refers to a missing vertex", vertices, indices);
+				}
+				uint32_t v = uint32_t(resolved);
+				if (corners == 0) first = v;
+				else if (corners >= 2) {
+					indices.push_back(first);
+					indices.push_back(prev);
+					indices.push_back(v);
+				}
+				prev = v;
+				corners++;
+			}
+			if (corners < 3) {
+				return fail(error, path + ":" + std::to_string(lineNumber) + ": face with fewer than three vertices", vertices, indices);
+			}
+		}
+		p = next;
+	}
+	return finish(path, error, vertices, indices);
+}
+
+//  PLY
+//
+//  The header is plain text and short, so it is read with ordinary string
+//  handling.  The binary body is read in place: vertices whose x, y and z are
+//  floats and triangle lists with byte counts and int indices (what most
+//  exporters write) are copied straight out of the file; anything else goes
+//  through a slower path that converts property by property.
+//
+
+enum PlyType { kPlyNone, kPlyInt8, kPlyUint8, kPlyInt16, kPlyUint16, kPlyInt32, kPlyUint32, kPlyFloat32, kPlyFloat64 };
+
+struct PlyProperty {
+	std::string name;
+	PlyType type = kPlyNone;
+	PlyType countType = kPlyNone;    // set for list properties
+};
+
+struct PlyElement {
+	std::string name;
+	size_t count = 0;
+	std::vector<PlyProperty> properties;
+};
+
+//--------------------------------------------------------------
+static PlyType plyType(const std::string &s) {
+	if (s == "char" || s == "int8") return kPlyInt8;
+	if (s == "uchar" || s == "uint8") return kPlyUint8;
+	if (s == "short" || s == "int16") return kPlyInt16;
+	if (s == "ushort" || s == "uint16") return kPlyUint16;
+	if (s == "int" || s == "int32") return kPlyInt32;
+	if (s == "uint" || s == "uint32") return kPlyUint32;
+	if (s == "float" || s == "float32") return kPlyFloat32;
+	if (s == "double" || s == "float64") return kPlyFloat64;
+	return kPlyNone;
+}
+
+//--------------------------------------------------------------
+static int plySize(PlyType t) {
+	switch (t) {
+		case kPlyInt8: case kPlyUint8: return 1;
+		case kPlyInt16: case kPlyUint16: return 2;
+		case kPlyInt32: case kPlyUint32: case kPlyFloat32: return 4;
+		case kPlyFloat64: return 8;
+		default: return 0;
+	}
+}
+
+//  Bounds checked reads from the body of a binary PLY file
+//
+struct PlyReader {
+	const char *p;
+	const char *end;
+	bool swap;    // file byte order differs from ours
+	
+	bool read(PlyType t, double &value) {
+		int size = plySize(t);
+		if (end - p < size) return false;
+		unsigned char b[8];
+		memcpy(b, p, size);
+		if (swap) std::reverse(b, b + size);
+		p += size;
+		switch (t) {
+			case kPlyInt8: { int8_t v; memcpy(&v, b, 1); value = v; break; }
+			case kPlyUint8: { uint8_t v; memcpy(&v, b, 1); value = v; break; }
+			case kPlyInt16: { int16_t v; memcpy(&v, b, 2); value = v; break; }
+			case kPlyUint16: { uint16_t v; memcpy(&v, b, 2); value = v; break; }
+			case kPlyInt32: { int32_t v; memcpy(&v, b, 4); value = v; break; }
+			case kPlyUint32: { uint32_t v; memcpy(&v, b, 4); value = v; break; }
+			case kPlyFloat32: { float v; memcpy(&v, b, 4); value = v; break; }
+			case kPlyFloat64: { double v; memcpy(&v, b, 8); value = v; break; }
+			default: return false;
+		}
+		return true;
+	}
+	
+	// Reads one property of an element.  For a list, calls item(i, value) for
+	// each entry.
+	//
+	template<class Item>
+	bool readProperty(const PlyProperty &prop, double &value, Item item) {
+		if (prop.countType == kPlyNone) return read(prop.type, value);
+		double count;
+		if (!read(prop.countType, count) || count < 0) return false;
+		for (int i = 0; i < int(count); i++) {
+			if (!read(prop.type, value)) return false;
+			item(i, value);
+		}
+		return true;
+	}
+};
+
+// Size of one entry of an element, or 0 if it holds lists
+//
+static size_t plyStride(const PlyElement &element) {
+	size_t stride = 0;
+	for (size_t i = 0; i < element.properties.size(); i++) {
+		if (element.properties[i].countType != kPlyNone) return 0;
+		stride += plySize(element.properties[i].type);
+	}
+	return stride;
+}
+
+//--------------------------------------------------------------
+static bool readPlyVertices(PlyReader &in, const PlyElement &element, std::vector<glm::vec3> &vertices) {
+	int axis[3] = { -1, -1, -1 };
+	size_t offset[3] = { 0, 0, 0 };
+	size_t at = 0;
+	for (size_t i = 0; i < element.properties.size(); i++) {
+		const PlyProperty &prop = element.properties[i];
+		for (int a = 0; a < 3; a++) {
+			if (prop.name == std::string(1, char('x' + a)) && prop.countType == kPlyNone) {
+				axis[a] = int(i);
+				offset[a] = at;
+			}
+		}
+		at += plySize(prop.type);
+	}
+	if (axis[0] < 0 || axis[1] < 0 || axis[2] < 0) return false;    // no position
+	
+	// the count comes from the header, so it is only trusted as far as the
+	// bytes left could hold that many vertices
+	size_t stride = plyStride(element);
+	if (element.count <= size_t(in.end - in.p) / std::max<size_t>(stride, 1)) vertices.reserve(element.count);
+	bool floats = element.properties[axis[0]].type == kPlyFloat32 && element.properties[axis[1]].type == kPlyFloat32
+		&& element.properties[axis[2]].type == kPlyFloat32;
+	if (stride > 0 && floats && !in.swap) {
+		if (size_t(in.end - in.p) / stride < element.count) return false;
+		for (size_t n = 0; n < element.count; n++, in.p += stride) {
+			glm::vec3 v;
+			memcpy(&v.x, in.p + offset[0], 4);
+			memcpy(&v.y, in.p + offset[1], 4);
+			memcpy(&v.z, in.p + offset[2], 4);
+			vertices.push_back(v);
+		}
+		return true;
+	}
+	
+	for (size_t n = 0; n < element.count; n++) {
+		glm::vec3 v;
+		for (size_t i = 0; i < element.properties.size(); i++) {
+			double value = 0;
+			if (!in.readProperty(element.properties[i], value, [](int, double) {})) return false;
+			for (int a = 0; a < 3; a++) {
+				if (axis[a] == int(i)) v[a] = float(value);
+			}
+		}
+		vertices.push_back(v);
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+static bool readPlyFaces(PlyReader &in, const PlyElement &element, std::vector<uint32_t> &indices) {
+	int list = -1;
+	for (size_t i = 0; i < element.properties.size(); i++) {
+		const PlyProperty &prop = element.properties[i];
+		if ((prop.name == "vertex_indices" || prop.name == "vertex_index") && prop.countType != kPlyNone) list = int(i);
+	}
+	if (list < 0) return false;
+	if (element.count <= size_t(in.end - in.p)) indices.reserve(element.count * 3);    // a face takes a byte at least
+	
+	const PlyProperty &prop = element.properties[list];
+	if (element.properties.size() == 1 && prop.countType == kPlyUint8 && plySize(prop.type) == 4 && !in.swap) {
+		for (size_t n = 0; n < element.count; n++) {
+			if (in.p >= in.end) return false;
+			int corners = (unsigned char)*in.p++;
+			if (in.end - in.p < 4 * corners) return false;
+			uint32_t first = 0, prev = 0, v;
+			for (int i = 0; i < corners; i++) {
+				memcpy(&v, in.p + 4 * i, 4);
+				if (i == 0) first = v;
+				else if (i >= 2) {
+					indices.push_back(first);
+					indices.push_back(prev);
+					indices.push_back(v);
+				}
+				prev = v;
+			}
+			in.p += 4 * corners;
+		}
+		return true;
+	}
+	
+	for (size_t n = 0; n < element.count; n++) {
+		for (size_t i = 0; i < element.properties.size(); i++) {
+			double value;
+			uint32_t first = 0, prev = 0;
+			bool isList = int(i) == list;
+			bool ok = in.readProperty(element.properties[i], value, [&](int corner, double index) {
+				if (!isList) return;
+				uint32_t v = index < 0 ? UINT32_MAX : uint32_t(index);
+				if (corner == 0) first = v;
+				else if (corner >= 2) {
+					indices.push_back(first);
+					indices.push_back(prev);
+					indices.push_back(v);
+				}
+				prev = v;
+			});
+			if (!ok) return false;
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+static bool skipPlyElement(PlyReader &in, const PlyElement &element) {
+	size_t stride = plyStride(element);
+	if (stride > 0) {
+		if (size_t(in.end - in.p) / stride < element.count) return false;
+		in.p += stride * element.count;
+		return true;
+	}
+	for (size_t n = 0; n < element.count; n++) {
+		for (size_t i = 0; i < element.properties.size(); i++) {
+			double value;
+			if (!in.readProperty(element.properties[i], value, [](int, double) {})) return false;
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+bool loadPly(const std::string &path, std::vector<glm::vec3> &vertices, std::vector<uint32_t> &indices, std::string *error) {
+	vertices.clear();
+	indices.clear();
+	MappedFile file;
+	if (!file.open(path)) return fail(error, "could not open " + path, vertices, indices);
+	const char *end = file.end();
+	
+	// header
+	std::vector<PlyElement> elements;
+	std::string format;
+	const char *p = file.data();
+	bool first = true, ended = false;
+	while (p < end && !ended) {
+		const char *next = nextLine(p, end);
+		std::istringstream line(std::string(p, next));
+		p = next;
+		std::string keyword;
+		line >> keyword;
+		if (first) {
+			if (keyword != "ply") return fail(error, path + ": not a PLY file", vertices, indices);
+			first = false;
+		}
+		else if (keyword == "format") line >> format;
+		else if (keyword == "element") {
+			PlyElement element;
+			line >> element.name >> element.count;
+			elements.push_back(element);
+		}
+		else if (keyword == "property") {
+			if (elements.empty()) return fail(error, path + ": property before any element", vertices, indices);
+			PlyProperty prop;
+			std::string type;
+			line >> type;
+			if (type == "list") {
+				std::string countType;
+				line >> countType >> type;
+				prop.countType = plyType(countType);
+				if (prop.countType == kPlyNone || prop.countType == kPlyFloat32 || prop.countType == kPlyFloat64) {
+					return fail(error, path + ": bad list count type " + countType, vertices, indices);
+				}
+			}
+			prop.type = plyType(type);
+			if (prop.type == kPlyNone) return fail(error, path + ": unknown property type " + type, vertices, indices);
+			line >> prop.name;
+			elements.back().properties.push_back(prop);
+		}
+		else if (keyword == "end_header") ended = true;
+	}
+	if (!ended) return fail(error, path + ": header has no end_header", vertices, indices);
+	
+	bool little;
+	if (format == "binary_little_endian") little = true;
+	else if (format == "binary_big_endian") little = false;
+	else if (format == "ascii") return fail(error, path + ": ASCII PLY is not supported, only binary", vertices, indices);
+	else return fail(error, path + ": unknown format " + format, vertices, indices);
+	
+	uint16_t probe = 1;
+	unsigned char hostLow;
+	memcpy(&hostLow, &probe, 1);
+	PlyReader in;
+	in.p = p;
+	in.end = end;
+	in.swap = little != (hostLow == 1);
+	
+	bool haveVertices = false;
+	for (size_t e = 0; e < elements.size(); e++) {
+		const PlyElement &element = elements[e];
+		bool ok;
+		if (element.name == "vertex") {
+			ok = readPlyVertices(in, element, vertices);
+			haveVertices = true;
+		}
+		else if (element.name == "face") ok = readPlyFaces(in, element, indices);
+		else ok = skipPlyElement(in, element);
+		if (!ok) return fail(error, path + ": bad or truncated " + element.name + " data", vertices, indices);
+	}
+	if (!haveVertices) return fail(error, path + ": no vertex element", vertices, indices);
+	return finish(path, error, vertices, indices);
+}
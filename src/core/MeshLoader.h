@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "VecMath.h"
+
+//  Triangle mesh file loading: Wavefront OBJ and binary PLY.
+//
+//  Only vertex positions and faces are read; polygons are split into triangle
+//  fans.  The file is memory mapped and parsed in place, and the output arrays
+//  are sized from a first pass, so a load needs little more memory than the
+//  vertices and indices it returns.
+//
+//  On failure the arrays are left empty and, if error is given, it receives a
+//  short description of the problem.
+//
+bool loadMesh(const std::string &path, std::vector<glm::vec3> &vertices, std::vector<uint32_t> &indices, std::string *error = nullptr);
+
+bool loadObj(const std::string &path, std::vector<glm::vec3> &vertices, std::vector<uint32_t> &indices, std::string *error = nullptr);
+bool loadPly(const std::string &path, std::vector<glm::vec3> &vertices, std::vector<uint32_t> &indices, std::string *error = nullptr);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//  Storage for many objects of one type.
+//
+//  Objects are made in blocks of kBlockSize slots, allocated as they are
+//  needed and never moved, so a pointer to an object stays good until the
+//  object is destroyed.  Destroyed slots go on a free list that the next
+//  create() takes from: creating and destroying are O(1), a pool that has
+//  grown stops allocating, and objects made together sit together in
+//  memory rather than wherever the heap put them.
+//
+//  The pool only owns memory.  Whoever creates an object destroys it, and
+//  all of them must be gone before the pool is.
+//
+template<class T>
+class ObjectPool {
+public:
+	static const size_t kBlockSize = 1024;
+
+	ObjectPool() {}
+	ObjectPool(const ObjectPool &) = delete;
+	ObjectPool &operator=(const ObjectPool &) = delete;
+
+	template<class... Args> T *create(Args &&... args);
+	void destroy(T *object);
+
+	size_t size() const { return live; }
+	size_t capacity() const { return blocks.size() * kBlockSize; }
+
+private:
+	union Slot {
+		Slot *next;    // while free
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type object;
+	};
+
+	std::vector<std::unique_ptr<Slot[]> > blocks;
+	Slot *freeList = nullptr;
+	size_t used = 0;    // slots of the last block handed out so far; the free list holds the rest
+	size_t live = 0;
+};
+
+//--------------------------------------------------------------
+template<class T>
+template<class... Args>
+T *ObjectPool<T>::create(Args &&... args) {
+	Slot *slot = freeList;
+	if (slot) freeList = slot->next;
+	else {
+		if (blocks.empty() || used == kBlockSize) {
+			blocks.emplace_back(new Slot[kBlockSize]);
+			used = 0;
+		}
+		slot = &blocks.back()[used++];
+	}
+	live++;
+	return new (&slot->object) T(std::forward<Args>(args)...);
+}
+
+// object must have come from this pool's create()
+//
+//--------------------------------------------------------------
+template<class T>
+void ObjectPool<T>::destroy(T *object) {
+	if (!object) return;
+	object->~T();
+	Slot *slot = reinterpret_cast<Slot *>(object);
+	slot->next = freeList;
+	freeList = slot;
+	live--;
+}
@@ -0,0 +1,113 @@
+#include "ObjectTree.h"
+
+#include <algorithm>
+
+// What the tree puts up with before stale(): added objects each cost every
+// query a test, dead entries only a little traversal
+static const size_t kMinStale = 64;
+static const size_t kAddedShare = 64;    // one added object per this many entries
+static const size_t kDeadShare = 4;
+
+//--------------------------------------------------------------
+void ObjectTree::build(const std::vector<SceneObject *> &objects) {
+	entries.clear();
+	bounds.clear();
+	added.clear();
+	unbounded.clear();
+	entryOf.clear();
+	dead = 0;
+	for (size_t i = 0; i < objects.size(); i++) {
+		AABB box;
+		if (!objects[i]->getBounds(box)) {
+			unbounded.push_back(objects[i]);
+			continue;
+		}
+		uint32_t h = objects[i]->handle.index;
+		if (h >= entryOf.size()) entryOf.resize(h + 1, -1);
+		entryOf[h] = int(entries.size());
+		entries.push_back(objects[i]);
+		bounds.push_back(box);
+	}
+	bvh.build(bounds);
+	
+	// children always come after their parent, so one pass finds every parent
+	parent.assign(bvh.nodes.size(), -1);
+	leaf.assign(entries.size(), -1);
+	for (size_t n = 0; n < bvh.nodes.size(); n++) {
+		const BVH::Node &node = bvh.nodes[n];
+		if (node.count > 0) {
+			for (int i = node.start; i < node.start + node.count; i++) leaf[bvh.prims[i]] = int(n);
+		}
+		else {
+			parent[n + 1] = int(n);
+			parent[node.start] = int(n);
+		}
+	}
+}
+
+//--------------------------------------------------------------
+void ObjectTree::add(SceneObject *o) {
+	AABB box;
+	if (o->getBounds(box)) added.push_back(o);
+	else unbounded.push_back(o);
+}
+
+// An object on one of the lists comes off it; one in the tree leaves its
+// entry behind, empty, so nothing else in the tree moves
+//
+//--------------------------------------------------------------
+void ObjectTree::remove(SceneObject *o) {
+	uint32_t h = o->handle.index;
+	if (h < entryOf.size() && entryOf[h] >= 0 && entries[entryOf[h]] == o) {
+		int entry = entryOf[h];
+		entryOf[h] = -1;
+		entries[entry] = NULL;
+		bounds[entry] = AABB();
+		dead++;
+		shrink(leaf[entry]);
+		return;
+	}
+	std::vector<SceneObject *> *lists[2] = { &added, &unbounded };
+	for (int l = 0; l < 2; l++) {
+		std::vector<SceneObject *> &list = *lists[l];
+		std::vector<SceneObject *>::iterator at = std::find(list.begin(), list.end(), o);
+		if (at == list.end()) continue;
+		*at = list.back();
+		list.pop_back();
+		return;
+	}
+}
+
+// Recomputes the boxes from node up to the root
+//
+void ObjectTree::shrink(int node) {
+	for (int n = node; n >= 0; n = parent[n]) {
+		BVH::Node &current = bvh.nodes[n];
+		AABB box;
+		if (current.count > 0) {
+			for (int i = current.start; i < current.start + current.count; i++) box.grow(bounds[bvh.prims[i]]);
+		}
+		else {
+			box.grow(bvh.nodes[n + 1].box);
+			box.grow(bvh.nodes[current.start].box);
+		}
+		current.box = box;
+	}
+}
+
+// An object in the tree that has lost its bounds would need to move to the
+// unbounded list, which is left to a build
+//
+//--------------------------------------------------------------
+bool ObjectTree::refit() {
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i] && !entries[i]->getBounds(bounds[i])) return false;
+	}
+	bvh.refit(bounds);
+	return true;
+}
+
+//--------------------------------------------------------------
+bool ObjectTree::stale() const {
+	return added.size() > std::max(kMinStale, entries.size() / kAddedShare) || dead > std::max(kMinStale, entries.size() / kDeadShare);
+}
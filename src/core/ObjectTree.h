@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include "SceneObject.h"
+#include "BVH.h"
+
+//  A BVH over a set of objects that keeps up with adds and removes, for the
+//  Scene's own ray queries (picking in the app).
+//
+//  build() puts every object in the tree.  After that, remove() marks the
+//  object's entry dead and shrinks the boxes on the path from its leaf to
+//  the root, and add() puts the object on a short list that is tested one
+//  by one; both take O(log n) at most, where a build takes O(n log n).
+//  Dead entries and the list slow queries down as they grow, so once either
+//  is a large enough share of the tree, stale() says it is time to build
+//  again.  Objects without finite bounds are always on a list of their own.
+//
+//  Objects are found by their handle (see ObjectHandle), so entries don't
+//  have to follow the Scene's lists as they are reordered.
+//
+class ObjectTree {
+public:
+	void build(const std::vector<SceneObject *> &objects);
+	void add(SceneObject *o);
+	void remove(SceneObject *o);
+	bool refit();    // recomputes every box after objects have moved; false if the tree needs building instead
+	bool stale() const;
+	size_t size() const { return entries.size() - dead + added.size() + unbounded.size(); }
+	
+	// Finds the closest object along the ray.  intersect(object, tMax) is as
+	// in BVH::closestHit().
+	//
+	template<class Intersect>
+	bool closestHit(const Ray &ray, float &tMax, Intersect intersect) const;
+	
+private:
+	void shrink(int node);
+	
+	BVH bvh;
+	std::vector<SceneObject *> entries;    // by primitive number; NULL once removed
+	std::vector<AABB> bounds;              // by primitive number; empty once removed
+	std::vector<int> parent;               // by node, -1 for the root
+	std::vector<int> leaf;                 // node holding each entry
+	std::vector<int> entryOf;              // by handle index, -1 for none
+	std::vector<SceneObject *> added;      // since the last build
+	std::vector<SceneObject *> unbounded;
+	size_t dead = 0;
+};
+
+//--------------------------------------------------------------
+template<class Intersect>
+bool ObjectTree::closestHit(const Ray &ray, float &tMax, Intersect intersect) const {
+	bool found = bvh.closestHit(ray, tMax, [&](int i, float &t) {
+		return entries[i] && intersect(entries[i], t);
+	});
+	for (size_t n = 0; n < added.size(); n++) {
+		if (intersect(added[n], tMax)) found = true;
+	}
+	for (size_t n = 0; n < unbounded.size(); n++) {
+		if (intersect(unbounded[n], tMax)) found = true;
+	}
+	return found;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "RayPacket.h"
+#include "AABB.h"
+
+//  Vectorized intersection kernels: one packet of rays against one primitive,
+//  or one ray against kSimdWidth primitives at a time.
+//
+//  Each packet kernel takes the packet's current closest hit distances in
+//  tHit, lowers them for the lanes that hit the primitive closer than that, and
+//  returns the mask of those lanes.  Inactive lanes never hit.
+//
+
+static const float kPacketEpsilon = 1.19209290e-07f;    // glm::epsilon<float>()
+
+// Packet vs sphere.  Same construction as glm::intersectRaySphere, which the
+// scalar Sphere::intersect uses, so both paths agree on which sphere is hit.
+//
+inline SimdFloat intersectSphere(const RayPacket &r, const glm::vec3 &center, float radius, SimdFloat &tHit) {
+	SimdFloat diffX = SimdFloat(center.x) - r.ox;
+	SimdFloat diffY = SimdFloat(center.y) - r.oy;
+	SimdFloat diffZ = SimdFloat(center.z) - r.oz;
+	SimdFloat t0 = diffX * r.dx + diffY * r.dy + diffZ * r.dz;
+	SimdFloat d2 = diffX * diffX + diffY * diffY + diffZ * diffZ - t0 * t0;
+	SimdFloat r2 = SimdFloat(radius * radius);
+	SimdFloat t1 = sqrt(max(r2 - d2, SimdFloat(0.0f)));
+	
+	// nearest root in front of the origin, or the far one if we start inside
+	SimdFloat t = select(t0 < t1 + SimdFloat(kPacketEpsilon), t0 + t1, t0 - t1);
+	SimdFloat mask = r.active & (d2 <= r2) & (t > SimdFloat(0.0f)) & (t < tHit);
+	tHit = select(mask, t, tHit);
+	return mask;
+}
+
+// One ray vs count spheres stored as separate x, y, z and radius arrays, each
+// readable up to the next multiple of kSimdWidth past count.  Returns the
+// index of the closest sphere hit before tHit and lowers tHit to it, or
+// returns -1.
+//
+inline int intersectSpheres(const Ray &ray, const float *x, const float *y, const float *z, const float *radius, int count, float &tHit) {
+	SimdFloat ox(ray.p.x), oy(ray.p.y), oz(ray.p.z);
+	SimdFloat dx(ray.d.x), dy(ray.d.y), dz(ray.d.z);
+	int nearest = -1;
+	for (int base = 0; base < count; base += kSimdWidth) {
+		SimdFloat diffX = SimdFloat::load(x + base) - ox;
+		SimdFloat diffY = SimdFloat::load(y + base) - oy;
+		SimdFloat diffZ = SimdFloat::load(z + base) - oz;
+		SimdFloat r = SimdFloat::load(radius + base);
+		SimdFloat t0 = diffX * dx + diffY * dy + diffZ * dz;
+		SimdFloat d2 = diffX * diffX + diffY * diffY + diffZ * diffZ - t0 * t0;
+		SimdFloat r2 = r * r;
+		SimdFloat t1 = sqrt(max(r2 - d2, SimdFloat(0.0f)));
+		SimdFloat t = select(t0 < t1 + SimdFloat(kPacketEpsilon), t0 + t1, t0 - t1);
+		SimdFloat mask = SimdFloat::firstLanes(count - base) & (d2 <= r2) & (t > SimdFloat(0.0f)) & (t < SimdFloat(tHit));
+		
+		int bits = moveMask(mask);
+		if (bits == 0) continue;
+		float lanes[kSimdWidth];
+		t.store(lanes);
+		for (int i = 0; bits != 0; i++, bits >>= 1) {
+			if ((bits & 1) && lanes[i] < tHit) {
+				tHit = lanes[i];
+				nearest = base + i;
+			}
+		}
+	}
+	return nearest;
+}
+
+// Packet vs the finite plane of Plane::intersect: an infinite plane through
+// point, clipped to point.x +- halfWidth and point.z +- halfHeight.
+//
+inline SimdFloat intersectPlane(const RayPacket &r, const glm::vec3 &point, const glm::vec3 &normal, float halfWidth, float halfHeight, SimdFloat &tHit) {
+	SimdFloat nx(normal.x), ny(normal.y), nz(normal.z);
+	SimdFloat denom = r.dx * nx + r.dy * ny + r.dz * nz;
+	SimdFloat num = (SimdFloat(point.x) - r.ox) * nx + (SimdFloat(point.y) - r.oy) * ny + (SimdFloat(point.z) - r.oz) * nz;
+	SimdFloat t = num / denom;
+	
+	SimdFloat px = r.ox + t * r.dx;
+	SimdFloat pz = r.oz + t * r.dz;
+	SimdFloat inBounds = (px < SimdFloat(point.x + halfWidth)) & (px > SimdFloat(point.x - halfWidth))
+		& (pz < SimdFloat(point.z + halfHeight)) & (pz > SimdFloat(point.z - halfHeight));
+	SimdFloat mask = r.active & (abs(denom) > SimdFloat(kPacketEpsilon)) & (t > SimdFloat(0.0f)) & (t < tHit) & inBounds;
+	tHit = select(mask, t, tHit);
+	return mask;
+}
+
+// Packet vs triangle (Moller-Trumbore).  Same steps as the scalar test in
+// Mesh.cpp.  Rays hitting the triangle edge on are misses.
+//
+inline SimdFloat intersectTriangle(const RayPacket &r, const glm::vec3 &v0, const glm::vec3 &v1, const glm::vec3 &v2, SimdFloat &tHit) {
+	SimdFloat e1x(v1.x - v0.x), e1y(v1.y - v0.y), e1z(v1.z - v0.z);
+	SimdFloat e2x(v2.x - v0.x), e2y(v2.y - v0.y), e2z(v2.z - v0.z);
+	SimdFloat px = r.dy * e2z - r.dz * e2y;
+	SimdFloat py = r.dz * e2x - r.dx * e2z;
+	SimdFloat pz = r.dx * e2y - r.dy * e2x;
+	SimdFloat det = e1x * px + e1y * py + e1z * pz;
+	SimdFloat invDet = SimdFloat(1.0f) / det;
+	
+	SimdFloat tx = r.ox - SimdFloat(v0.x), ty = r.oy - SimdFloat(v0.y), tz = r.oz - SimdFloat(v0.z);
+	SimdFloat u = (tx * px + ty * py + tz * pz) * invDet;
+	SimdFloat qx = ty * e1z - tz * e1y;
+	SimdFloat qy = tz * e1x - tx * e1z;
+	SimdFloat qz = tx * e1y - ty * e1x;
+	SimdFloat v = (r.dx * qx + r.dy * qy + r.dz * qz) * invDet;
+	SimdFloat t = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+	
+	SimdFloat zero(0.0f), one(1.0f);
+	SimdFloat mask = r.active & (abs(det) > zero) & (u >= zero) & (v >= zero) & (u + v <= one)
+		& (t > zero) & (t < tHit);
+	tHit = select(mask, t, tHit);
+	return mask;
+}
+
+// Packet vs box: the mask of active lanes that enter the box before tMax.
+// tNear receives each lane's entry distance.
+//
+inline SimdFloat intersectBox(const RayPacket &r, const AABB &box, const SimdFloat &tMax, SimdFloat &tNear) {
+	SimdFloat x0 = (SimdFloat(box.min.x) - r.ox) * r.invDx, x1 = (SimdFloat(box.max.x) - r.ox) * r.invDx;
+	SimdFloat y0 = (SimdFloat(box.min.y) - r.oy) * r.invDy, y1 = (SimdFloat(box.max.y) - r.oy) * r.invDy;
+	SimdFloat z0 = (SimdFloat(box.min.z) - r.oz) * r.invDz, z1 = (SimdFloat(box.max.z) - r.oz) * r.invDz;
+	tNear = max(max(min(x0, x1), min(y0, y1)), max(min(z0, z1), SimdFloat(0.0f)));
+	SimdFloat tFar = min(min(max(x0, x1), max(y0, y1)), min(max(z0, z1), tMax));
+	return r.active & (tNear <= tFar);
+}
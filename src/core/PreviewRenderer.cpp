@@ -0,0 +1,278 @@
+#include "PreviewRenderer.h"
+
+#include <algorithm>
+#include <cfloat>
+
+static const int kCoarseBlock = 4;    // the first pass traces one ray per block of 4 x 4 pixels
+
+//--------------------------------------------------------------
+void PreviewRenderer::start(const RenderCam &view) {
+	stop();
+	
+	cam = view;
+	renderer.imageWidth = width;
+	renderer.imageHeight = height;
+	tiles = makeTiles(width, height, renderer.tileSize);
+	tileSamples.assign(tiles.size(), -1);
+	sum.assign(size_t(width) * height, glm::vec3(0));
+	depth.assign(size_t(width) * height, FLT_MAX);
+	working.allocate(width, height);
+	launch();
+}
+
+//--------------------------------------------------------------
+void PreviewRenderer::resume() {
+	stop();
+	if (!tiles.empty()) launch();
+}
+
+// Takes the snapshot and sets the worker going on the tiles that aren't
+// finished
+//
+//--------------------------------------------------------------
+void PreviewRenderer::launch() {
+	renderer.prepare();
+	
+	int threads = std::max(1, ThreadPool::hardwareThreads() - 1);
+	if (!pool || pool->size() != threads) pool.reset(new ThreadPool(threads));
+	
+	{
+		std::lock_guard<std::mutex> guard(publishLock);
+		fresh = false;
+	}
+	passes = 0;
+	cancel = false;
+	done = false;
+	worker = std::thread(&PreviewRenderer::run, this);
+}
+
+//--------------------------------------------------------------
+void PreviewRenderer::stop() {
+	cancel = true;
+	if (worker.joinable()) worker.join();
+}
+
+//--------------------------------------------------------------
+bool PreviewRenderer::fetch(Image &image) {
+	std::lock_guard<std::mutex> guard(publishLock);
+	if (!fresh) return false;
+	image = published;
+	fresh = false;
+	return true;
+}
+
+//--------------------------------------------------------------
+bool PreviewRenderer::cameraChanged(const RenderCam &view) const {
+	return view.position != cam.position || view.aim != cam.aim ||
+		view.view.min != cam.view.min || view.view.max != cam.view.max ||
+		view.view.position != cam.view.position || view.up != cam.up ||
+		view.aperture != cam.aperture || view.focusDistance != cam.focusDistance;
+}
+
+//--------------------------------------------------------------
+int PreviewRenderer::dirtyTiles() const {
+	return int(std::count(tileSamples.begin(), tileSamples.end(), -1));
+}
+
+// Each round takes every unfinished tile one step further: the coarse pass
+// for new tiles, another sample per pixel for the rest.  After an edit the
+// retraced tiles start over while the others carry on refining.
+//
+//--------------------------------------------------------------
+void PreviewRenderer::run() {
+	std::vector<int> active;
+	for (;;) {
+		active.clear();
+		for (size_t t = 0; t < tiles.size(); t++) {
+			if (tileSamples[t] < maxSamples) active.push_back(int(t));
+		}
+		if (active.empty()) break;
+		
+		pool->parallelFor(int(active.size()), [&](int k, int thread) {
+			if (cancel) return;
+			int t = active[k];
+			if (tileSamples[t] < 0) coarseTile(tiles[t]);
+			else fineTile(tiles[t], tileSamples[t] + 1);
+			tileSamples[t]++;
+		});
+		if (cancel) break;
+		publish();
+	}
+	done = true;
+}
+
+//--------------------------------------------------------------
+void PreviewRenderer::publish() {
+	std::lock_guard<std::mutex> guard(publishLock);
+	published = working;
+	fresh = true;
+	passes++;
+}
+
+// Traces the center of every 4x4 block of the tile and fills the block with
+// the result.  Blocks are clipped to the tile, so threads still write
+// disjoint pixels.
+//
+//--------------------------------------------------------------
+void PreviewRenderer::coarseTile(const Tile &tile) {
+	std::vector<glm::vec2> uv;
+	std::vector<glm::vec3> colors;
+	for (int y = tile.y0; y < tile.y1; y += kCoarseBlock) {
+		uv.clear();
+		for (int x = tile.x0; x < tile.x1; x += kCoarseBlock) {
+			float cx = 0.5f * (x + std::min(x + kCoarseBlock, tile.x1));
+			float cy = 0.5f * (y + std::min(y + kCoarseBlock, tile.y1));
+			uv.push_back(glm::vec2(cx / width, cy / height));
+		}
+		renderer.traceSamples(uv, kCoarseBlock, colors);
+		for (size_t b = 0; b < colors.size(); b++) {
+			int x0 = tile.x0 + int(b) * kCoarseBlock;
+			for (int j = y; j < std::min(y + kCoarseBlock, tile.y1); j++) {
+				for (int i = x0; i < std::min(x0 + kCoarseBlock, tile.x1); i++) {
+					working.setColor(i, height - j - 1, renderer.toneMap.apply(colors[b]));
+				}
+			}
+		}
+	}
+}
+
+// One sample per pixel: through the center on the first pass, so that it
+// matches a render without antialiasing, and from the Sampler after that.  The first
+// pass also records the depth that invalidate() works from.
+//
+//--------------------------------------------------------------
+void PreviewRenderer::fineTile(const Tile &tile, int pass) {
+	std::vector<glm::vec2> uv;
+	std::vector<glm::vec3> colors;
+	std::vector<float> hitDepth;
+	for (int j = tile.y0; j < tile.y1; j++) {
+		uv.clear();
+		for (int i = tile.x0; i < tile.x1; i++) {
+			glm::vec2 s(0.5f, 0.5f);
+			if (pass > 1) {
+				uint32_t pixel = uint32_t(j) * uint32_t(width) + uint32_t(i);
+				s = renderer.sampler.get2D(pixel, uint32_t(pass - 2), kPixelSamples);
+			}
+			uv.push_back(glm::vec2((i + s.x) / width, (j + s.y) / height));
+		}
+		renderer.traceSamples(uv, 1, colors, pass == 1 ? &hitDepth : nullptr);
+		for (int i = tile.x0; i < tile.x1; i++) {
+			size_t k = size_t(j) * width + i;
+			const glm::vec3 &v = colors[i - tile.x0];
+			if (pass == 1) {
+				sum[k] = v;
+				depth[k] = hitDepth[i - tile.x0];
+			}
+			else sum[k] += v;
+			working.setColor(i, height - j - 1, renderer.toneMap.apply(sum[k] / float(pass)));
+		}
+	}
+}
+
+//--------------------------------------------------------------
+void PreviewRenderer::invalidate(SceneObject *o) {
+	if (Light *light = dynamic_cast<Light *>(o)) {
+		invalidateLight(light->position, light->range);
+		return;
+	}
+	AABB box;
+	if (o->getBounds(box)) invalidate(box);
+	else invalidateAll();
+}
+
+// A pixel is dirty if the box is in front of the surface seen through it, or
+// if the box is between that surface and a light reaching it.  Only tiles
+// that have had a full-resolution pass are checked: the others will be traced
+// from scratch anyway.
+//
+//--------------------------------------------------------------
+void PreviewRenderer::invalidate(const AABB &box) {
+	if (tiles.empty() || box.empty()) return;
+	
+	// grow the box by a pixel's width at its distance, so that something
+	// smaller than a pixel can't slip between pixel centers, and by how far
+	// rays from the edge of a lens stray from the ray through its center
+	glm::vec3 d0 = cam.getRay(0.5f, 0.5f).d;
+	glm::vec3 d1 = cam.getRay(0.5f + 1.0f / width, 0.5f).d;
+	float distance = glm::length(box.center() - cam.position) + 0.5f * glm::length(box.extent());
+	float focus = cam.focusDistance > 0 ? cam.focusDistance : cam.viewDistance();
+	float blur = focus > 0 ? cam.aperture * std::max(1.0f, distance / focus) : 0;
+	glm::vec3 pad(distance * glm::length(d1 - d0) + blur);
+	AABB seen(box.min - pad, box.max + pad);
+	
+	const RenderScene &rs = renderer.renderScene;
+	std::vector<char> dirty(size_t(width) * height, 0);
+	for (size_t t = 0; t < tiles.size(); t++) {
+		if (tileSamples[t] < 1) continue;
+		const Tile &tile = tiles[t];
+		for (int j = tile.y0; j < tile.y1; j++) {
+			for (int i = tile.x0; i < tile.x1; i++) {
+				size_t k = size_t(j) * width + i;
+				Ray ray = cam.getRay((i + 0.5f) / width, (j + 0.5f) / height);
+				float tNear;
+				if (seen.intersect(ray.p, 1.0f / ray.d, depth[k], tNear)) {
+					dirty[k] = 1;
+					continue;
+				}
+				if (depth[k] == FLT_MAX || !renderer.shadows) continue;
+				
+				glm::vec3 p = ray.evalPoint(depth[k]);
+				rs.forEachLight(p, [&](int light) {
+					glm::vec3 toLight = rs.lightPosition[light] - p;
+					if (!dirty[k] && box.intersect(p, 1.0f / toLight, 1, tNear)) dirty[k] = 1;
+				});
+			}
+		}
+	}
+	markTiles(dirty);
+}
+
+//--------------------------------------------------------------
+void PreviewRenderer::invalidateLight(const glm::vec3 &position, float range) {
+	if (tiles.empty()) return;
+	if (range <= 0) {
+		invalidateAll();
+		return;
+	}
+	
+	std::vector<char> dirty(size_t(width) * height, 0);
+	for (size_t t = 0; t < tiles.size(); t++) {
+		if (tileSamples[t] < 1) continue;
+		const Tile &tile = tiles[t];
+		for (int j = tile.y0; j < tile.y1; j++) {
+			for (int i = tile.x0; i < tile.x1; i++) {
+				size_t k = size_t(j) * width + i;
+				if (depth[k] == FLT_MAX) continue;
+				glm::vec3 d = cam.getRay((i + 0.5f) / width, (j + 0.5f) / height).evalPoint(depth[k]) - position;
+				dirty[k] = glm::dot(d, d) <= range * range;
+			}
+		}
+	}
+	markTiles(dirty);
+}
+
+//--------------------------------------------------------------
+void PreviewRenderer::invalidateAll() {
+	std::fill(tileSamples.begin(), tileSamples.end(), -1);
+}
+
+// Marks the tiles holding dirty pixels, and their neighbours where a dirty
+// pixel is on the edge: the depth is only known at pixel centers, so a pixel
+// next to a dirty one may be partly dirty too.
+//
+//--------------------------------------------------------------
+void PreviewRenderer::markTiles(const std::vector<char> &dirty) {
+	int size = renderer.tileSize;
+	int tilesX = (width + size - 1) / size;
+	int tilesY = (height + size - 1) / size;
+	for (int j = 0; j < height; j++) {
+		for (int i = 0; i < width; i++) {
+			if (!dirty[size_t(j) * width + i]) continue;
+			int tx0 = std::max(0, i - 1) / size, tx1 = std::min(width - 1, i + 1) / size;
+			int ty0 = std::max(0, j - 1) / size, ty1 = std::min(height - 1, j + 1) / size;
+			for (int ty = ty0; ty <= std::min(ty1, tilesY - 1); ty++) {
+				for (int tx = tx0; tx <= std::min(tx1, tilesX - 1); tx++) tileSamples[ty * tilesX + tx] = -1;
+			}
+		}
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Renderer.h"
+
+//  Renders a scene progressively on a background thread, for the app's
+//  interactive preview.
+//
+//  start() takes a snapshot of the scene and camera on the calling thread,
+//  then refines the image in passes on the background thread: one ray per
+//  4x4 block of pixels (1/16 of the full resolution) first, then one ray
+//  through every pixel center, then one more ray per pixel each pass, placed
+//  by the renderer's Sampler and averaged with the ones before, up to
+//  maxSamples.  Every finished pass is
+//  published; fetch() copies out the newest.
+//
+//  Tracing runs on a pool one thread short of the number of cores, so the
+//  caller's thread keeps a core to itself.  stop() abandons the current pass
+//  at the next tile, so restarting after each edit is cheap.
+//
+//  After an edit that doesn't move the camera, resume() instead of start()
+//  keeps the tiles the edit can't have changed.  Before resuming, invalidate()
+//  each edited object both where it was and where it is now: that marks the
+//  tiles where it can be seen or can cast a shadow on what is seen (or, for a
+//  light, the tiles it lights), using the distance to the surface seen
+//  through each pixel.  Only marked tiles are traced again.
+//
+//  Spheres, planes and lights are copied into the snapshot, but meshes and
+//  textures are read from the Scene while tracing: stop() before changing
+//  those.  stop() also before invalidating.
+//
+class PreviewRenderer {
+public:
+	explicit PreviewRenderer(Scene &scene) : renderer(scene, cam) {}
+	~PreviewRenderer() { stop(); }
+	PreviewRenderer(const PreviewRenderer &) = delete;
+	PreviewRenderer &operator=(const PreviewRenderer &) = delete;
+	
+	void start(const RenderCam &view);
+	void resume();    // like start() with the same camera, keeping tiles not invalidated since
+	void stop();
+	
+	void invalidate(SceneObject *o);
+	void invalidate(const AABB &box);    // an object inside box changed
+	void invalidateLight(const glm::vec3 &position, float range);    // a light changed; range 0 = no limit
+	void invalidateAll();
+	
+	// Copies the newest pass into image and returns true, if there has been
+	// one since the last call.
+	//
+	bool fetch(Image &image);
+	
+	bool cameraChanged(const RenderCam &view) const;    // does view differ from the camera being rendered?
+	int passesDone() const { return passes; }
+	bool finished() const { return done; }
+	int dirtyTiles() const;    // tiles to be traced again by resume()
+	
+	int width = 600;
+	int height = 400;
+	int maxSamples = 16;    // per pixel; refining stops here
+	
+	RenderCam cam;
+	Renderer renderer;    // shading settings (power, shadows, ...) are read from here; start() picks up changes
+	
+private:
+	void launch();
+	void run();
+	void coarseTile(const Tile &tile);
+	void fineTile(const Tile &tile, int pass);
+	void publish();
+	void markTiles(const std::vector<char> &dirty);
+	
+	std::unique_ptr<ThreadPool> pool;
+	std::thread worker;
+	std::atomic<bool> cancel{ false };
+	std::atomic<bool> done{ false };
+	std::atomic<int> passes{ 0 };
+	
+	std::vector<Tile> tiles;
+	std::vector<int> tileSamples;    // per tile: -1 = not traced yet, 0 = coarse pass only
+	std::vector<glm::vec3> sum;      // samples added up per pixel, rows from the bottom
+	std::vector<float> depth;        // distance to the surface through each pixel center, FLT_MAX for none
+	Image working;                   // written by the current pass
+	
+	std::mutex publishLock;
+	Image published;
+	bool fresh = false;
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "VecMath.h"
+
+//  General Purpose Ray class
+//
+class Ray {
+public:
+	Ray(glm::vec3 p, glm::vec3 d) { this->p = p; this->d = d; }
+	
+	glm::vec3 evalPoint(float t) const {
+		return (p + t * d);
+	}
+	
+	glm::vec3 p, d;
+};
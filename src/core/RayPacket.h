@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Simd.h"
+#include "Ray.h"
+
+//  kSimdWidth rays stored lane by lane, traced together.  Rays for
+//  neighbouring pixels start at the same camera point and point in nearly the
+//  same direction, so they tend to visit the same BVH nodes and hit the same
+//  primitives.
+//
+struct RayPacket {
+	// Fills the first n lanes from rays; the remaining lanes are inactive
+	// copies of the first ray.
+	//
+	RayPacket(const Ray *rays, int n) : count(n) {
+		float o[3][kSimdWidth], d[3][kSimdWidth], inv[3][kSimdWidth];
+		for (int i = 0; i < kSimdWidth; i++) {
+			const Ray &r = rays[i < n ? i : 0];
+			for (int a = 0; a < 3; a++) {
+				o[a][i] = r.p[a];
+				d[a][i] = r.d[a];
+				inv[a][i] = 1.0f / r.d[a];
+			}
+		}
+		ox = SimdFloat::load(o[0]); oy = SimdFloat::load(o[1]); oz = SimdFloat::load(o[2]);
+		dx = SimdFloat::load(d[0]); dy = SimdFloat::load(d[1]); dz = SimdFloat::load(d[2]);
+		invDx = SimdFloat::load(inv[0]); invDy = SimdFloat::load(inv[1]); invDz = SimdFloat::load(inv[2]);
+		active = SimdFloat::firstLanes(n);
+	}
+	
+	SimdFloat ox, oy, oz;
+	SimdFloat dx, dy, dz;
+	SimdFloat invDx, invDy, invDz;
+	SimdFloat active;    // lane mask
+	int count;
+};
@@ -0,0 +1,492 @@
+#include "RenderScene.h"
+#include "FrameBuffer.h"
+
+#include <cmath>
+
+enum PrimitiveKind { kSphere, kPlane, kOther, kInstance };
+
+static const float kRebuildCost = 1.5f;    // refit() builds again once a tree costs this much more than when built
+
+//--------------------------------------------------------------
+void RenderScene::build(const Scene &scene) {
+	*this = RenderScene();
+	textures = &scene.textures;
+	
+	std::vector<AABB> bounds;
+	std::vector<int> sphereObjects;
+	std::map<uint64_t, int> materialIds;
+	
+	for (size_t n = 0; n < scene.objects.size(); n++) {
+		SceneObject *obj = scene.objects[n];
+		if (Sphere *sphere = dynamic_cast<Sphere *>(obj)) {
+			AABB box;
+			sphere->getBounds(box);
+			bounds.push_back(box);
+			sphereObjects.push_back(int(n));
+		}
+		else if (Plane *plane = dynamic_cast<Plane *>(obj)) {
+			PlaneData p;
+			p.point = plane->position;
+			p.normal = plane->normal;
+			p.halfWidth = plane->width * 0.5f;
+			p.halfHeight = plane->height * 0.5f;
+			p.object = int(n);
+			p.material = addMaterial(scene, int(n), materialIds);
+			planes.push_back(p);
+		}
+		else {
+			others.push_back(obj);
+			otherObject.push_back(int(n));
+			otherMaterial.push_back(addMaterial(scene, int(n), materialIds));
+		}
+	}
+	
+	// Store the spheres in BVH leaf order, so that each leaf covers a
+	// contiguous range of the arrays, then make the BVH refer to them by
+	// position.
+	sphereBvh.build(bounds, kSimdWidth);
+	sphereCount = int(sphereObjects.size());
+	size_t padded = sphereCount + kSimdWidth;
+	sphereX.assign(padded, 0);
+	sphereY.assign(padded, 0);
+	sphereZ.assign(padded, 0);
+	sphereRadius.assign(padded, 0);
+	sphereMaterial.assign(sphereCount, 0);
+	sphereObject.assign(sphereCount, 0);
+	for (int i = 0; i < sphereCount; i++) {
+		int object = sphereObjects[sphereBvh.prims[i]];
+		SceneObject *sphere = scene.objects[object];
+		sphereX[i] = sphere->position.x;
+		sphereY[i] = sphere->position.y;
+		sphereZ[i] = sphere->position.z;
+		sphereRadius[i] = sphere->getRadius();
+		sphereObject[i] = object;
+		sphereMaterial[i] = addMaterial(scene, object, materialIds);
+		sphereBvh.prims[i] = i;
+	}
+	
+	// Instances the same way, with their transforms inverted.  Those whose
+	// prototype can't be bounded, or whose transform flattens it, are left
+	// out.
+	prototypes = scene.prototypes;
+	std::vector<AABB> prototypeBounds(prototypes.size());
+	std::vector<char> bounded(prototypes.size());
+	for (size_t i = 0; i < prototypes.size(); i++) bounded[i] = prototypes[i]->getBounds(prototypeBounds[i]);
+	std::vector<AABB>().swap(bounds);
+	std::vector<int> placed;
+	for (size_t i = 0; i < scene.instances.size(); i++) {
+		const Instance &inst = scene.instances[i];
+		const Transform &m = inst.transform;
+		if (inst.prototype >= prototypes.size() || !bounded[inst.prototype] || glm::dot(m.x, glm::cross(m.y, m.z)) == 0) continue;
+		bounds.push_back(m.bounds(prototypeBounds[inst.prototype]));
+		placed.push_back(int(i));
+	}
+	instanceBvh.build(bounds, 2);
+	std::vector<AABB>().swap(bounds);
+	instances.resize(placed.size());
+	instanceSource.resize(placed.size());
+	for (size_t i = 0; i < placed.size(); i++) {
+		instanceSource[i] = placed[instanceBvh.prims[i]];
+		const Instance &inst = scene.instances[instanceSource[i]];
+		InstanceData &d = instances[i];
+		d.toPrototype = inst.transform.inverse();
+		d.prototype = int(inst.prototype);
+		d.material = addMaterial(scene, inst.diffuseColor, inst.texture, materialIds);
+		instanceBvh.prims[i] = int(i);
+	}
+	
+	// Lights with a range are found through a BVH over their spheres of
+	// influence, so that each point only visits the lights that reach it.
+	std::vector<AABB> lightBounds;
+	std::vector<LightTree::Light> treeLights;
+	for (size_t i = 0; i < scene.lights.size(); i++) {
+		Light *light = scene.lights[i];
+		lightPosition.push_back(light->position);
+		lightIntensity.push_back(light->intensity);
+		lightRadius.push_back(light->getRadius());
+		lightRange.push_back(light->range);
+		LightTree::Light t = { light->position, light->getRadius(), light->intensity, light->range };
+		treeLights.push_back(t);
+		if (light->range > 0) {
+			rangedLights.push_back(int(i));
+			lightBounds.push_back(AABB(light->position - glm::vec3(light->range), light->position + glm::vec3(light->range)));
+		}
+		else unlimitedLights.push_back(int(i));
+	}
+	lightBvh.build(lightBounds);
+	lightTree.build(treeLights);
+	
+	sceneEdits = scene.editCount();
+	instanceCount = scene.instances.size();
+	sphereBvhCost = sphereBvh.cost();
+	instanceBvhCost = instanceBvh.cost();
+}
+
+// Everything is rewritten from the scene in the order build() left it in:
+// spheres and instances by their back references, so the BVHs' leaves still
+// cover the same entries.
+//
+bool RenderScene::refit(const Scene &scene) {
+	// spheres and planes are found by their index in objects, which any add or
+	// remove can change
+	if (textures != &scene.textures || scene.editCount() != sceneEdits || scene.instances.size() != instanceCount) {
+		build(scene);
+		return false;
+	}
+	
+	std::vector<AABB> bounds(sphereCount);
+	for (int i = 0; i < sphereCount; i++) {
+		SceneObject *sphere = scene.objects[sphereObject[i]];
+		float r = sphere->getRadius();
+		sphereX[i] = sphere->position.x;
+		sphereY[i] = sphere->position.y;
+		sphereZ[i] = sphere->position.z;
+		sphereRadius[i] = r;
+		bounds[i] = AABB(sphere->position - glm::vec3(r), sphere->position + glm::vec3(r));
+	}
+	sphereBvh.refit(bounds);
+	
+	for (size_t i = 0; i < planes.size(); i++) {
+		PlaneData &p = planes[i];
+		const Plane *plane = static_cast<const Plane *>(scene.objects[p.object]);
+		p.point = plane->position;
+		p.normal = plane->normal;
+		p.halfWidth = plane->width * 0.5f;
+		p.halfHeight = plane->height * 0.5f;
+	}
+	
+	// an instance that has lost its bounds or volume has to leave the tree
+	std::vector<AABB> prototypeBounds(prototypes.size());
+	for (size_t i = 0; i < prototypes.size(); i++) prototypes[i]->getBounds(prototypeBounds[i]);
+	bounds.resize(instances.size());
+	for (size_t i = 0; i < instances.size(); i++) {
+		const Instance &inst = scene.instances[instanceSource[i]];
+		const Transform &m = inst.transform;
+		InstanceData &d = instances[i];
+		if (int(inst.prototype) != d.prototype || prototypeBounds[d.prototype].empty() || glm::dot(m.x, glm::cross(m.y, m.z)) == 0) {
+			build(scene);
+			return false;
+		}
+		d.toPrototype = m.inverse();
+		bounds[i] = m.bounds(prototypeBounds[d.prototype]);
+	}
+	instanceBvh.refit(bounds);
+	
+	// a light that gains or loses its range moves between lists
+	std::vector<AABB> lightBounds;
+	std::vector<LightTree::Light> treeLights;
+	for (size_t i = 0; i < scene.lights.size(); i++) {
+		Light *light = scene.lights[i];
+		if ((light->range > 0) != (lightRange[i] > 0)) {
+			build(scene);
+			return false;
+		}
+		lightPosition[i] = light->position;
+		lightIntensity[i] = light->intensity;
+		lightRadius[i] = light->getRadius();
+		lightRange[i] = light->range;
+		LightTree::Light t = { light->position, light->getRadius(), light->intensity, light->range };
+		treeLights.push_back(t);
+	}
+	for (size_t k = 0; k < rangedLights.size(); k++) {
+		int i = rangedLights[k];
+		lightBounds.push_back(AABB(lightPosition[i] - glm::vec3(lightRange[i]), lightPosition[i] + glm::vec3(lightRange[i])));
+	}
+	lightBvh.refit(lightBounds);
+	lightTree.refit(treeLights);
+	
+	if (sphereBvh.cost() > kRebuildCost * sphereBvhCost || instanceBvh.cost() > kRebuildCost * instanceBvhCost) {
+		build(scene);
+		return false;
+	}
+	return true;
+}
+
+// Returns the index of a material, adding it if no identical material exists
+// yet.  Highlights have always been white.
+//
+int RenderScene::addMaterial(const Scene &scene, const Color &diffuse, TextureHandle texture, std::map<uint64_t, int> &ids) {
+	const Color &specular = Color::white;
+	Material m;
+	m.diffuse = toFloat(diffuse);
+	m.specular = toFloat(specular);
+	if (scene.textures.contains(texture)) m.texture = texture;
+	
+	uint64_t key = uint64_t(diffuse.r) | uint64_t(diffuse.g) << 8 | uint64_t(diffuse.b) << 16
+		| uint64_t(specular.r) << 24 | uint64_t(specular.g) << 32 | uint64_t(specular.b) << 40
+		| uint64_t(m.texture.index + 1) << 48;
+	std::map<uint64_t, int>::iterator found = ids.find(key);
+	if (found != ids.end()) return found->second;
+	
+	materials.push_back(m);
+	ids[key] = int(materials.size()) - 1;
+	return ids[key];
+}
+
+//--------------------------------------------------------------
+int RenderScene::addMaterial(const Scene &scene, int object, std::map<uint64_t, int> &ids) {
+	const SceneObject *obj = scene.objects[object];
+	return addMaterial(scene, obj->diffuseColor, obj->texture, ids);
+}
+
+// A ray moved into an instance's prototype space, with its direction
+// normalized as the objects' intersect() functions expect.  Distances along
+// it are scale times those along the world ray.
+//
+static inline Ray prototypeRay(const RenderScene::InstanceData &inst, const Ray &ray, float &scale) {
+	glm::vec3 d = inst.toPrototype.vector(ray.d);
+	scale = glm::length(d);
+	return Ray(inst.toPrototype.point(ray.p), d / scale);
+}
+
+// Same for a packet, lane by lane
+//
+static inline RayPacket prototypePacket(const RenderScene::InstanceData &inst, const RayPacket &rays, SimdFloat &scale) {
+	const Transform &m = inst.toPrototype;
+	RayPacket local = rays;
+	local.ox = SimdFloat(m.x.x) * rays.ox + SimdFloat(m.y.x) * rays.oy + SimdFloat(m.z.x) * rays.oz + SimdFloat(m.t.x);
+	local.oy = SimdFloat(m.x.y) * rays.ox + SimdFloat(m.y.y) * rays.oy + SimdFloat(m.z.y) * rays.oz + SimdFloat(m.t.y);
+	local.oz = SimdFloat(m.x.z) * rays.ox + SimdFloat(m.y.z) * rays.oy + SimdFloat(m.z.z) * rays.oz + SimdFloat(m.t.z);
+	SimdFloat dx = SimdFloat(m.x.x) * rays.dx + SimdFloat(m.y.x) * rays.dy + SimdFloat(m.z.x) * rays.dz;
+	SimdFloat dy = SimdFloat(m.x.y) * rays.dx + SimdFloat(m.y.y) * rays.dy + SimdFloat(m.z.y) * rays.dz;
+	SimdFloat dz = SimdFloat(m.x.z) * rays.dx + SimdFloat(m.y.z) * rays.dy + SimdFloat(m.z.z) * rays.dz;
+	scale = sqrt(dx * dx + dy * dy + dz * dz);
+	local.dx = dx / scale;
+	local.dy = dy / scale;
+	local.dz = dz / scale;
+	local.invDx = SimdFloat(1.0f) / local.dx;
+	local.invDy = SimdFloat(1.0f) / local.dy;
+	local.invDz = SimdFloat(1.0f) / local.dz;
+	return local;
+}
+
+// Ray vs the finite plane, with the same arithmetic as intersectPlane() so
+// that single rays and packets agree.  Sets t if the plane is hit before tMax.
+//
+static inline bool hitPlane(const Ray &ray, const RenderScene::PlaneData &p, float tMax, float &t) {
+	float denom = ray.d.x * p.normal.x + ray.d.y * p.normal.y + ray.d.z * p.normal.z;
+	t = ((p.point.x - ray.p.x) * p.normal.x + (p.point.y - ray.p.y) * p.normal.y + (p.point.z - ray.p.z) * p.normal.z) / denom;
+	if (!(std::fabs(denom) > kPacketEpsilon && t > 0 && t < tMax)) return false;
+	float x = ray.p.x + t * ray.d.x;
+	float z = ray.p.z + t * ray.d.z;
+	return x < p.point.x + p.halfWidth && x > p.point.x - p.halfWidth && z < p.point.z + p.halfHeight && z > p.point.z - p.halfHeight;
+}
+
+// Fills in a hit from the distance and primitive found by a query
+//
+void RenderScene::finishHit(const Ray &ray, float t, int kind, int index, Hit &hit) const {
+	hit.t = t;
+	hit.point = ray.evalPoint(t);
+	if (kind == kSphere) {
+		glm::vec3 center(sphereX[index], sphereY[index], sphereZ[index]);
+		hit.normal = (hit.point - center) / sphereRadius[index];
+		hit.object = sphereObject[index];
+		hit.material = sphereMaterial[index];
+	}
+	else if (kind == kPlane) {
+		hit.normal = planes[index].normal;
+		hit.object = planes[index].object;
+		hit.material = planes[index].material;
+	}
+	else if (kind == kInstance) {
+		const InstanceData &inst = instances[index];
+		float scale;
+		glm::vec3 point, normal;
+		prototypes[inst.prototype]->intersect(prototypeRay(inst, ray, scale), point, normal);
+		hit.normal = glm::normalize(inst.toPrototype.transposeVector(normal));
+		hit.object = -1;
+		hit.material = inst.material;
+	}
+	else {
+		others[index]->intersect(ray, hit.point, hit.normal);
+		hit.object = otherObject[index];
+		hit.material = otherMaterial[index];
+	}
+}
+
+// Finds the closest primitive along the ray.  Ray directions are expected to
+// be normalized, so hit.t is the distance from the ray origin.
+//
+bool RenderScene::intersect(const Ray &ray, Hit &hit) const {
+	float tMax = FLT_MAX;
+	int kind = -1, index = -1;
+	
+	sphereBvh.closestHitLeaves(ray, tMax, [&](int start, int count, float &t) {
+		RT_COUNT(primitiveTests, count);
+		int s = intersectSpheres(ray, &sphereX[start], &sphereY[start], &sphereZ[start], &sphereRadius[start], count, t);
+		if (s < 0) return false;
+		kind = kSphere;
+		index = start + s;
+		return true;
+	});
+	instanceBvh.closestHit(ray, tMax, [&](int i, float &t) {
+		RT_COUNT(primitiveTests, 1);
+		float scale;
+		Ray local = prototypeRay(instances[i], ray, scale);
+		glm::vec3 point, normal;
+		if (!prototypes[instances[i].prototype]->intersect(local, point, normal)) return false;
+		float tHit = glm::dot(point - local.p, local.d) / scale;
+		if (!(tHit > 0 && tHit < t)) return false;
+		t = tHit;
+		kind = kInstance;
+		index = i;
+		return true;
+	});
+	
+	RT_COUNT(primitiveTests, planes.size() + others.size());
+	for (size_t i = 0; i < planes.size(); i++) {
+		float t;
+		if (hitPlane(ray, planes[i], tMax, t)) {
+			tMax = t;
+			kind = kPlane;
+			index = int(i);
+		}
+	}
+	
+	for (size_t i = 0; i < others.size(); i++) {
+		glm::vec3 point, normal;
+		if (!others[i]->intersect(ray, point, normal)) continue;
+		float t = glm::dot(point - ray.p, ray.d);
+		if (t > 0 && t < tMax) {
+			tMax = t;
+			kind = kOther;
+			index = int(i);
+		}
+	}
+	
+	if (kind < 0) return false;
+	finishHit(ray, tMax, kind, index, hit);
+	return true;
+}
+
+// Stops at the first blocker found, in whatever order
+//
+bool RenderScene::occluded(const Ray &ray, float maxDist) const {
+	bool blocked = sphereBvh.anyHitLeaves(ray, maxDist, [&](int start, int count, float &t) {
+		RT_COUNT(primitiveTests, count);
+		return intersectSpheres(ray, &sphereX[start], &sphereY[start], &sphereZ[start], &sphereRadius[start], count, t) >= 0;
+	});
+	if (blocked) return true;
+	blocked = instanceBvh.anyHit(ray, maxDist, [&](int i, float &t) {
+		RT_COUNT(primitiveTests, 1);
+		float scale;
+		Ray local = prototypeRay(instances[i], ray, scale);
+		return prototypes[instances[i].prototype]->occludes(local, t * scale);
+	});
+	if (blocked) return true;
+	
+	RT_COUNT(primitiveTests, planes.size() + others.size());
+	for (size_t i = 0; i < planes.size(); i++) {
+		float t;
+		if (hitPlane(ray, planes[i], maxDist, t)) return true;
+	}
+	for (size_t i = 0; i < others.size(); i++) {
+		if (others[i]->occludes(ray, maxDist)) return true;
+	}
+	return false;
+}
+
+// Packet shadow query, for up to kSimdWidth rays.  Lanes are answered the
+// same as by the single ray version.
+//
+int RenderScene::occluded(const Ray *rays, const float *maxDist, int count) const {
+	RayPacket packet(rays, count);
+	float lanes[kSimdWidth];
+	for (int i = 0; i < kSimdWidth; i++) lanes[i] = maxDist[i < count ? i : 0];
+	SimdFloat tMax = SimdFloat::load(lanes);
+	int all = moveMask(packet.active);
+	
+	int blocked = moveMask(sphereBvh.anyHit(packet, tMax, [&](int s, SimdFloat t) {
+		RT_COUNT(primitiveTests, 1);
+		glm::vec3 center(sphereX[s], sphereY[s], sphereZ[s]);
+		return intersectSphere(packet, center, sphereRadius[s], t);
+	}));
+	
+	// lanes already blocked get a tMax of 0, so they drop out at once
+	if (!instanceBvh.empty() && blocked != all) {
+		for (int i = 0; i < kSimdWidth; i++) {
+			if (blocked & (1 << i)) lanes[i] = 0;
+		}
+		blocked |= moveMask(instanceBvh.anyHit(packet, SimdFloat::load(lanes), [&](int i, SimdFloat t) {
+			RT_COUNT(primitiveTests, 1);
+			SimdFloat scale;
+			RayPacket local = prototypePacket(instances[i], packet, scale);
+			SimdFloat tLocal = t * scale;
+			return prototypes[instances[i].prototype]->intersect(local, tLocal);
+		}));
+	}
+	
+	// what is left is tested lane by lane, against planes and other objects
+	for (int i = 0; i < count && blocked != all; i++) {
+		if (blocked & (1 << i)) continue;
+		RT_COUNT(primitiveTests, planes.size() + others.size());
+		for (size_t k = 0; k < planes.size(); k++) {
+			float t;
+			if (hitPlane(rays[i], planes[k], maxDist[i], t)) {
+				blocked |= 1 << i;
+				break;
+			}
+		}
+		if (blocked & (1 << i)) continue;
+		for (size_t k = 0; k < others.size(); k++) {
+			if (others[k]->occludes(rays[i], maxDist[i])) {
+				blocked |= 1 << i;
+				break;
+			}
+		}
+	}
+	return blocked;
+}
+
+// Traces count <= kSimdWidth rays together and fills hits[i] for each ray
+// that hits something.  Returns a bit mask of those rays.
+//
+int RenderScene::intersect(const Ray *rays, int count, Hit *hits) const {
+	RayPacket packet(rays, count);
+	SimdFloat tHit(FLT_MAX);
+	int kind[kSimdWidth], index[kSimdWidth];
+	for (int i = 0; i < kSimdWidth; i++) kind[i] = -1;
+	
+	auto record = [&](SimdFloat mask, int k, int n) {
+		int bits = moveMask(mask);
+		for (int i = 0; bits != 0; i++, bits >>= 1) {
+			if (bits & 1) {
+				kind[i] = k;
+				index[i] = n;
+			}
+		}
+	};
+	
+	sphereBvh.closestHit(packet, tHit, [&](int s, SimdFloat &tMax) {
+		RT_COUNT(primitiveTests, 1);
+		glm::vec3 center(sphereX[s], sphereY[s], sphereZ[s]);
+		record(intersectSphere(packet, center, sphereRadius[s], tMax), kSphere, s);
+	});
+	instanceBvh.closestHit(packet, tHit, [&](int i, SimdFloat &tMax) {
+		RT_COUNT(primitiveTests, 1);
+		SimdFloat scale;
+		RayPacket local = prototypePacket(instances[i], packet, scale);
+		SimdFloat tLocal = tMax * scale;
+		SimdFloat mask = prototypes[instances[i].prototype]->intersect(local, tLocal);
+		tMax = select(mask, tLocal / scale, tMax);
+		record(mask, kInstance, i);
+	});
+	RT_COUNT(primitiveTests, planes.size() + others.size());
+	for (size_t i = 0; i < planes.size(); i++) {
+		const PlaneData &p = planes[i];
+		record(intersectPlane(packet, p.point, p.normal, p.halfWidth, p.halfHeight, tHit), kPlane, int(i));
+	}
+	for (size_t i = 0; i < others.size(); i++) {
+		record(others[i]->intersect(packet, tHit), kOther, int(i));
+	}
+	
+	float t[kSimdWidth];
+	tHit.store(t);
+	int found = 0;
+	for (int i = 0; i < count; i++) {
+		if (kind[i] < 0) continue;
+		finishHit(rays[i], t[i], kind[i], index[i], hits[i]);
+		found |= 1 << i;
+	}
+	return found;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <cstdint>
+#include "Scene.h"
+#include "BVH.h"
+#include "LightTree.h"
+#include "RenderStats.h"
+
+//  Shading parameters shared by any number of primitives
+//
+struct Material {
+	glm::vec3 diffuse;     // float color, see FrameBuffer.h
+	glm::vec3 specular;
+	TextureHandle texture;    // in Scene::textures
+};
+
+//  Flat, read-only copy of a Scene made when a render starts.
+//
+//  Spheres are stored as separate arrays of x, y, z, radius and material
+//  (24 bytes a sphere with the back reference to the scene object) in the
+//  order of the leaves of their BVH, so a leaf is a contiguous block that one
+//  ray can test kSimdWidth spheres at a time, and a packet can test one after
+//  another without chasing pointers or calling through a vtable.  Planes are
+//  few and unbounded in practice, so they are kept in a short list that every
+//  ray tests.  Objects of any other type are kept as pointers and tested
+//  through SceneObject::intersect().
+//
+//  Instances get a BVH of their own, with each instance stored as the
+//  inverse of its transform (world to prototype space) in the BVH's leaf
+//  order.  A ray that reaches an instance is moved into prototype space and
+//  tested against the prototype, which for a mesh means its own BVH, so the
+//  instances share one copy of the prototype's triangles and tree.
+//
+//  The snapshot is independent of later edits to the Scene, except that it
+//  refers to the scene's textures and prototypes rather than copying them.
+//
+//  refit() brings a snapshot up to date with a scene whose spheres, planes,
+//  lights and instances have moved, resized or changed intensity since
+//  build(), without sorting anything again: the arrays keep their order and
+//  the BVHs their shape, with boxes recomputed around the new positions.
+//  It builds from scratch instead if objects, lights or prototypes have been
+//  added or removed since (see Scene::editCount()) or the number of
+//  instances has changed, and once refitting has made the sphere or instance
+//  tree half as costly again as it was when built (see BVH::cost()).  Colors
+//  and textures are only picked up by build().
+//
+class RenderScene {
+public:
+	void build(const Scene &scene);
+	bool refit(const Scene &scene);    // returns false if it had to build instead
+	
+	bool intersect(const Ray &ray, Hit &hit) const;
+	int intersect(const Ray *rays, int count, Hit *hits) const;    // up to kSimdWidth rays traced as a packet
+	
+	// Shadow query: true if anything blocks the ray before maxDist
+	bool occluded(const Ray &ray, float maxDist) const;
+	int occluded(const Ray *rays, const float *maxDist, int count) const;    // packet version; returns a mask of the blocked rays
+	
+	// Calls visit(light) for each light whose range reaches point
+	template<class Visit>
+	void forEachLight(const glm::vec3 &point, Visit visit) const;
+	
+	const Material &material(const Hit &hit) const { return materials[hit.material]; }
+	
+	struct PlaneData {
+		glm::vec3 point, normal;
+		float halfWidth, halfHeight;
+		int material;
+		int object;
+	};
+	
+	// spheres, in BVH leaf order, padded by kSimdWidth entries for vector loads
+	std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+	std::vector<int> sphereMaterial;
+	std::vector<int> sphereObject;    // index into Scene::objects
+	int sphereCount = 0;
+	BVH sphereBvh;
+	
+	std::vector<PlaneData> planes;
+	std::vector<SceneObject *> others;
+	std::vector<int> otherObject;
+	std::vector<int> otherMaterial;
+	
+	struct InstanceData {
+		Transform toPrototype;    // inverse of Instance::transform
+		int prototype;
+		int material;
+	};
+	
+	std::vector<InstanceData> instances;    // in BVH leaf order
+	BVH instanceBvh;
+	std::vector<SceneObject *> prototypes;  // the scene's
+	
+	std::vector<Material> materials;
+	
+	std::vector<glm::vec3> lightPosition;
+	std::vector<float> lightIntensity;
+	std::vector<float> lightRadius;
+	std::vector<float> lightRange;       // 0 = no limit
+	std::vector<int> unlimitedLights;    // lights without a range, which reach everywhere
+	std::vector<int> rangedLights;       // the others, in the order of lightBvh's primitives
+	BVH lightBvh;                        // over the spheres of influence of rangedLights
+	LightTree lightTree;                 // every light, for picking a few by importance
+	
+	const TextureStore *textures = nullptr;
+	
+private:
+	int addMaterial(const Scene &scene, const Color &diffuse, TextureHandle texture, std::map<uint64_t, int> &ids);
+	int addMaterial(const Scene &scene, int object, std::map<uint64_t, int> &ids);
+	void finishHit(const Ray &ray, float t, int kind, int index, Hit &hit) const;
+	
+	// what build() saw, for refit()
+	uint64_t sceneEdits = 0;    // Scene::editCount()
+	size_t instanceCount = 0;
+	std::vector<int> instanceSource;    // index into Scene::instances, by entry of instances
+	float sphereBvhCost = 0, instanceBvhCost = 0;
+};
+
+//--------------------------------------------------------------
+template<class Visit>
+void RenderScene::forEachLight(const glm::vec3 &point, Visit visit) const {
+	for (size_t i = 0; i < unlimitedLights.size(); i++) visit(unlimitedLights[i]);
+	lightBvh.containing(point, [&](int prim) {
+		int light = rangedLights[prim];
+		glm::vec3 d = point - lightPosition[light];
+		if (glm::dot(d, d) <= lightRange[light] * lightRange[light]) visit(light);
+	});
+}
@@ -0,0 +1,124 @@
+#include "RenderStats.h"
+
+#include <algorithm>
+#include <cstdio>
+
+//--------------------------------------------------------------
+StatCounters &StatCounters::operator+=(const StatCounters &c) {
+	primaryRays += c.primaryRays;
+	shadowRays += c.shadowRays;
+	nodeVisits += c.nodeVisits;
+	primitiveTests += c.primitiveTests;
+	shadeCalls += c.shadeCalls;
+	intersectNs += c.intersectNs;
+	shadeNs += c.shadeNs;
+	shadowNs += c.shadowNs;
+	return *this;
+}
+
+//--------------------------------------------------------------
+StatCounters StatCounters::operator-(const StatCounters &c) const {
+	StatCounters d;
+	d.primaryRays = primaryRays - c.primaryRays;
+	d.shadowRays = shadowRays - c.shadowRays;
+	d.nodeVisits = nodeVisits - c.nodeVisits;
+	d.primitiveTests = primitiveTests - c.primitiveTests;
+	d.shadeCalls = shadeCalls - c.shadeCalls;
+	d.intersectNs = intersectNs - c.intersectNs;
+	d.shadeNs = shadeNs - c.shadeNs;
+	d.shadowNs = shadowNs - c.shadowNs;
+	return d;
+}
+
+//--------------------------------------------------------------
+int64_t RenderStats::nowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//--------------------------------------------------------------
+void RenderStats::begin(int w, int h, int threads) {
+	width = w;
+	height = h;
+	tiles.clear();
+	perThread.assign(threads, std::vector<TileRecord>());
+	startNs = endNs = nowNs();
+}
+
+// Each thread only touches its own list, so no locking.  Tiles traced
+// outside begin() and end() (a distributed worker's jobs, say) aren't kept.
+//
+//--------------------------------------------------------------
+void RenderStats::addTile(int thread, const TileRecord &record) {
+	if (size_t(thread) < perThread.size()) perThread[thread].push_back(record);
+}
+
+//--------------------------------------------------------------
+void RenderStats::end() {
+	endNs = nowNs();
+	for (size_t t = 0; t < perThread.size(); t++) tiles.insert(tiles.end(), perThread[t].begin(), perThread[t].end());
+	perThread.clear();
+	std::sort(tiles.begin(), tiles.end(), [](const TileRecord &a, const TileRecord &b) { return a.startNs < b.startNs; });
+}
+
+//--------------------------------------------------------------
+StatCounters RenderStats::totals() const {
+	StatCounters sum;
+	for (size_t i = 0; i < tiles.size(); i++) sum += tiles[i].counters;
+	return sum;
+}
+
+// Each tile filled with its time, relative to the slowest tile: black, then
+// red, yellow and white.  Rows from the top, like the image.
+//
+//--------------------------------------------------------------
+void RenderStats::heatmap(Image &image) const {
+	image.allocate(width, height);
+	int64_t slowest = 1;
+	for (size_t i = 0; i < tiles.size(); i++) slowest = std::max(slowest, tiles[i].endNs - tiles[i].startNs);
+	
+	for (size_t i = 0; i < tiles.size(); i++) {
+		const Tile &t = tiles[i].tile;
+		float heat = 3.0f * float(tiles[i].endNs - tiles[i].startNs) / float(slowest);
+		Color c(255 * std::min(heat, 1.0f), 255 * std::min(std::max(heat - 1, 0.0f), 1.0f), 255 * std::max(heat - 2, 0.0f));
+		for (int j = t.y0; j < t.y1; j++) {
+			for (int x = t.x0; x < t.x1; x++) image.setColor(x, height - 1 - j, c);
+		}
+	}
+}
+
+static void writeCounters(FILE *f, const StatCounters &c) {
+	fprintf(f, "\"primary_rays\":%llu,\"shadow_rays\":%llu,\"node_visits\":%llu,\"primitive_tests\":%llu,\"shade_calls\":%llu",
+		(unsigned long long)c.primaryRays, (unsigned long long)c.shadowRays, (unsigned long long)c.nodeVisits,
+		(unsigned long long)c.primitiveTests, (unsigned long long)c.shadeCalls);
+	fprintf(f, ",\"intersect_us\":%.1f,\"shade_us\":%.1f,\"shadow_us\":%.1f",
+		c.intersectNs / 1e3, c.shadeNs / 1e3, c.shadowNs / 1e3);
+}
+
+// Chrome's trace event format: "X" events are spans with a start and a
+// duration in microseconds.  Totals go in otherData, which viewers show as
+// metadata.
+//
+//--------------------------------------------------------------
+bool RenderStats::save(const std::string &path) const {
+	std::string tracePath = path + "_trace.json";
+	FILE *f = fopen(tracePath.c_str(), "w");
+	if (!f) return false;
+	
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"width\":%d,\"height\":%d,\"render_us\":%.1f,", width, height, renderNs() / 1e3);
+	writeCounters(f, totals());
+	fprintf(f, "},\n\"traceEvents\":[\n");
+	fprintf(f, "{\"name\":\"render\",\"ph\":\"X\",\"pid\":0,\"tid\":-1,\"ts\":0,\"dur\":%.3f}", renderNs() / 1e3);
+	for (size_t i = 0; i < tiles.size(); i++) {
+		const TileRecord &r = tiles[i];
+		fprintf(f, ",\n{\"name\":\"tile %d,%d\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+			r.tile.x0, r.tile.y0, r.thread, r.startNs / 1e3, (r.endNs - r.startNs) / 1e3);
+		writeCounters(f, r.counters);
+		fprintf(f, "}}");
+	}
+	fprintf(f, "\n]}\n");
+	bool ok = fclose(f) == 0;
+	
+	Image map;
+	heatmap(map);
+	return map.save(path + "_heatmap.png") && ok;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Image.h"
+#include "Tile.h"
+
+//  Counters and timings for finding out where render time goes.
+//
+//  Only built in when RAYTRACER_STATS is defined (make STATS=1 for the
+//  headless build).  Otherwise RT_COUNT() and RT_STAGE() compile to nothing
+//  and renders record no tiles.
+//
+//  Counting goes to a thread-local StatCounters, so threads never share a
+//  cache line.  Renderer::render() takes a copy of the counters before and
+//  after each tile, which gives each tile's share; the tiles are kept in
+//  Renderer::stats.  From those, save() writes a Chrome trace (load it in
+//  chrome://tracing or ui.perfetto.dev: one row per thread, one span per
+//  tile, with the tile's counters attached) and a heatmap image of time
+//  per tile.
+//
+struct StatCounters {
+	uint64_t primaryRays = 0;
+	uint64_t shadowRays = 0;
+	uint64_t nodeVisits = 0;        // BVH nodes entered, by any query
+	uint64_t primitiveTests = 0;    // ray (or packet) against one primitive
+	uint64_t shadeCalls = 0;        // hits shaded
+	
+	// wavefront stages (see Renderer::traceWavefront), nanoseconds
+	uint64_t intersectNs = 0;
+	uint64_t shadeNs = 0;
+	uint64_t shadowNs = 0;
+	
+	StatCounters &operator+=(const StatCounters &c);
+	StatCounters operator-(const StatCounters &c) const;
+};
+
+class RenderStats {
+public:
+	struct TileRecord {
+		Tile tile;
+		int thread;
+		int64_t startNs, endNs;    // since the render started
+		StatCounters counters;
+	};
+	
+	static StatCounters &local() {    // the calling thread's counters
+		static thread_local StatCounters counters;
+		return counters;
+	}
+	static int64_t nowNs();
+	
+	void begin(int width, int height, int threads);
+	void addTile(int thread, const TileRecord &record);
+	void end();
+	
+	StatCounters totals() const;
+	int64_t renderNs() const { return endNs - startNs; }
+	
+	void heatmap(Image &image) const;
+	
+	// Writes path + "_trace.json" and path + "_heatmap.png", path being the
+	// output image's file name without its extension
+	bool save(const std::string &path) const;
+	
+	int width = 0, height = 0;
+	int64_t startNs = 0, endNs = 0;
+	std::vector<TileRecord> tiles;
+	
+private:
+	std::vector<std::vector<TileRecord> > perThread;    // merged into tiles by end()
+};
+
+// Adds n to counter of the calling thread's StatCounters
+#ifdef RAYTRACER_STATS
+#define RT_COUNT(counter, n) (RenderStats::local().counter += uint64_t(n))
+#else
+#define RT_COUNT(counter, n) ((void)0)
+#endif
+
+// Times the stages of a function: RT_STAGES declares the timer, and each
+// RT_STAGE(counter) ends the stage before (if any) and starts timing one
+// into counter.  The last stage ends with the enclosing block.
+#ifdef RAYTRACER_STATS
+class StatStages {
+public:
+	~StatStages() { next(nullptr); }
+	void next(uint64_t *total) {
+		int64_t now = RenderStats::nowNs();
+		if (current) *current += uint64_t(now - start);
+		current = total;
+		start = now;
+	}
+	
+private:
+	uint64_t *current = nullptr;
+	int64_t start = 0;
+};
+#define RT_STAGES StatStages statStages
+#define RT_STAGE(counter) statStages.next(&RenderStats::local().counter)
+#else
+#define RT_STAGES ((void)0)
+#define RT_STAGE(counter) ((void)0)
+#endif
@@ -0,0 +1,714 @@
+#include "Renderer.h"
+#include "ImageStream.h"
+#include "Shading.h"
+#include "Fingerprint.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+static const float kShadowBias = 1e-4f;    // shadow ray offset, relative to the size of the coordinates
+
+//--------------------------------------------------------------
+void Renderer::prepare() {
+	renderScene.build(scene);
+	cameraRays.setup(renderCam);
+}
+
+//--------------------------------------------------------------
+ThreadPool &Renderer::threadPool() {
+	int threads = numThreads > 0 ? numThreads : ThreadPool::hardwareThreads();
+	if (!pool || pool->size() != threads) pool.reset(new ThreadPool(threads));
+	return *pool;
+}
+
+//--------------------------------------------------------------
+void Renderer::render(Image &image) {
+	FrameBuffer frame;
+	render(frame);
+	toneMap.apply(frame, image);
+}
+
+//--------------------------------------------------------------
+void Renderer::render(FrameBuffer &frame) {
+	prepare();
+	renderPrepared(frame);
+}
+
+//--------------------------------------------------------------
+void Renderer::renderPrepared(FrameBuffer &frame) {
+	frame.allocate(imageWidth, imageHeight);
+	
+#ifdef RAYTRACER_STATS
+	stats.begin(imageWidth, imageHeight, threadPool().size());
+#endif
+	Tile whole = { 0, 0, imageWidth, imageHeight };
+	long long total = renderRegion(frame, whole);
+#ifdef RAYTRACER_STATS
+	stats.end();
+#endif
+	samplesPerPixel = float(double(total) / (double(imageWidth) * imageHeight));
+}
+
+// The region is split into tiles, which are traced in parallel.  frame holds
+// the region alone, so tiles are written offset by its top-left corner.
+//
+//--------------------------------------------------------------
+long long Renderer::renderRegion(FrameBuffer &frame, const Tile &region) {
+	ThreadPool &threads = threadPool();
+	std::vector<Tile> tiles = makeTiles(region.width(), region.height(), tileSize);
+	for (size_t t = 0; t < tiles.size(); t++) {
+		tiles[t].x0 += region.x0;
+		tiles[t].x1 += region.x0;
+		tiles[t].y0 += region.y0;
+		tiles[t].y1 += region.y0;
+	}
+	int top = imageHeight - region.y1;
+	std::vector<long long> traced(threads.size(), 0);
+	threads.parallelFor(tiles.size(), [&](int t, int thread) {
+		traced[thread] += renderTileStats(frame, tiles[t], top, region.x0, thread);
+	});
+	
+	long long total = 0;
+	for (size_t i = 0; i < traced.size(); i++) total += traced[i];
+	return total;
+}
+
+static bool fail(std::string *error, const std::string &message) {
+	if (error) *error = message;
+	return false;
+}
+
+// Runs renderTile(), and with stats built in, records what the tile cost
+//
+//--------------------------------------------------------------
+int Renderer::renderTileStats(FrameBuffer &frame, const Tile &tile, int top, int left, int thread) {
+#ifdef RAYTRACER_STATS
+	RenderStats::TileRecord record;
+	record.tile = tile;
+	record.thread = thread;
+	StatCounters before = RenderStats::local();
+	record.startNs = RenderStats::nowNs() - stats.startNs;
+	int traced = renderTile(frame, tile, top, left);
+	record.endNs = RenderStats::nowNs() - stats.startNs;
+	record.counters = RenderStats::local() - before;
+	stats.addTile(thread, record);
+	return traced;
+#else
+	(void)thread;
+	return renderTile(frame, tile, top, left);
+#endif
+}
+
+// Rows finished by an earlier run, if its progress file matches
+//
+static int readProgress(const std::string &path, uint64_t fingerprint) {
+	FILE *f = fopen(path.c_str(), "r");
+	if (!f) return 0;
+	unsigned long long found = 0;
+	int rows = 0;
+	bool ok = fscanf(f, "rtprogress 1 fingerprint %llx rows %d", &found, &rows) == 2 && found == fingerprint;
+	fclose(f);
+	return ok ? rows : 0;
+}
+
+// Written beside the real file and renamed over it, so a crash leaves either
+// the old count or the new one
+//
+static bool writeProgress(const std::string &path, uint64_t fingerprint, int rows) {
+	std::string temp = path + ".tmp";
+	FILE *f = fopen(temp.c_str(), "w");
+	if (!f) return false;
+	fprintf(f, "rtprogress 1 fingerprint %016llx rows %d\n", (unsigned long long)fingerprint, rows);
+	if (fclose(f) != 0) return false;
+	return rename(temp.c_str(), path.c_str()) == 0;
+}
+
+// Rows are traced in bands tall enough to give every thread a few tiles, and
+// each band is written out before the next is started.
+//
+//--------------------------------------------------------------
+bool Renderer::renderToFile(const std::string &path, bool resume, std::string *error) {
+	prepare();
+	ThreadPool &threads = threadPool();
+	
+	uint64_t print = fingerprint();
+	std::string progressPath = path + ".progress";
+	int done = resume ? std::min(readProgress(progressPath, print), imageHeight) : 0;
+	
+	ImageStream out;
+	if (done > 0) {
+		if (!out.reopen(path, imageWidth, imageHeight, error)) return false;
+	}
+	else if (!out.create(path, imageWidth, imageHeight, error)) return false;
+	
+	int tilesAcross = (imageWidth + tileSize - 1) / tileSize;
+	int bandHeight = tileSize * std::max(1, (4 * threads.size() + tilesAcross - 1) / tilesAcross);
+	FrameBuffer band;
+	long long total = 0;
+#ifdef RAYTRACER_STATS
+	stats.begin(imageWidth, imageHeight, threads.size());
+#endif
+	for (int top = done; top < imageHeight; top += bandHeight) {
+		int bottom = std::min(top + bandHeight, imageHeight);
+		band.allocate(imageWidth, bottom - top);
+		
+		// tiles count rows from the bottom of the image
+		Tile region = { 0, imageHeight - bottom, imageWidth, imageHeight - top };
+		total += renderRegion(band, region);
+		
+		if (!out.writeRows(top, band, toneMap) || !out.flush() || !writeProgress(progressPath, print, bottom)) {
+			return fail(error, "could not write " + path);
+		}
+	}
+	if (!out.close()) return fail(error, "could not write " + path);
+	remove(progressPath.c_str());
+#ifdef RAYTRACER_STATS
+	stats.end();
+#endif
+	
+	int rows = imageHeight - done;
+	samplesPerPixel = rows > 0 ? float(double(total) / (double(imageWidth) * rows)) : 0;
+	return true;
+}
+
+// Where an object the snapshot refers to is, and what shape it is: for a
+// mesh, its triangles
+//
+static void addShape(Fingerprint &f, SceneObject *obj) {
+	AABB box;
+	f.add(obj->position);
+	if (obj->getBounds(box)) { f.add(box.min); f.add(box.max); }
+	if (const Mesh *mesh = dynamic_cast<const Mesh *>(obj)) f.add(mesh->contentHash());
+}
+
+// Hashes everything that decides what the pixels come out as: the settings,
+// the camera and the scene snapshot, down to texels and triangles
+//
+//--------------------------------------------------------------
+uint64_t Renderer::fingerprint() {
+	Fingerprint f;
+	f.add(imageWidth); f.add(imageHeight);
+	f.add(power); f.add(antialias); f.add(aaThreshold); f.add(sampler.seed); f.add(shadows); f.add(lightCutoff);
+	f.add(int(toneMap.curve)); f.add(toneMap.exposure); f.add(toneMap.white);
+	f.add(renderCam.position); f.add(renderCam.aim);
+	f.add(renderCam.view.min.x); f.add(renderCam.view.min.y);
+	f.add(renderCam.view.max.x); f.add(renderCam.view.max.y);
+	f.add(renderCam.view.position);
+	f.add(renderCam.up); f.add(renderCam.aperture); f.add(renderCam.focusDistance);
+	
+	const RenderScene &rs = renderScene;
+	size_t n = size_t(rs.sphereCount);
+	f.add(n);
+	f.addArray(rs.sphereX, n); f.addArray(rs.sphereY, n); f.addArray(rs.sphereZ, n);
+	f.addArray(rs.sphereRadius, n); f.addArray(rs.sphereMaterial, n);
+	for (size_t i = 0; i < rs.planes.size(); i++) {
+		const RenderScene::PlaneData &p = rs.planes[i];
+		f.add(p.point); f.add(p.normal); f.add(p.halfWidth); f.add(p.halfHeight); f.add(p.material);
+	}
+	for (size_t i = 0; i < rs.others.size(); i++) {
+		addShape(f, rs.others[i]);
+		f.add(rs.otherMaterial[i]);
+	}
+	f.addArray(rs.instances, rs.instances.size());
+	for (size_t i = 0; i < rs.prototypes.size(); i++) addShape(f, rs.prototypes[i]);
+	for (size_t i = 0; i < rs.materials.size(); i++) {
+		const Material &m = rs.materials[i];
+		// a texture by its texels, not its place in the store: saved scenes
+		// number textures by first use (see saveScene())
+		bool textured = rs.textures && rs.textures->contains(m.texture);
+		f.add(m.diffuse); f.add(m.specular); f.add(textured);
+		if (textured) f.add(rs.textures->get(m.texture).contentHash());
+	}
+	f.addArray(rs.lightPosition, rs.lightPosition.size());
+	f.addArray(rs.lightIntensity, rs.lightIntensity.size());
+	f.addArray(rs.lightRange, rs.lightRange.size());
+	if (lightSamples > 0) {
+		f.add(lightSamples);
+		f.addArray(rs.lightRadius, rs.lightRadius.size());
+	}
+	return f.hash;
+}
+
+// Running totals for the samples of one pixel.  The spread between samples
+// is measured on colors clipped to full scale, so that differences no one
+// will see in the final image don't cost more rays.
+//
+struct PixelSamples {
+	glm::vec3 sum = glm::vec3(0);
+	glm::vec3 lo = glm::vec3(1);
+	glm::vec3 hi = glm::vec3(0);
+	int count = 0;
+	
+	void add(const glm::vec3 &c) {
+		glm::vec3 v = glm::min(c, glm::vec3(1));
+		sum += c;
+		lo = glm::min(lo, v);
+		hi = glm::max(hi, v);
+		count++;
+	}
+	// largest difference between samples in any channel, 0 - 1
+	float contrast() const {
+		glm::vec3 d = hi - lo;
+		return std::max(d.x, std::max(d.y, d.z));
+	}
+	glm::vec3 average() const { return sum / float(count); }
+};
+
+// Tiles never overlap, so threads write disjoint pixels of the image.  The
+// image may hold just part of the whole image, whose top-left pixel is
+// column left of row top.  Rays are gathered into batches (the whole tile,
+// or a whole pass of antialiasing) so that traceSamples() can fill whole
+// packets.
+//
+//--------------------------------------------------------------
+int Renderer::renderTile(FrameBuffer &frame, const Tile &tile, int top, int left) {
+	int width = tile.x1 - tile.x0;
+	int traced = 0;
+	std::vector<glm::vec2> uv;
+	std::vector<glm::vec3> colors;
+	
+	if (antialias <= 1) {
+		for (int j = tile.y0; j < tile.y1; j++) {
+			for (int i = tile.x0; i < tile.x1; i++) {
+				uv.push_back(glm::vec2((float(i) + 0.5) / float(imageWidth), (float(j) + 0.5) / float(imageHeight)));
+			}
+		}
+		traceSamples(uv, 1, colors);
+		traced += int(uv.size());
+		for (int j = tile.y0; j < tile.y1; j++) {
+			for (int i = 0; i < width; i++) {
+				// "Unflip" image by adjust in the "j" direction.
+				frame.setColor(tile.x0 + i - left, imageHeight - j - 1 - top, colors[(j - tile.y0) * width + i]);
+			}
+		}
+		return traced;
+	}
+	
+	// The first pass also covers a one pixel border around the tile, so that
+	// every pixel can be compared with its neighbours.  Samples depend only on
+	// the pixel, so the border pixels get the same values here as in their own
+	// tiles.
+	bool adaptive = aaThreshold > 0 && antialias > 2;
+	int border = adaptive ? 1 : 0;
+	int rx0 = std::max(0, tile.x0 - border), rx1 = std::min(imageWidth, tile.x1 + border);
+	int ry0 = std::max(0, tile.y0 - border), ry1 = std::min(imageHeight, tile.y1 + border);
+	int rw = rx1 - rx0;
+	std::vector<PixelSamples> pixels(size_t(rw) * (ry1 - ry0));
+	std::vector<int> refine;
+	for (int j = ry0; j < ry1; j++) {
+		for (int i = rx0; i < rx1; i++) refine.push_back((j - ry0) * rw + (i - rx0));
+	}
+	
+	int n = adaptive ? 2 : antialias;
+	int have = 0;    // samples so far in each pixel still being refined
+	for (;;) {
+		// top those pixels up to n x n samples
+		int adding = n * n - have;
+		uv.clear();
+		for (size_t r = 0; r < refine.size(); r++) {
+			int i = rx0 + refine[r] % rw;
+			int j = ry0 + refine[r] / rw;
+			uint32_t pixel = uint32_t(j) * uint32_t(imageWidth) + uint32_t(i);
+			for (int k = have; k < n * n; k++) {
+				glm::vec2 s = sampler.get2D(pixel, uint32_t(k), kPixelSamples);
+				uv.push_back(glm::vec2((float(i) + s.x) / float(imageWidth), (float(j) + s.y) / float(imageHeight)));
+			}
+		}
+		traceSamples(uv, 1.0f / n, colors);
+		traced += int(uv.size());
+		for (size_t r = 0; r < refine.size(); r++) {
+			for (int k = 0; k < adding; k++) pixels[refine[r]].add(colors[r * adding + k]);
+		}
+		have = n * n;
+		if (n >= antialias) break;
+		
+		// Keep the tile's pixels whose samples still disagree.  After the first
+		// pass, also take pixels that differ from a neighbour: an edge can cross
+		// a pixel between its first few samples.
+		size_t kept = 0;
+		for (size_t r = 0; r < refine.size(); r++) {
+			int i = rx0 + refine[r] % rw;
+			int j = ry0 + refine[r] / rw;
+			if (i < tile.x0 || i >= tile.x1 || j < tile.y0 || j >= tile.y1) continue;
+			const PixelSamples &px = pixels[refine[r]];
+			bool edge = px.contrast() > aaThreshold;
+			if (!edge && n == 2) {
+				glm::vec3 mean = glm::min(px.average(), glm::vec3(1));
+				const int neighbours[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+				for (int k = 0; k < 4 && !edge; k++) {
+					int ni = i + neighbours[k][0], nj = j + neighbours[k][1];
+					if (ni < rx0 || ni >= rx1 || nj < ry0 || nj >= ry1) continue;
+					const PixelSamples &other = pixels[(nj - ry0) * rw + (ni - rx0)];
+					glm::vec3 d = glm::abs(glm::min(other.average(), glm::vec3(1)) - mean);
+					edge = std::max(d.x, std::max(d.y, d.z)) > aaThreshold;
+				}
+			}
+			if (edge) refine[kept++] = refine[r];
+		}
+		refine.resize(kept);
+		if (refine.empty()) break;
+		n = std::min(2 * n, antialias);
+	}
+	
+	for (int j = tile.y0; j < tile.y1; j++) {
+		for (int i = tile.x0; i < tile.x1; i++) {
+			frame.setColor(i - left, imageHeight - j - 1 - top, pixels[(j - ry0) * rw + (i - rx0)].average());
+		}
+	}
+	return traced;
+}
+
+// Traces a ray through each image position in uv and shades what it hits.
+// footprint is the width of the area each sample stands for, in pixels.  If
+// depth is given it gets the distance to each hit, or FLT_MAX for a miss.
+//
+//--------------------------------------------------------------
+void Renderer::traceSamples(const std::vector<glm::vec2> &uv, float footprint, std::vector<glm::vec3> &colors, std::vector<float> *depth) {
+	if (wavefront) {
+		traceWavefront(uv, footprint, colors, depth);
+		return;
+	}
+	colors.resize(uv.size());
+	if (depth) depth->assign(uv.size(), FLT_MAX);
+	RT_COUNT(primaryRays, uv.size());
+	
+	// rays are made kSimdWidth at a time even when traced one by one
+	std::vector<Ray> rays(kSimdWidth, Ray(glm::vec3(0), glm::vec3(0)));
+	Hit hits[kSimdWidth];
+	for (size_t base = 0; base < uv.size(); base += kSimdWidth) {
+		int n = int(std::min(uv.size() - base, size_t(kSimdWidth)));
+		cameraRays.generate(sampler, &uv[base], n, rays.data());
+		int mask = usePackets ? renderScene.intersect(rays.data(), n, hits) : 0;
+		for (int k = 0; k < n; k++) {
+			if (!usePackets && renderScene.intersect(rays[k], hits[k])) mask |= 1 << k;
+		}
+		for (int k = 0; k < n; k++) {
+			const glm::vec2 &p = uv[base + k];
+			colors[base + k] = (mask & (1 << k)) ? shade(hits[k], p.x, p.y, footprint) : glm::vec3(0);
+			if (depth && (mask & (1 << k))) (*depth)[base + k] = hits[k].t;
+		}
+	}
+}
+
+static inline bool belowCutoff(const glm::vec3 &c, float cutoff) {
+	return std::max(c.x, std::max(c.y, c.z)) < cutoff;
+}
+
+// The shadow ray starts just off the surface, on the side facing the light,
+// so that it doesn't hit the surface it starts from.  Returns the distance
+// to the light along it.
+//
+static inline float shadowRay(const glm::vec3 &p, const glm::vec3 &norm, const glm::vec3 &lightPos, Ray &ray) {
+	glm::vec3 toLight = lightPos - p;
+	float dist = glm::length(toLight);
+	glm::vec3 dir = toLight / dist;
+	glm::vec3 side = glm::dot(norm, dir) >= 0 ? norm : -norm;
+	glm::vec3 a = glm::abs(p);
+	float bias = kShadowBias * std::max(1.0f, std::max(a.x, std::max(a.y, a.z)));
+	ray = Ray(p + side * bias, dir);
+	return dist - bias;
+}
+
+// A point on the disk of the given radius around center that faces p, from
+// s uniform in the unit square; uniform over the disk's area
+//
+static inline glm::vec3 pointOnLight(const glm::vec3 &center, float radius, const glm::vec3 &p, const glm::vec2 &s) {
+	glm::vec3 w = center - p;
+	float dist = glm::length(w);
+	if (radius <= 0 || dist <= radius) return center;
+	w /= dist;
+	glm::vec3 a = std::abs(w.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+	glm::vec3 t = glm::normalize(glm::cross(a, w));
+	glm::vec3 b = glm::cross(w, t);
+	float r = radius * std::sqrt(s.x);
+	float phi = 6.28318531f * s.y;
+	return center + r * (std::cos(phi) * t + std::sin(phi) * b);
+}
+
+// Calls visit(light, lightPos, weight) for the lights that shade point p
+// (with unit normal n): every light that reaches it, at its center and with
+// weight 1, or with kSampled, lightSamples of them picked from lightTree, at
+// points on them and weighted so the sum is right on average.  sample keys
+// the random numbers.
+//
+//--------------------------------------------------------------
+template<bool kSampled, class Visit>
+void Renderer::forEachLightSample(const glm::vec3 &p, const glm::vec3 &n, uint32_t sample, Visit visit) {
+	const RenderScene &rs = renderScene;
+	if (!kSampled) {
+		rs.forEachLight(p, [&](int i) { visit(i, rs.lightPosition[i], 1.0f); });
+		return;
+	}
+	for (int j = 0; j < lightSamples; j++) {
+		float pdf;
+		int i = rs.lightTree.sample(p, n, sampler.random(sample, uint32_t(j), kLightSamples), pdf);
+		if (i < 0) return;    // nothing reaches p
+		
+		// the tree only bounds ranges by boxes
+		glm::vec3 d = p - rs.lightPosition[i];
+		if (rs.lightRange[i] > 0 && glm::dot(d, d) > rs.lightRange[i] * rs.lightRange[i]) continue;
+		glm::vec3 lightPos = pointOnLight(rs.lightPosition[i], rs.lightRadius[i], p, sampler.get2D(sample, uint32_t(j), kLightSamples));
+		visit(i, lightPos, 1.0f / (float(lightSamples) * pdf));
+	}
+}
+
+// Calls emit(light, lightPos, contribution) for each light sample that adds
+// at least lightCutoff to point p, before shadowing.  lightCutoff is in 8-bit
+// steps, so it is scaled down to the float range.  It is held against what
+// the light itself adds, before a sample's weight: a weighted term is small
+// when the light was likely to be picked, not when it adds little, so
+// culling that would drop the samples the estimate leans on.
+//
+//--------------------------------------------------------------
+template<class Model, bool kSampled, class Emit>
+void Renderer::forEachLightTerm(const glm::vec3 &p, const glm::vec3 &n, const glm::vec3 &diffuse, const glm::vec3 &specular,
+	float power, uint32_t sample, Emit emit) {
+	float cutoff = lightCutoff * (1.0f / 255);
+	glm::vec3 v = glm::normalize(cameraRays.position - p);
+	forEachLightSample<kSampled>(p, n, sample, [&](int i, const glm::vec3 &lightPos, float weight) {
+		glm::vec3 contribution = Model::light(lightPos, renderScene.lightIntensity[i], p, n, v, diffuse, specular, power);
+		if (belowCutoff(contribution, cutoff)) return;
+		emit(i, lightPos, weight * contribution);
+	});
+}
+
+// The light reaching p, with a shadow ray cast for each light as it comes
+//
+//--------------------------------------------------------------
+template<class Model, bool kSampled>
+glm::vec3 Renderer::directLight(const glm::vec3 &p, const glm::vec3 &n, const glm::vec3 &diffuse, const glm::vec3 &specular, float power, uint32_t sample) {
+	glm::vec3 shadedColor = glm::vec3(0);
+	forEachLightTerm<Model, kSampled>(p, n, diffuse, specular, power, sample, [&](int i, const glm::vec3 &lightPos, const glm::vec3 &contribution) {
+		if (shadows && !visible(p, n, lightPos)) return;
+		shadedColor += contribution;
+	});
+	return shadedColor;
+}
+
+//--------------------------------------------------------------
+template<class Model, bool kTextured, bool kSampled>
+glm::vec3 Renderer::shadeHit(const Material &m, const Hit &hit, float u, float v, float footprint) {
+	glm::vec3 diffuse = kTextured ? textureLookup(renderScene.textures->get(m.texture), u, v, footprint) : m.diffuse;
+	return directLight<Model, kSampled>(hit.point, glm::normalize(hit.normal), diffuse, m.specular, power, Sampler::key(u, v));
+}
+
+// The shadow rays wavefront shading leaves to trace, with what each light
+// adds if its ray gets through
+//
+struct Renderer::ShadowQueue {
+	std::vector<int> sample, light;
+	std::vector<glm::vec3> color, normal, target;
+};
+
+// Shades the hits listed in run, which all have material m.  Contributions
+// go straight into colors without shadows, or onto queue with them.
+//
+//--------------------------------------------------------------
+template<class Model, bool kTextured, bool kSampled>
+void Renderer::shadeRun(const Material &m, const int *run, int count, const std::vector<Hit> &hits, const std::vector<glm::vec2> &uv,
+	float footprint, std::vector<glm::vec3> &colors, ShadowQueue &queue) {
+	for (int k = 0; k < count; k++) {
+		int s = run[k];
+		const Hit &hit = hits[s];
+		glm::vec3 diffuse = kTextured ? textureLookup(renderScene.textures->get(m.texture), uv[s].x, uv[s].y, footprint) : m.diffuse;
+		glm::vec3 n = glm::normalize(hit.normal);
+		forEachLightTerm<Model, kSampled>(hit.point, n, diffuse, m.specular, power, Sampler::key(uv[s].x, uv[s].y),
+			[&](int i, const glm::vec3 &lightPos, const glm::vec3 &contribution) {
+			if (!shadows) {
+				colors[s] += contribution;
+				return;
+			}
+			queue.sample.push_back(s);
+			queue.light.push_back(i);
+			queue.color.push_back(contribution);
+			queue.normal.push_back(n);
+			queue.target.push_back(lightPos);
+		});
+	}
+}
+
+//--------------------------------------------------------------
+template<class Model, bool kTextured, bool kSampled>
+Renderer::Kernels Renderer::kernelsFor() {
+	Kernels k;
+	k.hit = &Renderer::shadeHit<Model, kTextured, kSampled>;
+	k.run = &Renderer::shadeRun<Model, kTextured, kSampled>;
+	return k;
+}
+
+// The kernels for material m under the current settings.  Every choice that
+// would otherwise be made per hit or per light is made here, once for each
+// hit in depth-first tracing and once for each run of a material in
+// wavefront tracing.
+//
+//--------------------------------------------------------------
+Renderer::Kernels Renderer::kernels(const Material &m) const {
+	bool sampled = lightSamples > 0;
+	if (m.texture.valid()) return sampled ? kernelsFor<BlinnPhong, true, true>() : kernelsFor<BlinnPhong, true, false>();
+	return sampled ? kernelsFor<BlinnPhong, false, true>() : kernelsFor<BlinnPhong, false, false>();
+}
+
+// Replaces the index list with its entries in order of key (0 to keys - 1),
+// keeping the order within each key
+//
+static void sortByKey(std::vector<int> &items, const std::vector<int> &key, int keys, std::vector<int> &scratch) {
+	std::vector<int> start(keys + 1, 0);
+	for (size_t k = 0; k < items.size(); k++) start[key[items[k]] + 1]++;
+	for (int k = 0; k < keys; k++) start[k + 1] += start[k];
+	scratch.resize(items.size());
+	for (size_t k = 0; k < items.size(); k++) scratch[start[key[items[k]]]++] = items[k];
+	items.swap(scratch);
+}
+
+// The batch goes through in stages, each over every ray before the next
+// starts: primary rays are intersected (as packets), hits are sorted by
+// material and shaded a material at a time, each run of a material by the
+// kernel made for it, and the shadow rays that shading
+// queues are sorted by light and traced a light at a time.  Each stage keeps
+// one kind of work, and one part of the scene, hot in the cache.  Light
+// contributions are added up in the order phong() adds them, so the result
+// is the same to the bit.
+//
+//--------------------------------------------------------------
+void Renderer::traceWavefront(const std::vector<glm::vec2> &uv, float footprint, std::vector<glm::vec3> &colors, std::vector<float> *depth) {
+	size_t count = uv.size();
+	colors.assign(count, glm::vec3(0));
+	if (depth) depth->assign(count, FLT_MAX);
+	RT_COUNT(primaryRays, count);
+	RT_STAGES;
+	
+	// primary rays
+	RT_STAGE(intersectNs);
+	std::vector<Hit> hits(count);
+	std::vector<int> shadeList;
+	std::vector<Ray> rays(kSimdWidth, Ray(glm::vec3(0), glm::vec3(0)));
+	for (size_t base = 0; base < count; base += kSimdWidth) {
+		int n = int(std::min(count - base, size_t(kSimdWidth)));
+		cameraRays.generate(sampler, &uv[base], n, rays.data());
+		int mask = usePackets ? renderScene.intersect(rays.data(), n, &hits[base]) : 0;
+		for (int k = 0; k < n; k++) {
+			if (!usePackets && renderScene.intersect(rays[k], hits[base + k])) mask |= 1 << k;
+		}
+		for (int k = 0; k < n; k++) {
+			if (!(mask & (1 << k))) continue;
+			shadeList.push_back(int(base + k));
+			if (depth) (*depth)[base + k] = hits[base + k].t;
+		}
+	}
+	
+	// shading, a material at a time
+	RT_STAGE(shadeNs);
+	RT_COUNT(shadeCalls, shadeList.size());
+	std::vector<int> material(count, 0), scratch;
+	for (size_t k = 0; k < shadeList.size(); k++) material[shadeList[k]] = hits[shadeList[k]].material;
+	sortByKey(shadeList, material, int(renderScene.materials.size()), scratch);
+	
+	ShadowQueue queue;
+	for (size_t k = 0; k < shadeList.size();) {
+		int id = material[shadeList[k]];
+		size_t end = k + 1;
+		while (end < shadeList.size() && material[shadeList[end]] == id) end++;
+		const Material &m = renderScene.materials[id];
+		(this->*kernels(m).run)(m, &shadeList[k], int(end - k), hits, uv, footprint, colors, queue);
+		k = end;
+	}
+	if (queue.sample.empty()) return;
+	
+	// shadow rays, a light at a time: rays to one light converge on it, so
+	// they make coherent packets (on area lights, nearly)
+	RT_STAGE(shadowNs);
+	RT_COUNT(shadowRays, queue.sample.size());
+	std::vector<int> order(queue.sample.size());
+	for (size_t q = 0; q < order.size(); q++) order[q] = int(q);
+	sortByKey(order, queue.light, int(renderScene.lightPosition.size()), scratch);
+	std::vector<char> lit(queue.sample.size());
+	float maxDist[kSimdWidth];
+	for (size_t k = 0; k < order.size();) {
+		int light = queue.light[order[k]];
+		int n = 0;
+		if (usePackets) {
+			while (k + n < order.size() && n < kSimdWidth && queue.light[order[k + n]] == light) n++;
+		}
+		else n = 1;
+		for (int r = 0; r < n; r++) {
+			int q = order[k + r];
+			maxDist[r] = shadowRay(hits[queue.sample[q]].point, queue.normal[q], queue.target[q], rays[r]);
+		}
+		int blocked = usePackets ? renderScene.occluded(rays.data(), maxDist, n) : int(renderScene.occluded(rays[0], maxDist[0]));
+		for (int r = 0; r < n; r++) lit[order[k + r]] = !(blocked & (1 << r));
+		k += n;
+	}
+	
+	// added up in the order they were queued, which is directLight()'s order
+	for (size_t q = 0; q < queue.sample.size(); q++) {
+		if (lit[q]) colors[queue.sample[q]] += queue.color[q];
+	}
+}
+
+//--------------------------------------------------------------
+glm::vec3 Renderer::tracePixel(int i, int j) {
+	float u = (float(i) + 0.5) / float(imageWidth);
+	float v = (float(j) + 0.5) / float(imageHeight);
+	
+	glm::vec2 uv(u, v);
+	Ray ray(glm::vec3(0), glm::vec3(0));
+	cameraRays.generate(sampler, &uv, 1, &ray);
+	
+	// Set the color of the pixel to the nearest object's pixel
+	// if we didn't hit anything, set it the bg color.
+	Hit hit;
+	if (!renderScene.intersect(ray, hit)) {
+		return glm::vec3(0);
+	}
+	return shade(hit, u, v);
+}
+
+//--------------------------------------------------------------
+glm::vec3 Renderer::shade(const Hit &hit, float u, float v, float footprint) {
+	RT_COUNT(shadeCalls, 1);
+	const Material &m = renderScene.material(hit);
+	return (this->*kernels(m).hit)(m, hit, u, v, footprint);
+}
+
+//--------------------------------------------------------------
+glm::vec3 Renderer::lambert(const glm::vec3 &lightPos, float lightIntensity, const glm::vec3 &p, const glm::vec3 &norm, const glm::vec3 &diffuse) {
+	glm::vec3 l, n;
+	n = glm::normalize(norm);
+	float dot;
+	l = glm::normalize(lightPos - p);
+	dot = glm::dot(n, l);
+	return diffuse * lightIntensity * glm::max(0.0f, dot);
+}
+
+// Each light's contribution is worked out before its shadow ray, which is
+// only cast if the light would make a difference.  sample keys the choice of
+// lights when lightSamples is set.
+//
+//--------------------------------------------------------------
+glm::vec3 Renderer::phong(const glm::vec3 &p, const glm::vec3 &norm, const glm::vec3 &diffuse, const glm::vec3 &specular, float power, uint32_t sample) {
+	glm::vec3 n = glm::normalize(norm);
+	if (lightSamples > 0) return directLight<BlinnPhong, true>(p, n, diffuse, specular, power, sample);
+	return directLight<BlinnPhong, false>(p, n, diffuse, specular, power, sample);
+}
+
+// True if nothing lies between p and the light
+//
+//--------------------------------------------------------------
+bool Renderer::visible(const glm::vec3 &p, const glm::vec3 &norm, const glm::vec3 &lightPos) {
+	Ray ray(glm::vec3(0), glm::vec3(0));
+	float maxDist = shadowRay(p, norm, lightPos, ray);
+	RT_COUNT(shadowRays, 1);
+	return !renderScene.occluded(ray, maxDist);
+}
+
+// Texture color at image coordinates (u, v).  Textures are laid over the
+// whole image, so the area to filter is footprint pixels across.
+//
+//--------------------------------------------------------------
+glm::vec3 Renderer::textureLookup(const Texture &texture, float u, float v, float footprint) {
+	return texture.sample(u, v, footprint / imageWidth, footprint / imageHeight);
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "Scene.h"
+#include "RenderScene.h"
+#include "CameraRays.h"
+#include "Image.h"
+#include "FrameBuffer.h"
+#include "Tile.h"
+#include "ThreadPool.h"
+#include "Sampler.h"
+#include "RenderStats.h"
+
+//  Ray traces a Scene through a RenderCam into an Image.
+//
+//  Shading and antialiasing work in float color (see FrameBuffer), with no
+//  clamping along the way; render(Image &) tone maps the result to 8 bits at
+//  the end, and render(FrameBuffer &) keeps the floats.
+//
+//  This is the rendering half of what used to live in ofApp; it has no window or
+//  GL dependency, so it is shared by the app ('r' key) and the headless renderer.
+//
+//  render() first takes a flat snapshot of the scene (see RenderScene) and of
+//  the camera's ray generation (see CameraRays), and traces against those;
+//  prepare() does only that step, for callers that want to trace individual
+//  pixels or regions (renderRegion(), which is how the workers of a
+//  distributed render trace their jobs), and renderPrepared() only the rest,
+//  for callers that keep the snapshot up to date themselves (see
+//  SequenceRenderer).
+//
+//  The image is split into tiles which are traced in parallel on a thread pool.
+//  Every pixel is computed independently, so the result is the same for any
+//  thread count or tile size.  Within a tile, runs of kSimdWidth pixels along
+//  a row are traced as one ray packet.  In wavefront mode (the default) a
+//  tile's rays are traced in stages rather than one after another; see
+//  traceWavefront().
+//
+//  With antialias above 1 the sampling is adaptive: every pixel first gets 4
+//  samples, and pixels whose samples differ by more than aaThreshold, or
+//  whose average differs that much from a neighbour's, are topped up to 16,
+//  64, ... samples, up to antialias x antialias.  Flat areas cost 4 rays a
+//  pixel and only edges, highlights and textures pay for more.  An
+//  aaThreshold of 0 takes every pixel to the full count straight away.
+//  Sample positions come from sampler (see Sampler.h), whose first 4, 16,
+//  64, ... samples are each stratified over the pixel, so a pixel being
+//  refined keeps the samples it has.
+//
+//  renderToFile() streams the image to a .ppm or .pfm file instead (see
+//  ImageStream), a band of rows at a time, so memory use doesn't grow with
+//  the image.  After each band it records how many rows are done in
+//  path + ".progress", with a fingerprint of the scene, camera and settings;
+//  with resume set, an interrupted render of the same thing carries on from
+//  there.
+//
+//  Shading casts a shadow ray to each light that reaches the point.  Lights
+//  whose contribution there would be under lightCutoff are dropped before
+//  the ray is cast, and shadow rays stop at the first blocker they find.
+//  The shading code is a set of kernels, compiled for each material model,
+//  with and without a texture and for either kind of lights below; the one
+//  for a material is picked before its hits are shaded (see Shading.h).
+//
+//  With lightSamples set, shading instead picks that many lights at random
+//  from RenderScene::lightTree, favouring the ones that can add the most, and
+//  weights each by one over its chance of being picked; the average over
+//  samples is the same as shading with every light, but the cost no longer
+//  grows with the number of lights.  Each light is then a disk of its radius
+//  facing the point, and the shadow ray goes to a random point on it, so
+//  shadows get soft edges.  Antialiasing samples average out the noise.
+//
+class Renderer {
+public:
+	Renderer(Scene &scene, RenderCam &cam) : scene(scene), renderCam(cam) {}
+	
+	void prepare();
+	void render(Image &image);
+	void render(FrameBuffer &frame);
+	void renderPrepared(FrameBuffer &frame);    // render() with the snapshot as it is
+	bool renderToFile(const std::string &path, bool resume, std::string *error = nullptr);
+	long long renderRegion(FrameBuffer &frame, const Tile &region);    // frame holds just region; returns the number of samples traced
+	int renderTile(FrameBuffer &frame, const Tile &tile, int top = 0, int left = 0);    // returns the number of samples traced
+	glm::vec3 tracePixel(int i, int j);
+	void traceSamples(const std::vector<glm::vec2> &uv, float footprint, std::vector<glm::vec3> &colors, std::vector<float> *depth = nullptr);
+	void traceWavefront(const std::vector<glm::vec2> &uv, float footprint, std::vector<glm::vec3> &colors, std::vector<float> *depth = nullptr);
+	glm::vec3 shade(const Hit &hit, float u, float v, float footprint = 1);
+	
+	glm::vec3 lambert(const glm::vec3 &lightPos, float lightIntensity, const glm::vec3 &p, const glm::vec3 &norm, const glm::vec3 &diffuse);
+	glm::vec3 phong(const glm::vec3 &p, const glm::vec3 &norm, const glm::vec3 &diffuse, const glm::vec3 &specular, float power, uint32_t sample = 0);
+	bool visible(const glm::vec3 &p, const glm::vec3 &norm, const glm::vec3 &lightPos);
+	glm::vec3 textureLookup(const Texture &texture, float u, float v, float footprint = 1);
+	
+	uint64_t fingerprint();    // of the settings, camera and prepared scene: equal fingerprints render equal pixels
+	
+	int imageWidth = 6;
+	int imageHeight = 4;
+	float power = 30;    // Blinn-Phong exponent
+	int numThreads = 0;  // 0 = one per hardware thread
+	int tileSize = 32;
+	bool usePackets = true;    // trace kSimdWidth neighbouring pixels at a time
+	bool wavefront = true;     // trace each batch in stages rather than a ray at a time; see traceWavefront()
+	int antialias = 1;         // most samples per pixel along each axis; 1 = one ray through the pixel center
+	float aaThreshold = 0.04f; // sample again where a pixel's samples differ by more than this (0 - 1); lower is smoother and slower
+	Sampler sampler;
+	
+	bool shadows = true;
+	float lightCutoff = 1;     // skip lights adding less than this to every channel (0 - 255); 1 only skips lights below one 8-bit step
+	int lightSamples = 0;      // lights picked per shaded point, as area lights; 0 = every light, as a point
+	
+	ToneMap toneMap;    // how render(Image &) and 8-bit files turn float color into bytes
+	
+	float samplesPerPixel = 0;    // average over the last render
+	RenderStats stats;            // tiles of the last render, when built with RAYTRACER_STATS
+	
+	Scene &scene;
+	RenderCam &renderCam;
+	RenderScene renderScene;
+	CameraRays cameraRays;    // renderCam's, as of prepare()
+	
+private:
+	ThreadPool &threadPool();
+	int renderTileStats(FrameBuffer &frame, const Tile &tile, int top, int left, int thread);
+	
+	// Shading kernels, one for each material model (see Shading.h), textured
+	// or not, and point or sampled lights; see kernels()
+	struct ShadowQueue;
+	typedef glm::vec3 (Renderer::*HitKernel)(const Material &m, const Hit &hit, float u, float v, float footprint);
+	typedef void (Renderer::*RunKernel)(const Material &m, const int *run, int count, const std::vector<Hit> &hits, const std::vector<glm::vec2> &uv,
+		float footprint, std::vector<glm::vec3> &colors, ShadowQueue &queue);
+	struct Kernels {
+		HitKernel hit;    // shades one hit, casting its shadow rays
+		RunKernel run;    // shades a run of wavefront hits, queueing their shadow rays
+	};
+	Kernels kernels(const Material &m) const;
+	template<class Model, bool kTextured, bool kSampled> static Kernels kernelsFor();
+	template<class Model, bool kTextured, bool kSampled> glm::vec3 shadeHit(const Material &m, const Hit &hit, float u, float v, float footprint);
+	template<class Model, bool kTextured, bool kSampled> void shadeRun(const Material &m, const int *run, int count, const std::vector<Hit> &hits,
+		const std::vector<glm::vec2> &uv, float footprint, std::vector<glm::vec3> &colors, ShadowQueue &queue);
+	template<class Model, bool kSampled> glm::vec3 directLight(const glm::vec3 &p, const glm::vec3 &n, const glm::vec3 &diffuse, const glm::vec3 &specular,
+		float power, uint32_t sample);
+	template<class Model, bool kSampled, class Emit> void forEachLightTerm(const glm::vec3 &p, const glm::vec3 &n, const glm::vec3 &diffuse,
+		const glm::vec3 &specular, float power, uint32_t sample, Emit emit);
+	template<bool kSampled, class Visit> void forEachLightSample(const glm::vec3 &p, const glm::vec3 &n, uint32_t sample, Visit visit);
+	
+	std::unique_ptr<ThreadPool> pool;    // created on first use, reused while numThreads is unchanged
+};
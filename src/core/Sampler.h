@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include "VecMath.h"
+
+//  What a sample is used for.  Each gets its own scrambling, so that the
+//  samples of one are not correlated with another's.
+//
+enum SampleDimension : uint32_t {
+	kPixelSamples = 0,    // position within the pixel
+	kLensSamples = 1,     // position on the lens aperture
+	kLightSamples = 2,    // choice of light, point on an area light
+};
+
+//  Sample positions for the renderer.
+//
+//  Samples are counter based: each is a pure function of the seed, the pixel,
+//  the dimension and the sample's index within the pixel, with no state
+//  carried from one to the next.  So any thread can make them without
+//  locking, and they don't depend on which thread traces a pixel or when:
+//  renders come out the same bit for bit for any thread count or tile size.
+//
+//  get2D() draws from the 2D Sobol sequence, Owen scrambled and shuffled per
+//  pixel and dimension with Burley's hash-based scheme ("Practical Hash-based
+//  Owen Scrambling", JCGT 2020).  The first 4 samples of a pixel are
+//  stratified 2x2, the first 16 4x4 and so on, and points fill the square
+//  more evenly than jittered grids at any count, so a pixel converges in
+//  fewer samples.  A pixel can also be refined later by carrying on from the
+//  index it stopped at.
+//
+//  random() is a plain hash to [0, 1), for anything that needs no
+//  stratification.
+//
+//  Samples drawn after a ray has been made, for its lens position or the
+//  lights at what it hits, use key() of the ray's image position in place of
+//  the pixel, so a sample is the same whichever thread, tile or worker
+//  traces it.
+//
+class Sampler {
+public:
+	explicit Sampler(uint32_t seed = 0) : seed(seed) {}
+	
+	glm::vec2 get2D(uint32_t pixel, uint32_t index, uint32_t dimension) const;
+	float random(uint32_t pixel, uint32_t index, uint32_t dimension) const;
+	
+	static uint32_t hash(uint32_t x);
+	static uint32_t key(float u, float v);
+	
+	uint32_t seed;    // a different seed gives a different, equally good set of samples
+	
+private:
+	uint32_t pixelSeed(uint32_t pixel, uint32_t dimension) const {
+		return hash(hash(hash(seed + 0x9e3779b9u) ^ pixel) + dimension);
+	}
+};
+
+// Integer hash with good avalanche (Wellons' lowbias32)
+//
+inline uint32_t Sampler::hash(uint32_t x) {
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+//--------------------------------------------------------------
+inline uint32_t Sampler::key(float u, float v) {
+	uint32_t a, b;
+	memcpy(&a, &u, sizeof(a));
+	memcpy(&b, &v, sizeof(b));
+	return hash(a ^ hash(b));
+}
+
+inline uint32_t reverseBits(uint32_t x) {
+	x = (x << 16) | (x >> 16);
+	x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+	x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+	x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+	x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+	return x;
+}
+
+// Random permutation of the bits of x in which each bit depends only on
+// itself and the bits above it: a nested uniform (Owen) scramble in base 2
+//
+inline uint32_t owenScramble(uint32_t x, uint32_t seed) {
+	x = reverseBits(x);
+	x ^= x * 0x3d20adeau;
+	x += seed;
+	x *= (seed >> 16) | 1;
+	x ^= x * 0x05526c56u;
+	x ^= x * 0x53a22864u;
+	return reverseBits(x);
+}
+
+//--------------------------------------------------------------
+inline glm::vec2 Sampler::get2D(uint32_t pixel, uint32_t index, uint32_t dimension) const {
+	uint32_t s = pixelSeed(pixel, dimension);
+	
+	// Scrambling the index shuffles the order of the points without breaking
+	// up the stratified blocks.  The two Sobol dimensions are then van der
+	// Corput and its companion.
+	uint32_t i = owenScramble(index, s);
+	uint32_t x = reverseBits(i), y = 0;
+	for (uint32_t v = 1u << 31; i; i >>= 1, v ^= v >> 1) {
+		if (i & 1) y ^= v;
+	}
+	x = owenScramble(x, hash(s ^ 0xa511e9b3u));
+	y = owenScramble(y, hash(s ^ 0x63d83595u));
+	return glm::vec2(float(x >> 8), float(y >> 8)) * (1.0f / 16777216.0f);
+}
+
+//--------------------------------------------------------------
+inline float Sampler::random(uint32_t pixel, uint32_t index, uint32_t dimension) const {
+	return (hash(pixelSeed(pixel, dimension) ^ hash(index)) >> 8) * (1.0f / 16777216.0f);
+}
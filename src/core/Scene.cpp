@@ -0,0 +1,312 @@
+#include "Scene.h"
+
+#include <cmath>
+#include <algorithm>
+
+//--------------------------------------------------------------
+Sphere *Scene::addSphere(glm::vec3 p, float r, Color d) {
+	Sphere *s = spherePool.create(p, r, d, 0);
+	track(s, kSpherePool, false);
+	return s;
+}
+
+//--------------------------------------------------------------
+Plane *Scene::addPlane(glm::vec3 p, glm::vec3 n, Color d) {
+	Plane *plane = planePool.create(p, n, d);
+	track(plane, kPlanePool, false);
+	return plane;
+}
+
+//--------------------------------------------------------------
+Light *Scene::addLight(glm::vec3 p, float r, float i, Color d) {
+	Light *l = lightPool.create(p, r, i, d, 0);
+	track(l, kLightPool, true);
+	return l;
+}
+
+//--------------------------------------------------------------
+Mesh *Scene::addMesh(const std::string &path, glm::vec3 p, Color d, std::string *error) {
+	Mesh *mesh = new Mesh();
+	if (!mesh->load(path, error)) {
+		delete mesh;
+		return NULL;
+	}
+	mesh->position = p;
+	mesh->diffuseColor = d;
+	track(mesh, kHeap, false);
+	return mesh;
+}
+
+//--------------------------------------------------------------
+SceneObject *Scene::addObject(SceneObject *o) {
+	track(o, kHeap, false);
+	return o;
+}
+
+//--------------------------------------------------------------
+Light *Scene::addLight(Light *l) {
+	track(l, kHeap, true);
+	return l;
+}
+
+//--------------------------------------------------------------
+int Scene::addPrototype(SceneObject *o) {
+	prototypes.push_back(o);
+	edits++;
+	return int(prototypes.size()) - 1;
+}
+
+//--------------------------------------------------------------
+void Scene::addInstance(int prototype, const Transform &transform, Color d) {
+	Instance instance;
+	instance.transform = transform;
+	instance.prototype = uint32_t(prototype);
+	instance.diffuseColor = d;
+	instances.push_back(instance);
+}
+
+// Gives o a handle, reusing a free slot if there is one, and puts it at the
+// end of objects or lights
+//
+void Scene::track(SceneObject *o, Storage storage, bool light) {
+	uint32_t index;
+	if (!freeSlots.empty()) {
+		index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else {
+		index = uint32_t(slots.size());
+		slots.push_back(Slot());
+	}
+	Slot &slot = slots[index];
+	slot.object = o;
+	slot.storage = storage;
+	slot.light = light;
+	o->handle.index = index;
+	o->handle.generation = slot.generation;
+	
+	if (light) {
+		o->ordinality = int(lights.size());
+		lights.push_back(static_cast<Light *>(o));
+	}
+	else {
+		o->ordinality = int(objects.size());
+		objects.push_back(o);
+	}
+	edits++;
+	if (accelBuilt) {
+		ObjectTree &tree = light ? lightAccel : objectAccel;
+		tree.add(o);
+		if (tree.stale()) buildAccel(light);
+	}
+}
+
+// Destroys o and frees its slot.  The new generation makes handles to o
+// stale.
+//
+void Scene::release(SceneObject *o) {
+	uint32_t index = o->handle.index;
+	Slot &slot = slots[index];
+	switch (slot.storage) {
+		case kSpherePool: spherePool.destroy(static_cast<Sphere *>(o)); break;
+		case kPlanePool: planePool.destroy(static_cast<Plane *>(o)); break;
+		case kLightPool: lightPool.destroy(static_cast<Light *>(o)); break;
+		default: delete o;
+	}
+	slot.object = NULL;
+	slot.generation++;
+	freeSlots.push_back(index);
+	edits++;
+}
+
+//--------------------------------------------------------------
+SceneObject *Scene::get(ObjectHandle h) const {
+	if (h.index >= slots.size() || slots[h.index].generation != h.generation) return NULL;
+	return slots[h.index].object;
+}
+
+// Moves the last entry into position i
+//
+template<class T>
+static void removeAt(std::vector<T *> &list, int i) {
+	list[i] = list.back();
+	list[i]->ordinality = i;
+	list.pop_back();
+}
+
+//--------------------------------------------------------------
+void Scene::remove(SceneObject *o) {
+	if (!o || get(o->handle) != o) return;
+	bool light = slots[o->handle.index].light;
+	ObjectTree &tree = light ? lightAccel : objectAccel;
+	if (accelBuilt) tree.remove(o);
+	if (light) removeAt(lights, o->ordinality);
+	else removeAt(objects, o->ordinality);
+	release(o);
+	if (accelBuilt && tree.stale()) buildAccel(light);
+}
+
+//--------------------------------------------------------------
+void Scene::remove(ObjectHandle h) {
+	remove(get(h));
+}
+
+//--------------------------------------------------------------
+void Scene::clear() {
+	clearObjects();
+	textures.clear();
+}
+
+//--------------------------------------------------------------
+void Scene::clearObjects() {
+	for (size_t i = 0; i < objects.size(); i++) release(objects[i]);
+	for (size_t i = 0; i < lights.size(); i++) release(lights[i]);
+	objects.clear();
+	lights.clear();
+	for (size_t i = 0; i < prototypes.size(); i++) delete prototypes[i];
+	prototypes.clear();
+	std::vector<Instance>().swap(instances);
+	edits++;
+	
+	// what is added next is often a whole scene, which is quicker to build
+	// once, when the caller asks, than to add one by one
+	rebuildAccel();
+	accelBuilt = false;
+}
+
+//--------------------------------------------------------------
+void Scene::rebuildAccel() {
+	buildAccel(false);
+	buildAccel(true);
+	accelBuilt = true;
+}
+
+//--------------------------------------------------------------
+void Scene::buildAccel(bool light) {
+	if (light) lightAccel.build(std::vector<SceneObject *>(lights.begin(), lights.end()));
+	else objectAccel.build(objects);
+}
+
+// Only valid while the objects and lights are the same ones the trees hold;
+// falls back to a rebuild otherwise.
+//
+void Scene::refitAccel() {
+	if (!accelBuilt || objectAccel.size() != objects.size() || lightAccel.size() != lights.size() || !objectAccel.refit() ||
+		!lightAccel.refit()) {
+		rebuildAccel();
+	}
+}
+
+// Tests one object and keeps the hit if it is in front of the ray and closer
+// than anything found so far
+//
+static bool intersectObject(SceneObject *obj, int index, const Ray &ray, float &tMax, Hit &hit) {
+	glm::vec3 point, normal;
+	if (!obj->intersect(ray, point, normal)) return false;
+	float t = glm::dot(point - ray.p, ray.d);
+	if (t <= 0 || t >= tMax) return false;
+	tMax = t;
+	hit.t = t;
+	hit.point = point;
+	hit.normal = normal;
+	hit.object = index;
+	hit.material = -1;
+	return true;
+}
+
+// Finds the closest object along the ray.  Ray directions are expected to be
+// normalized, so hit.t is the distance from the ray origin.
+//
+bool Scene::intersect(const Ray &ray, Hit &hit) {
+	float tMax = FLT_MAX;
+	return objectAccel.closestHit(ray, tMax, [&](SceneObject *o, float &t) {
+		return intersectObject(o, o->ordinality, ray, t, hit);
+	});
+}
+
+//--------------------------------------------------------------
+SceneObject *Scene::pick(const Ray &ray) {
+	Hit hit;
+	SceneObject *picked = NULL;
+	float tMax = FLT_MAX;
+	if (intersect(ray, hit)) {
+		picked = objects[hit.object];
+		tMax = hit.t;
+	}
+	lightAccel.closestHit(ray, tMax, [&](SceneObject *o, float &t) {
+		if (!intersectObject(o, o->ordinality, ray, t, hit)) return false;
+		picked = o;
+		return true;
+	});
+	return picked;
+}
+
+//--------------------------------------------------------------
+void buildDefaultScene(Scene &scene) {
+	scene.addPlane(glm::vec3(0, -2, 0), glm::vec3(0, 1, 0), Color::darkOrchid);
+	scene.addSphere(glm::vec3(0.0, 0.0, 2.0), 2.0, Color::orangeRed);
+	scene.addSphere(glm::vec3(2.0, 0.0, 0.0), 1.75, Color::cornflowerBlue);
+	scene.addSphere(glm::vec3(-3.0, 0.0, -1.5), 1.5, Color::paleGreen);
+	scene.addLight(glm::vec3(5, -1, -3), 0.25, 0.4, Color::white);
+	scene.addLight(glm::vec3(-2, 5, 6), 0.1, 0.8, Color::white);
+}
+
+// xorshift32: small, and unlike the <random> distributions, gives the same
+// numbers with every standard library
+//
+static float nextRandom(uint32_t &state) {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+//--------------------------------------------------------------
+void buildRandomScene(Scene &scene, int spheres, int lights, uint32_t seed) {
+	uint32_t state = seed * 2654435761u + 1;
+	if (state == 0) state = 1;    // the one state xorshift never leaves
+	const Color palette[] = { Color::orangeRed, Color::cornflowerBlue, Color::paleGreen, Color::darkGoldenRod, Color::darkOrchid, Color::grey };
+	
+	Plane *ground = scene.addPlane(glm::vec3(0, -2, -7), glm::vec3(0, 1, 0), Color::dimGrey);
+	ground->width = 60;
+	ground->height = 60;
+	
+	// spheres fill about 5% of a 16 x 6 x 15 box in front of the camera
+	float scale = std::min(2.0f, std::cbrt(0.05f * 16 * 6 * 15 * 3 / (4 * 3.14159265f * std::max(spheres, 1))));
+	for (int i = 0; i < spheres; i++) {
+		glm::vec3 p(-8 + 16 * nextRandom(state), -2 + 6 * nextRandom(state), -15 + 15 * nextRandom(state));
+		float r = scale * (0.5f + 0.5f * nextRandom(state));
+		scene.addSphere(p, r, palette[int(nextRandom(state) * 6) % 6]);
+	}
+	
+	// the lights share the brightness of the default scene's two
+	for (int i = 0; i < lights; i++) {
+		glm::vec3 p(-10 + 20 * nextRandom(state), 5 + 4 * nextRandom(state), -15 + 20 * nextRandom(state));
+		scene.addLight(p, 0.1f, 1.2f / lights, Color::white);
+	}
+}
+
+// Instances go on a grid over the 16 x 15 patch of ground the random
+// scene's spheres stand on, one per cell, jittered within it
+//
+//--------------------------------------------------------------
+void scatterInstances(Scene &scene, int prototype, int count, uint32_t seed) {
+	AABB box;
+	if (prototype < 0 || prototype >= int(scene.prototypes.size()) || !scene.prototypes[prototype]->getBounds(box)) return;
+	uint32_t state = seed * 2654435761u + 1;
+	if (state == 0) state = 1;
+	const Color palette[] = { Color::orangeRed, Color::cornflowerBlue, Color::paleGreen, Color::darkGoldenRod, Color::darkOrchid, Color::grey };
+	
+	int columns = std::max(1, int(std::ceil(std::sqrt(count * 16.0f / 15))));
+	float cell = 16.0f / columns;
+	glm::vec3 e = box.extent();
+	float fit = cell / std::max(std::max(e.x, e.z), 1e-6f);
+	scene.instances.reserve(scene.instances.size() + count);
+	for (int i = 0; i < count; i++) {
+		glm::vec3 p(-8 + cell * (i % columns + nextRandom(state)), -2, -cell * (i / columns + nextRandom(state)));
+		float size = fit * (0.5f + 0.3f * nextRandom(state));
+		Transform t = Transform::translate(p) * Transform::rotate(6.2831853f * nextRandom(state), glm::vec3(0, 1, 0)) *
+			Transform::scale(glm::vec3(size)) * Transform::translate(glm::vec3(-box.center().x, -box.min.y, -box.center().z));
+		scene.addInstance(prototype, t, palette[int(nextRandom(state) * 6) % 6]);
+	}
+}
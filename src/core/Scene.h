@@ -0,0 +1,142 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "SceneObject.h"
+#include "Mesh.h"
+#include "Texture.h"
+#include "BVH.h"
+#include "ObjectTree.h"
+#include "ObjectPool.h"
+#include "Transform.h"
+
+//  Closest intersection of a ray with the scene
+//
+struct Hit {
+	float t;             // distance along the ray
+	glm::vec3 point;
+	glm::vec3 normal;
+	int object;          // index into Scene::objects; -1 for an instance
+	int material;        // index into RenderScene::materials; -1 from Scene queries
+};
+
+//  A copy of one of the scene's prototypes, placed by a transform and with
+//  its own color and texture.  Instances are small, so a scene can hold
+//  millions of copies of one detailed mesh for little more than the mesh.
+//
+struct Instance {
+	Transform transform;       // prototype space to world
+	uint32_t prototype;        // index into Scene::prototypes
+	Color diffuseColor;        // replaces the prototype's
+	TextureHandle texture;     // likewise
+};
+
+//  Everything the renderer needs to know about the world besides the camera:
+//  the objects, the lights and the images used as textures.  The scene owns the
+//  objects and lights it holds.
+//
+//  Spheres, planes and lights made by the add functions live in pools (see
+//  ObjectPool); other objects are made by the caller and handed over to
+//  addObject() or addLight().  Either way the scene gives each a handle (see
+//  ObjectHandle), and remove() destroys it in O(1): the last entry of
+//  objects (or lights) moves into the gap, so both stay packed, in no
+//  particular order.  Pointers to objects that are still in the scene stay
+//  good through any adds and removes.
+//
+//  Prototypes are objects that are only seen through instances (see
+//  Instance): addPrototype() takes one over, and instances refer to it by
+//  its index in prototypes.  They stay until clearObjects(); instances are a
+//  plain array that callers edit as they like.
+//
+//  editCount() goes up with every object, light or prototype added or
+//  removed, so a copy of the lists can tell whether it still lines up with
+//  them (see RenderScene::refit()).
+//
+//  This is the editable form of the scene.  Renders work from a RenderScene,
+//  a flat copy made when the render starts.
+//
+//  Ray queries go through a BVH over the objects (and one over the lights, for
+//  picking); see ObjectTree.  Instances are left out of them: they are
+//  rendered, but can't be picked.  Once rebuildAccel() has built them, adds
+//  and removes keep them current, in O(log n) each, building them again only
+//  now and then; clearObjects() leaves them empty until the next
+//  rebuildAccel().  Whoever moves or resizes objects or lights calls
+//  refitAccel().
+//
+class Scene {
+public:
+	Scene() {}
+	~Scene() { clear(); }
+	Scene(const Scene &) = delete;
+	Scene &operator=(const Scene &) = delete;
+	
+	Sphere *addSphere(glm::vec3 p, float r, Color d);
+	Plane *addPlane(glm::vec3 p, glm::vec3 n, Color d);
+	Light *addLight(glm::vec3 p, float r, float i, Color d);
+	Mesh *addMesh(const std::string &path, glm::vec3 p, Color d, std::string *error = nullptr);    // NULL if the file can't be loaded
+	SceneObject *addObject(SceneObject *o);    // takes ownership
+	Light *addLight(Light *l);                 // takes ownership
+	int addPrototype(SceneObject *o);          // takes ownership; returns the prototype's index
+	void addInstance(int prototype, const Transform &transform, Color d);
+	void remove(SceneObject *o);                // an object or light, which is destroyed
+	void remove(ObjectHandle h);                // does nothing if h refers to nothing
+	SceneObject *get(ObjectHandle h) const;     // NULL once the object has been removed
+	void clear();
+	void clearObjects();    // removes the objects, lights, prototypes and instances but keeps the textures
+	uint64_t editCount() const { return edits; }
+	
+	void rebuildAccel();
+	void refitAccel();
+	bool hasAccel() const { return accelBuilt; }
+	
+	bool intersect(const Ray &ray, Hit &hit);
+	SceneObject *pick(const Ray &ray);    // closest object or light hit by the ray, or NULL
+	
+	std::vector<SceneObject *> objects;
+	std::vector<Light *> lights;
+	std::vector<SceneObject *> prototypes;
+	std::vector<Instance> instances;
+	TextureStore textures;
+	
+private:
+	enum Storage : uint8_t { kHeap, kSpherePool, kPlanePool, kLightPool };
+	
+	struct Slot {
+		SceneObject *object = NULL;    // NULL while free
+		uint32_t generation = 0;
+		Storage storage = kHeap;
+		bool light = false;
+	};
+	
+	void track(SceneObject *o, Storage storage, bool light);
+	void release(SceneObject *o);
+	void buildAccel(bool light);
+	
+	std::vector<Slot> slots;            // by ObjectHandle::index
+	std::vector<uint32_t> freeSlots;    // reused last freed, first
+	ObjectPool<Sphere> spherePool;
+	ObjectPool<Plane> planePool;
+	ObjectPool<Light> lightPool;
+	
+	ObjectTree objectAccel;
+	ObjectTree lightAccel;
+	bool accelBuilt = false;
+	uint64_t edits = 0;
+};
+
+// The scene the app starts with: a ground plane, three spheres and two lights.
+//
+void buildDefaultScene(Scene &scene);
+
+// A reproducible scene of any size, for benchmarks: a ground plane with
+// spheres scattered over the default camera's view and lights above them.
+// Sphere sizes shrink as the count grows, so the scene stays about as full.
+// The same arguments give the same scene on every platform.
+//
+void buildRandomScene(Scene &scene, int spheres, int lights, uint32_t seed = 1);
+
+// Scatters count instances of a prototype over the ground of the random
+// scene, each turned about the vertical, scaled to fit the space it gets and
+// colored at random.  The prototype sits on its lowest point.
+//
+void scatterInstances(Scene &scene, int prototype, int count, uint32_t seed = 1);
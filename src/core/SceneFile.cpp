@@ -0,0 +1,764 @@
+#include "SceneFile.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <sstream>
+#include <unordered_map>
+
+static const char kMagic[8] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', 0 };
+static const uint32_t kByteOrder = 0x01020304;
+
+static_assert(sizeof(SceneFileHeader) == 24 && sizeof(SceneFileSection) == 24, "scene file layout changed");
+static_assert(sizeof(CameraRecord) == 64 && sizeof(MaterialRecord) == 12 && sizeof(SphereRecord) == 20 &&
+	sizeof(PlaneRecord) == 36 && sizeof(MeshRecord) == 20 && sizeof(LightRecord) == 28 &&
+	sizeof(PrototypeRecord) == 40 && sizeof(InstanceRecord) == 56, "scene record layout changed");
+
+static bool fail(std::string *error, const std::string &message) {
+	if (error) *error = message;
+	return false;
+}
+
+static bool hasExtension(const std::string &path, const char *ext) {
+	size_t n = strlen(ext);
+	if (path.size() < n) return false;
+	for (size_t i = 0; i < n; i++) {
+		if (tolower(path[path.size() - n + i]) != ext[i]) return false;
+	}
+	return true;
+}
+
+// Smallest record a reader can use for each kind of section; 0 for kinds it
+// doesn't know, which are skipped
+//
+static size_t minimumRecordSize(uint32_t type) {
+	switch (type) {
+		case kSectionCamera: return offsetof(CameraRecord, up);
+		case kSectionMaterials: return sizeof(MaterialRecord);
+		case kSectionSpheres: return sizeof(SphereRecord);
+		case kSectionPlanes: return sizeof(PlaneRecord);
+		case kSectionMeshes: return sizeof(MeshRecord);
+		case kSectionLights: return sizeof(LightRecord);
+		case kSectionTextures: return sizeof(uint32_t);
+		case kSectionStrings: return 1;
+		case kSectionPrototypes: return sizeof(PrototypeRecord);
+		case kSectionInstances: return sizeof(InstanceRecord);
+	}
+	return 0;
+}
+
+// i'th record of an array whose records are stride bytes apart
+//
+template<class Record>
+static const Record &recordAt(const Record *base, size_t i, size_t stride) {
+	return *reinterpret_cast<const Record *>(reinterpret_cast<const char *>(base) + i * stride);
+}
+
+//--------------------------------------------------------------
+bool SceneFile::open(const std::string &path, std::string *error) {
+	sections = nullptr;
+	sectionCount = 0;
+	if (!file.open(path)) return fail(error, "could not open " + path);
+	
+	const SceneFileHeader *header = reinterpret_cast<const SceneFileHeader *>(file.data());
+	if (file.size() < sizeof(SceneFileHeader) || memcmp(header->magic, kMagic, sizeof(kMagic)) != 0) {
+		return fail(error, path + ": not a binary scene file");
+	}
+	if (header->byteOrder != kByteOrder) return fail(error, path + ": written on a machine with the other byte order");
+	if (header->version == 0 || header->version > kSceneFileVersion) {
+		return fail(error, path + ": unsupported version " + std::to_string(header->version));
+	}
+	
+	uint64_t tableEnd = sizeof(SceneFileHeader) + uint64_t(header->sectionCount) * sizeof(SceneFileSection);
+	if (tableEnd > file.size()) return fail(error, path + ": truncated section table");
+	const SceneFileSection *table = reinterpret_cast<const SceneFileSection *>(file.data() + sizeof(SceneFileHeader));
+	for (uint32_t i = 0; i < header->sectionCount; i++) {
+		const SceneFileSection &s = table[i];
+		if (s.recordSize < minimumRecordSize(s.type)) {
+			return fail(error, path + ": section " + std::to_string(i) + " has records too small to read");
+		}
+		if (s.offset % 4 != 0 || s.offset > file.size() ||
+			(s.recordSize > 0 && s.count > (file.size() - s.offset) / s.recordSize)) {
+			return fail(error, path + ": section " + std::to_string(i) + " is truncated or misaligned");
+		}
+		if (s.type == kSectionStrings && s.count > 0 && file.data()[s.offset + s.count - 1] != 0) {
+			return fail(error, path + ": names are not terminated");
+		}
+	}
+	sections = table;
+	sectionCount = header->sectionCount;
+	return true;
+}
+
+//--------------------------------------------------------------
+const SceneFileSection *SceneFile::find(SceneSection type) const {
+	for (uint32_t i = 0; i < sectionCount; i++) {
+		if (sections[i].type == type) return &sections[i];
+	}
+	return nullptr;
+}
+
+// Fields a file's record stops short of keep their defaults
+//
+//--------------------------------------------------------------
+bool SceneFile::camera(CameraRecord &c) const {
+	size_t count, stride;
+	const CameraRecord *record = records<CameraRecord>(kSectionCamera, count, stride);
+	if (count == 0) return false;
+	c = CameraRecord();
+	memcpy(&c, record, std::min(stride, sizeof(c)));
+	return true;
+}
+
+//--------------------------------------------------------------
+const char *SceneFile::string(uint32_t offset) const {
+	const SceneFileSection *s = find(kSectionStrings);
+	if (!s || offset >= s->count) return nullptr;
+	return file.data() + s->offset + offset;
+}
+
+//  Loading
+//
+
+static std::string directoryOf(const std::string &path) {
+	size_t slash = path.find_last_of('/');
+	return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// Relative names are tried next to the scene file first, then as given
+//
+static std::string resolvePath(const std::string &dir, const std::string &name) {
+	if (dir.empty() || name.empty() || name[0] == '/') return name;
+	std::string joined = dir + name;
+	FILE *f = fopen(joined.c_str(), "rb");
+	if (!f) return name;
+	fclose(f);
+	return joined;
+}
+
+//--------------------------------------------------------------
+static bool findTexture(Scene &scene, const std::string &name, const std::string &dir, TextureHandle &h, std::string *error) {
+	h = scene.textures.find(name);
+	if (h.valid()) return true;
+	Image image;
+	if (!image.load(resolvePath(dir, name))) return fail(error, "could not load texture " + name);
+	h = scene.textures.add(image, name);
+	return true;
+}
+
+// Objects read so far.  They go into the scene only once the whole file has
+// been read, so a bad file leaves the scene as it was.
+//
+struct LoadedObjects {
+	std::vector<SceneObject *> objects;
+	std::vector<Light *> lights;
+	std::vector<SceneObject *> prototypes;
+	std::vector<Instance> instances;
+	bool haveCamera = false;
+	CameraRecord camera;
+	
+	~LoadedObjects() {
+		for (size_t i = 0; i < objects.size(); i++) delete objects[i];
+		for (size_t i = 0; i < lights.size(); i++) delete lights[i];
+		for (size_t i = 0; i < prototypes.size(); i++) delete prototypes[i];
+	}
+	
+	void moveTo(Scene &scene, RenderCam &cam) {
+		scene.clearObjects();
+		scene.objects.reserve(objects.size());
+		for (size_t i = 0; i < objects.size(); i++) scene.addObject(objects[i]);
+		for (size_t i = 0; i < lights.size(); i++) scene.addLight(lights[i]);
+		for (size_t i = 0; i < prototypes.size(); i++) scene.addPrototype(prototypes[i]);
+		scene.instances.swap(instances);
+		objects.clear();
+		lights.clear();
+		prototypes.clear();
+		if (haveCamera) {
+			cam.position = glm::vec3(camera.position[0], camera.position[1], camera.position[2]);
+			cam.aim = glm::vec3(camera.aim[0], camera.aim[1], camera.aim[2]);
+			cam.view.setSize(glm::vec2(camera.viewMin[0], camera.viewMin[1]), glm::vec2(camera.viewMax[0], camera.viewMax[1]));
+			cam.view.position.z = camera.viewZ;
+			cam.up = glm::vec3(camera.up[0], camera.up[1], camera.up[2]);
+			cam.aperture = camera.aperture;
+			cam.focusDistance = camera.focusDistance;
+		}
+	}
+};
+
+static glm::vec3 toVec(const float v[3]) {
+	return glm::vec3(v[0], v[1], v[2]);
+}
+
+static Color toColor(const uint8_t c[3]) {
+	return Color(c[0], c[1], c[2]);
+}
+
+static Transform toTransform(const float m[12]) {
+	Transform t;
+	t.x = glm::vec3(m[0], m[4], m[8]);
+	t.y = glm::vec3(m[1], m[5], m[9]);
+	t.z = glm::vec3(m[2], m[6], m[10]);
+	t.t = glm::vec3(m[3], m[7], m[11]);
+	return t;
+}
+
+//--------------------------------------------------------------
+static bool loadBinary(Scene &scene, RenderCam &cam, const std::string &path, std::string *error) {
+	SceneFile file;
+	if (!file.open(path, error)) return false;
+	std::string dir = directoryOf(path);
+	size_t count, stride;
+	
+	const uint32_t *names = file.records<uint32_t>(kSectionTextures, count, stride);
+	std::vector<TextureHandle> textures(count);
+	for (size_t i = 0; i < count; i++) {
+		const char *name = file.string(recordAt(names, i, stride));
+		if (!name) return fail(error, path + ": bad texture name");
+		if (!findTexture(scene, name, dir, textures[i], error)) return false;
+	}
+	
+	size_t materialCount, materialStride;
+	const MaterialRecord *materials = file.records<MaterialRecord>(kSectionMaterials, materialCount, materialStride);
+	for (size_t i = 0; i < materialCount; i++) {
+		int32_t t = recordAt(materials, i, materialStride).texture;
+		if (t < -1 || t >= int32_t(textures.size())) return fail(error, path + ": material refers to a missing texture");
+	}
+	auto setMaterial = [&](SceneObject *o, uint32_t m) {
+		if (m >= materialCount) return false;
+		const MaterialRecord &mat = recordAt(materials, m, materialStride);
+		o->diffuseColor = toColor(mat.diffuse);
+		o->specularColor = toColor(mat.specular);
+		o->texture = mat.texture >= 0 ? textures[mat.texture] : TextureHandle();
+		return true;
+	};
+	
+	LoadedObjects loaded;
+	loaded.haveCamera = file.camera(loaded.camera);
+	
+	// each adds the object it reads to the end of to, which owns it from then on
+	auto readPlane = [&](const PlaneRecord &r, std::vector<SceneObject *> &to) {
+		Plane *plane = new Plane(toVec(r.position), toVec(r.normal), Color::dimGrey, r.width, r.height);
+		to.push_back(plane);
+		return setMaterial(plane, r.material) || fail(error, path + ": plane refers to a missing material");
+	};
+	auto readSphere = [&](const SphereRecord &r, std::vector<SceneObject *> &to) {
+		Sphere *sphere = new Sphere(toVec(r.center), r.radius, Color::grey, 0);
+		to.push_back(sphere);
+		return setMaterial(sphere, r.material) || fail(error, path + ": sphere refers to a missing material");
+	};
+	auto readMesh = [&](const MeshRecord &r, std::vector<SceneObject *> &to) {
+		const char *name = file.string(r.path);
+		if (!name) return fail(error, path + ": bad mesh file name");
+		Mesh *mesh = new Mesh();
+		to.push_back(mesh);
+		if (!mesh->load(resolvePath(dir, name), error)) return false;
+		mesh->position = toVec(r.position);
+		return setMaterial(mesh, r.material) || fail(error, path + ": mesh refers to a missing material");
+	};
+	
+	const PlaneRecord *planes = file.records<PlaneRecord>(kSectionPlanes, count, stride);
+	for (size_t i = 0; i < count; i++) {
+		if (!readPlane(recordAt(planes, i, stride), loaded.objects)) return false;
+	}
+	
+	const SphereRecord *spheres = file.records<SphereRecord>(kSectionSpheres, count, stride);
+	loaded.objects.reserve(loaded.objects.size() + count);
+	for (size_t i = 0; i < count; i++) {
+		if (!readSphere(recordAt(spheres, i, stride), loaded.objects)) return false;
+	}
+	
+	const MeshRecord *meshes = file.records<MeshRecord>(kSectionMeshes, count, stride);
+	for (size_t i = 0; i < count; i++) {
+		if (!readMesh(recordAt(meshes, i, stride), loaded.objects)) return false;
+	}
+	
+	const PrototypeRecord *prototypes = file.records<PrototypeRecord>(kSectionPrototypes, count, stride);
+	for (size_t i = 0; i < count; i++) {
+		const PrototypeRecord &r = recordAt(prototypes, i, stride);
+		bool ok;
+		if (r.kind == kSectionSpheres) ok = readSphere(r.sphere, loaded.prototypes);
+		else if (r.kind == kSectionPlanes) ok = readPlane(r.plane, loaded.prototypes);
+		else if (r.kind == kSectionMeshes) ok = readMesh(r.mesh, loaded.prototypes);
+		else ok = fail(error, path + ": prototype of unknown kind");
+		if (!ok) return false;
+	}
+	
+	const InstanceRecord *instances = file.records<InstanceRecord>(kSectionInstances, count, stride);
+	loaded.instances.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		const InstanceRecord &r = recordAt(instances, i, stride);
+		if (r.prototype >= loaded.prototypes.size()) return fail(error, path + ": instance refers to a missing prototype");
+		if (r.material >= materialCount) return fail(error, path + ": instance refers to a missing material");
+		const MaterialRecord &mat = recordAt(materials, r.material, materialStride);
+		Instance &instance = loaded.instances[i];
+		instance.transform = toTransform(r.transform);
+		instance.prototype = r.prototype;
+		instance.diffuseColor = toColor(mat.diffuse);
+		instance.texture = mat.texture >= 0 ? textures[mat.texture] : TextureHandle();
+	}
+	
+	const LightRecord *lights = file.records<LightRecord>(kSectionLights, count, stride);
+	for (size_t i = 0; i < count; i++) {
+		const LightRecord &r = recordAt(lights, i, stride);
+		Light *light = new Light(toVec(r.position), r.radius, r.intensity, toColor(r.color), 0);
+		light->range = r.range;
+		loaded.lights.push_back(light);
+	}
+	
+	loaded.moveTo(scene, cam);
+	return true;
+}
+
+static bool readVec(std::istream &in, glm::vec3 &v) {
+	return bool(in >> v.x >> v.y >> v.z);
+}
+
+static bool readColor(std::istream &in, Color &c) {
+	int r, g, b;
+	if (!(in >> r >> g >> b) || r < 0 || r > 255 || g < 0 || g > 255 || b < 0 || b > 255) return false;
+	c = Color(r, g, b);
+	return true;
+}
+
+//--------------------------------------------------------------
+static bool loadText(Scene &scene, RenderCam &cam, const std::string &path, std::string *error) {
+	MappedFile file;
+	if (!file.open(path)) return fail(error, "could not open " + path);
+	std::string dir = directoryOf(path);
+	
+	LoadedObjects loaded;
+	std::vector<TextureHandle> textures;
+	bool haveVersion = false;
+	int lineNumber = 0;
+	for (const char *p = file.data(); p < file.end(); ) {
+		const char *eol = static_cast<const char *>(memchr(p, '\n', file.end() - p));
+		if (!eol) eol = file.end();
+		std::string line(p, eol);
+		p = eol + 1;
+		lineNumber++;
+		
+		size_t comment = line.find('#');
+		if (comment != std::string::npos) line.erase(comment);
+		std::istringstream in(line);
+		std::string keyword;
+		if (!(in >> keyword)) continue;
+		std::string where = path + ":" + std::to_string(lineNumber) + ": ";
+		
+		if (!haveVersion) {
+			unsigned version;
+			if (keyword != "rtscene" || !(in >> version)) return fail(error, path + ": not a scene file");
+			if (version == 0 || version > kSceneFileVersion) return fail(error, path + ": unsupported version " + std::to_string(version));
+			haveVersion = true;
+			continue;
+		}
+		
+		// a prototype is written as an object, with "prototype" in front
+		std::vector<SceneObject *> *objects = &loaded.objects;
+		if (keyword == "prototype") {
+			if (!(in >> keyword) || (keyword != "sphere" && keyword != "plane" && keyword != "mesh")) return fail(error, where + "bad prototype");
+			objects = &loaded.prototypes;
+		}
+		
+		SceneObject *object = nullptr;
+		Plane *plane = nullptr;
+		Light *light = nullptr;
+		Instance *instance = nullptr;
+		CameraRecord *camera = nullptr;
+		if (keyword == "camera") {
+			CameraRecord &c = *(camera = &loaded.camera);
+			if (!(in >> c.position[0] >> c.position[1] >> c.position[2] >> c.aim[0] >> c.aim[1] >> c.aim[2] >>
+				c.viewMin[0] >> c.viewMin[1] >> c.viewMax[0] >> c.viewMax[1] >> c.viewZ)) {
+				return fail(error, where + "bad camera");
+			}
+			loaded.haveCamera = true;
+		}
+		else if (keyword == "texture") {
+			std::string name;
+			if (!(in >> name)) return fail(error, where + "texture without a file name");
+			std::string message;
+			textures.push_back(TextureHandle());
+			if (!findTexture(scene, name, dir, textures.back(), &message)) return fail(error, where + message);
+		}
+		else if (keyword == "sphere") {
+			glm::vec3 center;
+			float radius;
+			Color diffuse;
+			if (!readVec(in, center) || !(in >> radius) || !readColor(in, diffuse)) return fail(error, where + "bad sphere");
+			object = new Sphere(center, radius, diffuse, 0);
+			objects->push_back(object);
+		}
+		else if (keyword == "plane") {
+			glm::vec3 position, normal;
+			Color diffuse;
+			if (!readVec(in, position) || !readVec(in, normal) || !readColor(in, diffuse)) return fail(error, where + "bad plane");
+			object = plane = new Plane(position, normal, diffuse);
+			objects->push_back(object);
+		}
+		else if (keyword == "mesh") {
+			std::string name;
+			glm::vec3 position;
+			Color diffuse;
+			if (!(in >> name) || !readVec(in, position) || !readColor(in, diffuse)) return fail(error, where + "bad mesh");
+			std::string message;
+			Mesh *mesh = new Mesh();
+			object = mesh;
+			objects->push_back(object);
+			if (!mesh->load(resolvePath(dir, name), &message)) return fail(error, where + message);
+			mesh->position = position;
+			mesh->diffuseColor = diffuse;
+		}
+		else if (keyword == "light") {
+			glm::vec3 position;
+			float radius, intensity;
+			Color color;
+			if (!readVec(in, position) || !(in >> radius >> intensity) || !readColor(in, color)) return fail(error, where + "bad light");
+			light = new Light(position, radius, intensity, color, 0);
+			loaded.lights.push_back(light);
+		}
+		else if (keyword == "instance") {
+			unsigned prototype;
+			float m[12];
+			Color diffuse;
+			bool ok = (in >> prototype) && prototype < loaded.prototypes.size();
+			for (int k = 0; k < 12 && ok; k++) ok = bool(in >> m[k]);
+			if (!ok || !readColor(in, diffuse)) return fail(error, where + "bad instance");
+			loaded.instances.push_back(Instance());
+			instance = &loaded.instances.back();
+			instance->transform = toTransform(m);
+			instance->prototype = prototype;
+			instance->diffuseColor = diffuse;
+		}
+		else return fail(error, where + "unknown keyword " + keyword);
+		
+		// options
+		std::string option;
+		while (in >> option) {
+			bool ok = false;
+			if (option == "specular" && object) ok = readColor(in, object->specularColor);
+			else if (option == "texture" && (object || instance)) {
+				int t;
+				ok = (in >> t) && t >= 0 && t < int(textures.size());
+				if (ok) (object ? object->texture : instance->texture) = textures[t];
+			}
+			else if (option == "size" && plane) ok = bool(in >> plane->width >> plane->height);
+			else if (option == "range" && light) ok = bool(in >> light->range);
+			else if (option == "up" && camera) ok = bool(in >> camera->up[0] >> camera->up[1] >> camera->up[2]);
+			else if (option == "lens" && camera) ok = bool(in >> camera->aperture >> camera->focusDistance);
+			else if (keyword == "camera" || keyword == "texture") return fail(error, where + "unexpected " + option);
+			if (!ok) return fail(error, where + "bad option " + option);
+		}
+	}
+	if (!haveVersion) return fail(error, path + ": not a scene file");
+	
+	loaded.moveTo(scene, cam);
+	return true;
+}
+
+//--------------------------------------------------------------
+bool loadScene(Scene &scene, RenderCam &cam, const std::string &path, std::string *error) {
+	FILE *f = fopen(path.c_str(), "rb");
+	if (!f) return fail(error, "could not open " + path);
+	char magic[sizeof(kMagic)] = {};
+	size_t n = fread(magic, 1, sizeof(magic), f);
+	fclose(f);
+	if (n == sizeof(magic) && memcmp(magic, kMagic, sizeof(kMagic)) == 0) return loadBinary(scene, cam, path, error);
+	return loadText(scene, cam, path, error);
+}
+
+//  Saving
+//
+
+// The named textures the scene's objects use, numbered in order of first use.
+// Textures without a name can't be referred to and are left out.
+//
+struct TextureNumbers {
+	std::vector<std::string> names;
+	std::unordered_map<int, int> number;    // TextureHandle index -> number in the file
+	
+	explicit TextureNumbers(Scene &scene) {
+		for (size_t i = 0; i < scene.objects.size(); i++) add(scene, scene.objects[i]->texture);
+		for (size_t i = 0; i < scene.prototypes.size(); i++) add(scene, scene.prototypes[i]->texture);
+		for (size_t i = 0; i < scene.instances.size(); i++) add(scene, scene.instances[i].texture);
+	}
+	void add(Scene &scene, TextureHandle h) {
+		if (!scene.textures.contains(h) || scene.textures.name(h).empty() || number.count(h.index)) return;
+		number[h.index] = int(names.size());
+		names.push_back(scene.textures.name(h));
+	}
+	int operator()(TextureHandle h) const {
+		std::unordered_map<int, int>::const_iterator i = number.find(h.index);
+		return i == number.end() ? -1 : i->second;
+	}
+};
+
+static void toFloats(const glm::vec3 &v, float out[3]) {
+	out[0] = v.x; out[1] = v.y; out[2] = v.z;
+}
+
+static void toBytes(const Color &c, uint8_t out[3]) {
+	out[0] = c.r; out[1] = c.g; out[2] = c.b;
+}
+
+static CameraRecord cameraRecord(const RenderCam &cam) {
+	CameraRecord c;
+	toFloats(cam.position, c.position);
+	toFloats(cam.aim, c.aim);
+	c.viewMin[0] = cam.view.min.x; c.viewMin[1] = cam.view.min.y;
+	c.viewMax[0] = cam.view.max.x; c.viewMax[1] = cam.view.max.y;
+	c.viewZ = cam.view.position.z;
+	toFloats(cam.up, c.up);
+	c.aperture = cam.aperture;
+	c.focusDistance = cam.focusDistance;
+	return c;
+}
+
+//--------------------------------------------------------------
+static bool saveBinary(Scene &scene, const RenderCam &cam, const std::string &path, std::string *error) {
+	TextureNumbers textureNumbers(scene);
+	std::string strings;
+	auto addString = [&](const std::string &s) {
+		uint32_t offset = uint32_t(strings.size());
+		strings.append(s.c_str(), s.size() + 1);
+		return offset;
+	};
+	std::vector<uint32_t> textureNames;
+	for (size_t i = 0; i < textureNumbers.names.size(); i++) textureNames.push_back(addString(textureNumbers.names[i]));
+	
+	// objects with the same colors and texture share a material
+	std::vector<MaterialRecord> materials;
+	std::unordered_map<uint64_t, uint32_t> materialIndex;
+	auto addMaterial = [&](const Color &d, const Color &s, TextureHandle h) {
+		int texture = textureNumbers(h);
+		uint64_t key = uint64_t(d.r) | uint64_t(d.g) << 8 | uint64_t(d.b) << 16 |
+			uint64_t(s.r) << 24 | uint64_t(s.g) << 32 | uint64_t(s.b) << 40 | uint64_t(texture + 1) << 48;
+		std::unordered_map<uint64_t, uint32_t>::iterator found = materialIndex.find(key);
+		if (found != materialIndex.end()) return found->second;
+		MaterialRecord m = {};
+		toBytes(d, m.diffuse);
+		toBytes(s, m.specular);
+		m.texture = texture;
+		materials.push_back(m);
+		materialIndex[key] = uint32_t(materials.size() - 1);
+		return uint32_t(materials.size() - 1);
+	};
+	
+	// fills in r as a prototype record, whose kind says which record it holds
+	auto objectRecord = [&](SceneObject *o, PrototypeRecord &r) {
+		uint32_t material = addMaterial(o->diffuseColor, o->specularColor, o->texture);
+		if (Sphere *sphere = dynamic_cast<Sphere *>(o)) {
+			r.kind = kSectionSpheres;
+			toFloats(sphere->position, r.sphere.center);
+			r.sphere.radius = sphere->getRadius();
+			r.sphere.material = material;
+		}
+		else if (Plane *plane = dynamic_cast<Plane *>(o)) {
+			r.kind = kSectionPlanes;
+			toFloats(plane->position, r.plane.position);
+			toFloats(plane->normal, r.plane.normal);
+			r.plane.width = plane->width;
+			r.plane.height = plane->height;
+			r.plane.material = material;
+		}
+		else if (Mesh *mesh = dynamic_cast<Mesh *>(o)) {
+			if (mesh->getPath().empty()) return fail(error, "can't save a mesh that wasn't loaded from a file");
+			r.kind = kSectionMeshes;
+			toFloats(mesh->position, r.mesh.position);
+			r.mesh.material = material;
+			r.mesh.path = addString(mesh->getPath());
+		}
+		else return fail(error, "can't save an object of unknown kind");
+		return true;
+	};
+	
+	std::vector<SphereRecord> spheres;
+	std::vector<PlaneRecord> planes;
+	std::vector<MeshRecord> meshes;
+	for (size_t i = 0; i < scene.objects.size(); i++) {
+		PrototypeRecord r;
+		if (!objectRecord(scene.objects[i], r)) return false;
+		if (r.kind == kSectionSpheres) spheres.push_back(r.sphere);
+		else if (r.kind == kSectionPlanes) planes.push_back(r.plane);
+		else meshes.push_back(r.mesh);
+	}
+	
+	std::vector<PrototypeRecord> prototypes(scene.prototypes.size());
+	for (size_t i = 0; i < scene.prototypes.size(); i++) {
+		if (!objectRecord(scene.prototypes[i], prototypes[i])) return false;
+	}
+	std::vector<InstanceRecord> instances(scene.instances.size());
+	for (size_t i = 0; i < scene.instances.size(); i++) {
+		const Instance &instance = scene.instances[i];
+		const Transform &t = instance.transform;
+		InstanceRecord &r = instances[i];
+		for (int row = 0; row < 3; row++) {
+			r.transform[4 * row] = t.x[row];
+			r.transform[4 * row + 1] = t.y[row];
+			r.transform[4 * row + 2] = t.z[row];
+			r.transform[4 * row + 3] = t.t[row];
+		}
+		r.prototype = instance.prototype;
+		r.material = addMaterial(instance.diffuseColor, Color::lightGray, instance.texture);
+	}
+	
+	std::vector<LightRecord> lights;
+	for (size_t i = 0; i < scene.lights.size(); i++) {
+		Light *l = scene.lights[i];
+		LightRecord r = {};
+		toFloats(l->position, r.position);
+		r.radius = l->getRadius();
+		r.intensity = l->intensity;
+		r.range = l->range;
+		toBytes(l->diffuseColor, r.color);
+		lights.push_back(r);
+	}
+	CameraRecord camera = cameraRecord(cam);
+	
+	struct Section {
+		uint32_t type, recordSize;
+		size_t count;
+		const void *data;
+	};
+	const Section contents[] = {
+		{ kSectionCamera, sizeof(CameraRecord), 1, &camera },
+		{ kSectionMaterials, sizeof(MaterialRecord), materials.size(), materials.data() },
+		{ kSectionPlanes, sizeof(PlaneRecord), planes.size(), planes.data() },
+		{ kSectionSpheres, sizeof(SphereRecord), spheres.size(), spheres.data() },
+		{ kSectionMeshes, sizeof(MeshRecord), meshes.size(), meshes.data() },
+		{ kSectionLights, sizeof(LightRecord), lights.size(), lights.data() },
+		{ kSectionPrototypes, sizeof(PrototypeRecord), prototypes.size(), prototypes.data() },
+		{ kSectionInstances, sizeof(InstanceRecord), instances.size(), instances.data() },
+		{ kSectionTextures, sizeof(uint32_t), textureNames.size(), textureNames.data() },
+		{ kSectionStrings, 1, strings.size(), strings.data() },
+	};
+	const uint32_t count = sizeof(contents) / sizeof(contents[0]);
+	
+	SceneFileHeader header = {};
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kSceneFileVersion;
+	header.byteOrder = kByteOrder;
+	header.sectionCount = count;
+	
+	SceneFileSection table[count];
+	uint64_t offset = sizeof(header) + sizeof(table);
+	for (uint32_t i = 0; i < count; i++) {
+		offset = (offset + 15) & ~uint64_t(15);
+		table[i].type = contents[i].type;
+		table[i].recordSize = contents[i].recordSize;
+		table[i].count = contents[i].count;
+		table[i].offset = offset;
+		offset += uint64_t(contents[i].count) * contents[i].recordSize;
+	}
+	
+	FILE *f = fopen(path.c_str(), "wb");
+	if (!f) return fail(error, "could not create " + path);
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(table, sizeof(table), 1, f) == 1;
+	uint64_t written = sizeof(header) + sizeof(table);
+	static const char zeros[16] = {};
+	for (uint32_t i = 0; i < count && ok; i++) {
+		size_t pad = size_t(table[i].offset - written);
+		size_t bytes = contents[i].count * contents[i].recordSize;
+		ok = fwrite(zeros, 1, pad, f) == pad && fwrite(contents[i].data, 1, bytes, f) == bytes;
+		written = table[i].offset + bytes;
+	}
+	ok = fclose(f) == 0 && ok;
+	return ok || fail(error, "could not write " + path);
+}
+
+// Shortest form that reads back as the same float, so that 0.4 is written as
+// 0.4 and not 0.400000006
+//
+static std::string num(float v) {
+	char buffer[32];
+	for (int precision = 6; ; precision++) {
+		snprintf(buffer, sizeof(buffer), "%.*g", precision, v);
+		if (precision == 9 || strtof(buffer, nullptr) == v) return buffer;
+	}
+}
+
+//--------------------------------------------------------------
+static bool saveText(Scene &scene, const RenderCam &cam, const std::string &path, std::string *error) {
+	TextureNumbers textureNumbers(scene);
+	FILE *f = fopen(path.c_str(), "w");
+	if (!f) return fail(error, "could not create " + path);
+	
+	CameraRecord c = cameraRecord(cam);
+	fprintf(f, "rtscene %u\n", kSceneFileVersion);
+	fprintf(f, "camera %s %s %s  %s %s %s  %s %s  %s %s  %s",
+		num(c.position[0]).c_str(), num(c.position[1]).c_str(), num(c.position[2]).c_str(),
+		num(c.aim[0]).c_str(), num(c.aim[1]).c_str(), num(c.aim[2]).c_str(),
+		num(c.viewMin[0]).c_str(), num(c.viewMin[1]).c_str(), num(c.viewMax[0]).c_str(), num(c.viewMax[1]).c_str(),
+		num(c.viewZ).c_str());
+	if (cam.up != glm::vec3(0, 1, 0)) fprintf(f, "  up %s %s %s", num(c.up[0]).c_str(), num(c.up[1]).c_str(), num(c.up[2]).c_str());
+	if (cam.aperture > 0) fprintf(f, "  lens %s %s", num(c.aperture).c_str(), num(c.focusDistance).c_str());
+	fprintf(f, "\n");
+	for (size_t i = 0; i < textureNumbers.names.size(); i++) fprintf(f, "texture %s\n", textureNumbers.names[i].c_str());
+	
+	// one object, as a line starting with prefix
+	auto writeObject = [&](SceneObject *o, const char *prefix) {
+		fprintf(f, "%s", prefix);
+		std::string p = num(o->position.x) + " " + num(o->position.y) + " " + num(o->position.z);
+		const Color &d = o->diffuseColor;
+		bool ok = true;
+		if (Sphere *sphere = dynamic_cast<Sphere *>(o)) {
+			fprintf(f, "sphere %s  %s  %d %d %d", p.c_str(), num(sphere->getRadius()).c_str(), d.r, d.g, d.b);
+		}
+		else if (Plane *plane = dynamic_cast<Plane *>(o)) {
+			glm::vec3 n = plane->normal;
+			fprintf(f, "plane %s  %s %s %s  %d %d %d  size %s %s", p.c_str(), num(n.x).c_str(), num(n.y).c_str(), num(n.z).c_str(),
+				d.r, d.g, d.b, num(plane->width).c_str(), num(plane->height).c_str());
+		}
+		else if (Mesh *mesh = dynamic_cast<Mesh *>(o)) {
+			ok = !mesh->getPath().empty() && mesh->getPath().find_first_of(" \t#") == std::string::npos;
+			if (!ok) fail(error, "can't save a mesh without a file name, or with spaces in it");
+			else fprintf(f, "mesh %s  %s  %d %d %d", mesh->getPath().c_str(), p.c_str(), d.r, d.g, d.b);
+		}
+		else ok = fail(error, "can't save an object of unknown kind");
+		if (!ok) return false;
+		
+		const Color &s = o->specularColor;
+		const Color &defaultSpecular = Color::lightGray;
+		if (s.r != defaultSpecular.r || s.g != defaultSpecular.g || s.b != defaultSpecular.b) fprintf(f, "  specular %d %d %d", s.r, s.g, s.b);
+		int texture = textureNumbers(o->texture);
+		if (texture >= 0) fprintf(f, "  texture %d", texture);
+		fprintf(f, "\n");
+		return true;
+	};
+	
+	bool ok = true;
+	for (size_t i = 0; i < scene.objects.size() && ok; i++) ok = writeObject(scene.objects[i], "");
+	for (size_t i = 0; i < scene.lights.size() && ok; i++) {
+		Light *l = scene.lights[i];
+		glm::vec3 p = l->position;
+		const Color &c = l->diffuseColor;
+		fprintf(f, "light %s %s %s  %s %s  %d %d %d", num(p.x).c_str(), num(p.y).c_str(), num(p.z).c_str(),
+			num(l->getRadius()).c_str(), num(l->intensity).c_str(), c.r, c.g, c.b);
+		if (l->range > 0) fprintf(f, "  range %s", num(l->range).c_str());
+		fprintf(f, "\n");
+	}
+	for (size_t i = 0; i < scene.prototypes.size() && ok; i++) ok = writeObject(scene.prototypes[i], "prototype ");
+	for (size_t i = 0; i < scene.instances.size() && ok; i++) {
+		const Instance &instance = scene.instances[i];
+		const Transform &t = instance.transform;
+		const Color &d = instance.diffuseColor;
+		fprintf(f, "instance %u", instance.prototype);
+		for (int row = 0; row < 3; row++) {
+			fprintf(f, "  %s %s %s %s", num(t.x[row]).c_str(), num(t.y[row]).c_str(), num(t.z[row]).c_str(), num(t.t[row]).c_str());
+		}
+		fprintf(f, "  %d %d %d", d.r, d.g, d.b);
+		int texture = textureNumbers(instance.texture);
+		if (texture >= 0) fprintf(f, "  texture %d", texture);
+		fprintf(f, "\n");
+	}
+	
+	if (fclose(f) != 0 && ok) return fail(error, "could not write " + path);
+	return ok;
+}
+
+//--------------------------------------------------------------
+bool saveScene(Scene &scene, const RenderCam &cam, const std::string &path, std::string *error) {
+	if (hasExtension(path, ".txt")) return saveText(scene, cam, path, error);
+	return saveBinary(scene, cam, path, error);
+}
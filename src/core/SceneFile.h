@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "Scene.h"
+#include "MappedFile.h"
+
+//  Scene files: the objects, lights, materials and camera of a scene, with
+//  textures and meshes referred to by file name.
+//
+//  The binary form (.scene) is a header, a table of sections and the sections
+//  themselves: flat arrays of the fixed-size records below, each at a 16 byte
+//  aligned offset.  SceneFile maps the file and hands out pointers straight
+//  into it, so reading a scene is a loop over records with nothing to parse.
+//  Files are written in the byte order of the machine writing them; readers
+//  on the other byte order refuse them.
+//
+//  The version is bumped when a record changes meaning.  New fields go at the
+//  end of a record: each section gives its record size, and readers skip what
+//  they don't know about.
+//
+//  The text form (.txt) holds the same things, one per line, for editing by
+//  hand.  # starts a comment, and file names can't contain spaces:
+//
+//      rtscene 1
+//      camera <position x y z> <aim x y z> <view min x y> <view max x y> <view z> [up <x y z>] [lens <aperture> <focus>]
+//      texture <file>                        numbered from 0 in the order given
+//      sphere <x y z> <radius> <r g b> [options]
+//      plane <x y z> <normal x y z> <r g b> [size <w h>] [options]
+//      mesh <file> <x y z> <r g b> [options]
+//      light <x y z> <radius> <intensity> <r g b> [range <d>]
+//      prototype sphere|plane|mesh ...       as above; numbered from 0 in the order given
+//      instance <prototype> <3 rows of 4> <r g b> [texture <n>]
+//
+//  where the options are "specular <r g b>" and "texture <n>".  The camera's
+//  view is given as for a camera looking down -z (see RenderCam).  An
+//  instance's matrix is the top three rows of its transform (see Instance),
+//  row by row.
+//
+
+static const uint32_t kSceneFileVersion = 1;
+
+enum SceneSection : uint32_t {
+	kSectionCamera = 1,
+	kSectionMaterials,
+	kSectionSpheres,
+	kSectionPlanes,
+	kSectionMeshes,
+	kSectionLights,
+	kSectionTextures,    // offsets of file names in kSectionStrings
+	kSectionStrings,     // NUL terminated names
+	kSectionPrototypes,
+	kSectionInstances,
+};
+
+struct SceneFileHeader {
+	char magic[8];          // "RTSCENE" and a NUL
+	uint32_t version;
+	uint32_t byteOrder;     // 0x01020304 as written
+	uint32_t sectionCount;
+	uint32_t reserved;
+};
+
+struct SceneFileSection {
+	uint32_t type;
+	uint32_t recordSize;
+	uint64_t count;
+	uint64_t offset;    // from the start of the file
+};
+
+struct CameraRecord {
+	float position[3];
+	float aim[3];
+	float viewMin[2];
+	float viewMax[2];
+	float viewZ;
+	float up[3] = { 0, 1, 0 };    // the rest is missing from older files, which get these
+	float aperture = 0;
+	float focusDistance = 0;
+};
+
+struct MaterialRecord {
+	uint8_t diffuse[3];
+	uint8_t specular[3];
+	uint8_t pad[2];
+	int32_t texture;    // index into kSectionTextures, -1 for none
+};
+
+struct SphereRecord {
+	float center[3];
+	float radius;
+	uint32_t material;
+};
+
+struct PlaneRecord {
+	float position[3];
+	float normal[3];
+	float width, height;
+	uint32_t material;
+};
+
+struct MeshRecord {
+	float position[3];
+	uint32_t material;
+	uint32_t path;    // offset into kSectionStrings
+};
+
+struct PrototypeRecord {
+	uint32_t kind;    // kSectionSpheres, kSectionPlanes or kSectionMeshes: which of these is filled in
+	union {
+		SphereRecord sphere;
+		PlaneRecord plane;
+		MeshRecord mesh;
+	};
+};
+
+struct InstanceRecord {
+	float transform[12];    // top three rows of the matrix, row by row
+	uint32_t prototype;     // index into kSectionPrototypes
+	uint32_t material;      // its diffuse color and texture replace the prototype's
+};
+
+struct LightRecord {
+	float position[3];
+	float radius;
+	float intensity;
+	float range;
+	uint8_t color[3];
+	uint8_t pad;
+};
+
+//  A binary scene file, mapped into memory.  The record pointers stay valid
+//  until the file is closed.
+//
+class SceneFile {
+public:
+	bool open(const std::string &path, std::string *error = nullptr);
+	void close() { file.close(); }
+	
+	bool camera(CameraRecord &c) const;    // false if the file has none
+	template<class Record> const Record *records(SceneSection type, size_t &count, size_t &stride) const;
+	const char *string(uint32_t offset) const;    // NULL if offset is outside the strings
+
+private:
+	const SceneFileSection *find(SceneSection type) const;
+	
+	MappedFile file;
+	const SceneFileSection *sections = nullptr;
+	uint32_t sectionCount = 0;
+};
+
+// Both pick the form from the file: save() from the extension, .txt for text
+// and binary otherwise; load() from the first bytes.  Loading replaces the
+// scene's objects and lights and sets the camera if the file has one.
+// Textures are looked up in the scene's TextureStore by name and loaded with
+// Image::load() if they aren't there.
+//
+bool saveScene(Scene &scene, const RenderCam &cam, const std::string &path, std::string *error = nullptr);
+bool loadScene(Scene &scene, RenderCam &cam, const std::string &path, std::string *error = nullptr);
+
+//--------------------------------------------------------------
+template<class Record>
+const Record *SceneFile::records(SceneSection type, size_t &count, size_t &stride) const {
+	const SceneFileSection *s = find(type);
+	if (!s || s->recordSize < sizeof(Record)) {
+		count = 0;
+		stride = sizeof(Record);
+		return nullptr;
+	}
+	count = size_t(s->count);
+	stride = s->recordSize;
+	return reinterpret_cast<const Record *>(file.data() + s->offset);
+}
@@ -0,0 +1,125 @@
+#include "SceneObject.h"
+
+#include <cmath>
+
+// Generic packet intersection: pull each active lane out as a Ray
+//
+SimdFloat SceneObject::intersect(const RayPacket &rays, SimdFloat &tHit) {
+	float t[kSimdWidth], hit[kSimdWidth];
+	tHit.store(t);
+	int active = moveMask(rays.active);
+	for (int i = 0; i < kSimdWidth; i++) {
+		hit[i] = 0;
+		if (!(active & (1 << i))) continue;
+		Ray ray(glm::vec3(rays.ox[i], rays.oy[i], rays.oz[i]), glm::vec3(rays.dx[i], rays.dy[i], rays.dz[i]));
+		glm::vec3 point, normal;
+		if (!intersect(ray, point, normal)) continue;
+		float d = glm::dot(point - ray.p, ray.d);
+		if (d > 0 && d < t[i]) {
+			t[i] = d;
+			hit[i] = 1;
+		}
+	}
+	tHit = SimdFloat::load(t);
+	return SimdFloat::load(hit) > SimdFloat(0.0f);
+}
+
+//--------------------------------------------------------------
+bool SceneObject::occludes(const Ray &ray, float maxDist) {
+	glm::vec3 point, normal;
+	if (!intersect(ray, point, normal)) return false;
+	float t = glm::dot(point - ray.p, ray.d);
+	return t > 0 && t < maxDist;
+}
+
+// Intersect Ray with Plane  (wrapper on glm::intersect*
+//
+bool Plane::intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normalAtIntersect) {
+	float dist;
+	bool hit = glm::intersectRayPlane(ray.p, ray.d, position, this->normal, dist);
+	if (hit) {
+		// Set output variables
+		point = ray.evalPoint(dist);
+		normalAtIntersect = this->normal;
+		// If ray hits plane, determine if intersection is within bounds of the plane
+		glm::vec2 xBounds = glm::vec2(position.x - width * 0.5, position.x + width * 0.5);
+		glm::vec2 zBounds = glm::vec2(position.z - height * 0.5, position.z + height * 0.5);
+		if (point.x < xBounds[1] && point.x > xBounds[0] && point.z < zBounds[1] && point.z > zBounds[0]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// The plane is clipped to width x height in x and z (see intersect()), so only
+// a horizontal plane has finite bounds
+//
+bool Plane::getBounds(AABB &box) {
+	if (glm::abs(normal.y) < 0.999f) return false;
+	glm::vec3 half = glm::vec3(width * 0.5, 0, height * 0.5);
+	box = AABB(position - half, position + half);
+	return true;
+}
+
+// Convert (u, v) to (x, y, z)
+// We assume u,v is in [0, 1]
+//
+glm::vec3 ViewPlane::toWorld(float u, float v) {
+	float w = width();
+	float h = height();
+	return (glm::vec3((u * w) + min.x, (v * h) + min.y, position.z));
+}
+
+// Moves the camera to eye, looking at target.  The view keeps its place
+// relative to the camera.
+//
+void RenderCam::lookAt(const glm::vec3 &eye, const glm::vec3 &target, const glm::vec3 &up) {
+	glm::vec3 move = eye - position;
+	view.setSize(view.min + glm::vec2(move.x, move.y), view.max + glm::vec2(move.x, move.y));
+	view.position += move;
+	position = eye;
+	aim = target - eye;
+	this->up = up;
+}
+
+//--------------------------------------------------------------
+void RenderCam::setFov(float degrees) {
+	float half = viewDistance() * std::tan(glm::radians(degrees) * 0.5f);
+	float aspect = view.getAspect();
+	glm::vec2 center = glm::vec2(position.x, position.y);
+	view.setSize(center - glm::vec2(half * aspect, half), center + glm::vec2(half * aspect, half));
+}
+
+//--------------------------------------------------------------
+float RenderCam::getFov() {
+	return glm::degrees(2 * std::atan(view.height() * 0.5f / viewDistance()));
+}
+
+// forward is aim, and right is square to it and up.  If up is along aim, or
+// either is zero, the nearest axes stand in.
+//
+void RenderCam::getBasis(glm::vec3 &right, glm::vec3 &top, glm::vec3 &forward) const {
+	forward = glm::dot(aim, aim) > 0 ? glm::normalize(aim) : glm::vec3(0, 0, -1);
+	right = glm::cross(forward, up);
+	if (glm::dot(right, right) < 1e-12f) right = glm::cross(forward, std::abs(forward.y) < 0.9f ? glm::vec3(0, 1, 0) : glm::vec3(0, 0, -1));
+	right = glm::normalize(right);
+	top = glm::cross(right, forward);
+}
+
+// The view's (u, v) point, placed relative to the camera as it is for the
+// default camera, then turned with it
+//
+glm::vec3 RenderCam::toWorld(float u, float v) {
+	glm::vec3 right, top, forward;
+	getBasis(right, top, forward);
+	glm::vec3 d = view.toWorld(u, v) - position;
+	return position + right * d.x + top * d.y - forward * d.z;
+}
+
+// Get a ray from the current camera position to the (u, v) position on
+// the ViewPlane
+//
+Ray RenderCam::getRay(float u, float v) {
+	glm::vec3 pointOnPlane = toWorld(u, v);
+	return(Ray(position, glm::normalize(pointOnPlane - position)));
+}
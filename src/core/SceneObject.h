@@ -0,0 +1,244 @@
+//
+//  RayCaster - Set of simple classes to create a camera/view setup for our Ray Tracer HW Project
+//
+//  I've included these classes as a mini-framework for our introductory ray tracer.
+//  You are free to modify/change.
+//
+//  These classes provide a simple render camera which can can return a ray starting from
+//  it's position to a (u, v) coordinate on the view plane.
+//
+//  The view plane is where we can locate our photorealistic image we are rendering.
+//  The field-of-view of the camera by moving it closer/further
+//  from the view plane.  The viewplane can be also resized.  When ray tracing an image, the aspect
+//  ratio of the view plane should the be same as your image. So for example, the current view plane
+//  default size is ( 6.0 width by 4.0 height ).   A 1200x800 pixel image would have the same
+//  aspect ratio.
+//
+//  This is not a complete ray tracer - just a set of skelton classes to start.  The current
+//  base scene object only stores a value for the diffuse/specular color of the object (defaut is gray).
+//  at some point, we will want to replace this with a Material class that contains these (and other
+//  parameters)
+//
+//  These classes have no openFrameworks dependency so that they can be used by the
+//  headless renderer.  Drawing them in the viewport is done by ofApp.
+//
+//  (c) Kevin M. Smith  - 24 September 2018
+//
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include "VecMath.h"
+#include "Ray.h"
+#include "Color.h"
+#include "Texture.h"
+#include "AABB.h"
+#include "PacketIntersect.h"
+
+//  Refers to an object or light in a Scene.  Unlike a pointer, a handle can
+//  be kept after its object is removed: Scene::get() then returns NULL, even
+//  once the slot has been reused, because every reuse bumps the slot's
+//  generation.
+//
+struct ObjectHandle {
+	uint32_t index = 0xffffffffu;    // slot in the scene's table
+	uint32_t generation = 0;
+	
+	bool valid() const { return index != 0xffffffffu; }
+	bool operator==(const ObjectHandle &h) const { return index == h.index && generation == h.generation; }
+	bool operator!=(const ObjectHandle &h) const { return !(*this == h); }
+};
+
+//  Base class for any renderable object in the scene
+//
+class SceneObject {
+public:
+	virtual ~SceneObject() {}
+	virtual bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) {
+		std::cout << "SceneObject::intersect" << std::endl;
+		return false;
+		
+	}
+	// Packet version, see PacketIntersect.h.  The default tests the lanes one
+	// at a time with intersect() above.
+	virtual SimdFloat intersect(const RayPacket &rays, SimdFloat &tHit);
+	// Shadow query: true if the object blocks the ray before maxDist.  The
+	// default finds the closest hit with intersect(); objects with a cheaper
+	// any-hit test override it.
+	virtual bool occludes(const Ray &ray, float maxDist);
+	virtual float getIntensity() {
+		std::cout << "No intensity attribute" << std::endl;
+		return -1;
+	}
+	virtual void setIntensity(float r) {
+		std::cout << "No intensity attribute" << std::endl;
+	}
+	virtual float getRadius() {
+		std::cout << "No radius attribute" << std::endl;
+		return -1;
+	}
+	virtual void setRadius(float r) {
+		std::cout << "No radius attribute" << std::endl;
+	}
+	// World space bounds, for the acceleration structure.  Objects that can't
+	// be bounded return false and are tested against every ray.
+	virtual bool getBounds(AABB &box) {
+		return false;
+	}
+	// any data common to all scene objects goes here
+	glm::vec3 position = glm::vec3(0, 0, 0);
+	float intensity = 1;
+	int ordinality;         // index in Scene::objects (or Scene::lights); changes when others are removed
+	ObjectHandle handle;    // set by the Scene when the object is added
+	
+	// material properties (we will ultimately replace this with a Material class - TBD)
+	Color diffuseColor = Color::grey;    // default colors - can be changed.
+	Color specularColor = Color::lightGray;
+	TextureHandle texture;    // replaces the diffuse color when valid
+};
+
+//  General purpose sphere  (assume parametric)
+//
+class Sphere: public SceneObject {
+public:
+	Sphere() {}
+	Sphere(glm::vec3 p, float r, Color d, int o) {
+		position = p; radius = r; diffuseColor = d; ordinality = o;
+	}
+	bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) {
+		return (glm::intersectRaySphere(ray.p, ray.d, position, radius, point, normal));
+	}
+	SimdFloat intersect(const RayPacket &rays, SimdFloat &tHit) {
+		return intersectSphere(rays, position, radius, tHit);
+	}
+	bool getBounds(AABB &box) {
+		box = AABB(position - glm::vec3(radius), position + glm::vec3(radius));
+		return true;
+	}
+	float getRadius() {
+		return radius;
+	}
+	void setRadius(float r) {
+		radius = r;
+	}
+private:
+	float radius = 1.0;
+};
+
+//  Point light.  Drawn and picked as a small sphere; the radius comes from Sphere
+//  and the intensity from SceneObject.
+//
+class Light: public Sphere {
+public:
+	Light(glm::vec3 p, float r, float i, Color d, int o) : Sphere(p, r, d, o) {
+		intensity = i;
+	}
+	float getIntensity() {
+		return intensity;
+	}
+	void setIntensity(float i) {
+		intensity = i;
+	};
+	
+	float range = 0;    // lights nothing farther away than this; 0 = no limit
+};
+
+//  General purpose plane
+//
+class Plane: public SceneObject {
+public:
+	Plane(glm::vec3 p, glm::vec3 n, Color diffuse = Color::dimGrey, float w = 20, float h = 20 ) {
+		position = p;
+		normal = n;
+		width = w;
+		height = h;
+		diffuseColor = diffuse;
+	}
+	Plane() { }
+	glm::vec3 normal = glm::vec3(0, 1, 0);
+	bool intersect(const Ray &ray, glm::vec3 & point, glm::vec3 & normal);
+	SimdFloat intersect(const RayPacket &rays, SimdFloat &tHit) {
+		return intersectPlane(rays, position, normal, width * 0.5f, height * 0.5f, tHit);
+	}
+	bool getBounds(AABB &box);
+	float width = 20;
+	float height = 20;
+};
+
+// view plane for render camera
+//
+class ViewPlane: public Plane {
+public:
+	ViewPlane(glm::vec2 p0, glm::vec2 p1) { min = p0; max = p1; }
+	
+	ViewPlane() {                         // create reasonable defaults (6x4 aspect)
+		min = glm::vec2(-3, -2);
+		max = glm::vec2(3, 2);
+		position = glm::vec3(0, 0, 5);
+		normal = glm::vec3(0, 0, 1);      // viewplane currently limited to Z axis orientation
+	}
+	
+	void setSize(glm::vec2 min, glm::vec2 max) { this->min = min; this->max = max; }
+	float getAspect() { return width() / height(); }
+	
+	glm::vec3 toWorld(float u, float v);   //   (u, v) --> (x, y, z) [ world space ]
+	
+	float width() {
+		return (max.x - min.x);
+	}
+	float height() {
+		return (max.y - min.y);
+	}
+	
+	// some convenience methods for returning the corners
+	//
+	glm::vec2 topLeft() { return glm::vec2(min.x, max.y); }
+	glm::vec2 topRight() { return max; }
+	glm::vec2 bottomLeft() { return min; }
+	glm::vec2 bottomRight() { return glm::vec2(max.x, min.y); }
+	
+	//  To define an infinite plane, we just need a point and normal.
+	//  The ViewPlane is a finite plane so we need to define the boundaries.
+	//  We will define this in terms of min, max  in 2D.
+	//  (in local 2D space of the plane)
+	//  ultimately, will want to locate the ViewPlane with RenderCam anywhere
+	//  in the scene, so it is easier to define the View rectangle in a local'
+	//  coordinate system.
+	//
+	glm::vec2 min, max;
+};
+
+
+//  render camera: looks along aim, with up towards the top of the image.
+//
+//  The view is given as it would be for a camera looking down -z with y up
+//  (the default): a rectangle in world x and y at z = view.position.z, with
+//  the camera in front of it.  The camera turns that picture about its
+//  position to look along aim.  So scenes saved before cameras could turn
+//  see the same thing.
+//
+//  With an aperture, the camera is a thin lens of that radius rather than a
+//  pinhole: rays start across the lens and meet again focusDistance along
+//  aim, so things nearer or further away are blurred.  Renderer traces those
+//  rays (see CameraRays.h); getRay() is the ray through the lens center.
+//
+class RenderCam: public SceneObject {
+public:
+	RenderCam() {
+		position = glm::vec3(0, 0, 10);
+		aim = glm::vec3(0, 0, -1);
+		up = glm::vec3(0, 1, 0);
+	}
+	void lookAt(const glm::vec3 &eye, const glm::vec3 &target, const glm::vec3 &up = glm::vec3(0, 1, 0));    // the view moves with the camera
+	void setFov(float degrees);    // vertical, keeping the view's distance and aspect, centered on aim
+	float getFov();
+	float viewDistance() const { return position.z - view.position.z; }
+	void getBasis(glm::vec3 &right, glm::vec3 &top, glm::vec3 &forward) const;    // unit vectors; top is up made square to aim
+	glm::vec3 toWorld(float u, float v);    // (u, v) on the view, turned to face along aim
+	Ray getRay(float u, float v);
+	glm::vec3 aim;
+	glm::vec3 up;
+	ViewPlane view;          // The camera viewplane, this is the view that we will render
+	float aperture = 0;         // lens radius; 0 = a pinhole, with everything sharp
+	float focusDistance = 0;    // along aim, to what is sharpest; 0 = the view's distance
+};
@@ -0,0 +1,108 @@
+#include "SequenceRenderer.h"
+
+#include <chrono>
+#include <thread>
+
+static bool fail(std::string *error, const std::string &message) {
+	if (error) *error = message;
+	return false;
+}
+
+static double now() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//--------------------------------------------------------------
+std::string SequenceRenderer::framePath(const std::string &pattern, int frame) {
+	std::string path = pattern;
+	size_t last = path.rfind('#');
+	if (last == std::string::npos) {
+		size_t dot = path.rfind('.'), slash = path.find_last_of("/\\");
+		size_t at = dot != std::string::npos && (slash == std::string::npos || dot > slash) ? dot : path.size();
+		path.insert(at, "_####");
+		last = at + 4;
+	}
+	size_t first = last;
+	while (first > 0 && path[first - 1] == '#') first--;
+	size_t width = last - first + 1;
+	std::string number = std::to_string(frame);
+	if (number.size() < width) number.insert(0, width - number.size(), '0');
+	return path.replace(first, width, number);
+}
+
+// Each pass of the loop traces frame f with the renderer's snapshot while
+// setup() gets the other one ready for f + 1, then swaps them.  The second
+// snapshot starts as a copy of the first, made during the first trace.
+//
+//--------------------------------------------------------------
+bool SequenceRenderer::render(const std::string &pattern, std::string *error) {
+	Scene &scene = renderer.scene;
+	int first = firstFrame, last = lastFrame < 0 ? animation.frames - 1 : lastFrame;
+	if (first < 0 || first > last) return fail(error, "no frames to render");
+	if (!animation.check(scene, error)) return false;
+	bool overlap = !animation.movesShared(scene);
+	traceSeconds = waitSeconds = 0;
+	
+	// every frame's camera is set from this one, not from the frame before,
+	// so that rounding doesn't build up along the sequence
+	const RenderCam cam = renderer.renderCam;
+	animation.apply(scene, renderer.renderCam, float(first));
+	renderer.prepare();
+	rebuilds = 1;
+	
+	RenderScene nextScene;
+	CameraRays nextRays;
+	RenderCam nextCam;
+	bool copied = false;
+	FrameBuffer frames[2];
+	Image image;
+	std::string unwritten;    // a file that could not be written
+	double samples = 0;
+	
+	auto write = [&](const FrameBuffer &frame, int f) {
+		std::string path = framePath(pattern, f);
+		renderer.toneMap.apply(frame, image);
+		if (!image.save(path)) unwritten = path;
+	};
+	
+	for (int f = first; f <= last; f++) {
+		auto setup = [&]() {
+			if (f > first) write(frames[(f - 1) & 1], f - 1);
+			if (f == last) return;
+			if (!copied) {
+				nextScene = renderer.renderScene;
+				copied = true;
+			}
+			nextCam = cam;
+			animation.apply(scene, nextCam, float(f + 1));
+			if (!nextScene.refit(scene)) rebuilds++;
+			nextRays.setup(nextCam);
+		};
+		
+		double start = now();
+		std::thread helper;
+		if (overlap) helper = std::thread(setup);
+		renderer.renderPrepared(frames[f & 1]);
+		double traced = now();
+		if (overlap) helper.join();
+		else setup();
+		traceSeconds += traced - start;
+		waitSeconds += now() - traced;
+		samples += renderer.samplesPerPixel;
+		if (!unwritten.empty()) return fail(error, "could not write " + unwritten);
+		
+		if (f < last) {
+			std::swap(renderer.renderScene, nextScene);
+			renderer.cameraRays = nextRays;
+			renderer.renderCam = nextCam;
+		}
+	}
+	double start = now();
+	write(frames[last & 1], last);
+	waitSeconds += now() - start;
+	if (!unwritten.empty()) return fail(error, "could not write " + unwritten);
+	
+	renderer.samplesPerPixel = float(samples / (last - first + 1));
+	if (scene.hasAccel()) scene.refitAccel();
+	return true;
+}
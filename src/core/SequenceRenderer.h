@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include "Renderer.h"
+#include "Animation.h"
+
+//  Renders the frames of an Animation to numbered image files.
+//
+//  The renderer's snapshot is built for the first frame and refitted for
+//  the others (see RenderScene::refit()); textures, the thread pool and the
+//  buffers stay from one frame to the next.  Two snapshots and two frame
+//  buffers take turns: while the renderer's threads trace frame k, one more
+//  thread applies the animation for frame k + 1 to the scene, refits the
+//  other snapshot to it, and tone maps and writes frame k - 1.  Between
+//  frames there is only a swap, and whatever of that work is left, so a
+//  frame costs little more than its tracing.
+//
+//  An animation that moves objects the snapshot refers to rather than
+//  copies (see Animation::movesShared()) can't touch the scene while a frame
+//  is traced, so each of its frames is set up after the last is traced.
+//
+//  framePath() names the files: the last run of # in the pattern becomes the
+//  frame number, padded with zeros to its length.  A pattern without one
+//  gets "_####" before its extension.
+//
+class SequenceRenderer {
+public:
+	SequenceRenderer(Renderer &renderer, const Animation &animation) : renderer(renderer), animation(animation) {}
+	
+	bool render(const std::string &pattern, std::string *error = nullptr);
+	static std::string framePath(const std::string &pattern, int frame);
+	
+	int firstFrame = 0;
+	int lastFrame = -1;    // -1 = the animation's last
+	
+	// of the last render
+	int rebuilds = 0;           // frames whose snapshot was built rather than refitted, the first among them
+	double traceSeconds = 0;    // spent tracing
+	double waitSeconds = 0;     // spent between frames, on setup and output tracing didn't hide
+	
+private:
+	Renderer &renderer;
+	const Animation &animation;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "VecMath.h"
+
+//  Material models, the innermost part of Renderer's shading kernels.
+//
+//  A model is a struct whose static light() gives what one light adds at a
+//  point, before shadowing.  Renderer instantiates a kernel for each model,
+//  textured or untextured, and point or sampled lights, and picks one per
+//  run of hits with the same material, so nothing in the light loop is
+//  decided at run time and the model inlines into it.  A new model is a new
+//  struct here and a case in Renderer::kernels(); the kernels of the others
+//  don't change.
+//
+//  n is the unit normal at p and v the unit vector to the eye.
+//
+struct BlinnPhong {
+	static inline glm::vec3 light(const glm::vec3 &lightPos, float intensity, const glm::vec3 &p, const glm::vec3 &n, const glm::vec3 &v,
+		const glm::vec3 &diffuse, const glm::vec3 &specular, float power) {
+		glm::vec3 l = glm::normalize(lightPos - p);
+		glm::vec3 h = glm::normalize(v + l);
+		glm::vec3 contribution = diffuse * intensity * glm::max(0.0f, glm::dot(n, l)); // lambert shading
+		contribution += specular * intensity * glm::pow(glm::max(0.0f, glm::dot(n, h)), power); // blinn-phong
+		return contribution;
+	}
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+//  Thin wrapper over the widest float vector the target supports.
+//
+//  kSimdWidth lanes: 8 with AVX/AVX2, 4 with SSE2, and a plain 4-wide array
+//  otherwise (e.g. ARM builds), which the compiler is free to vectorize itself.
+//  Comparisons return masks in the same type, with every bit of a lane set
+//  where the comparison holds, as the intrinsics do.
+//
+//  Which path is compiled depends on the compiler flags (-mavx2, -march=native);
+//  define RT_NO_SIMD to force the portable fallback.
+//
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX__) && !defined(RT_NO_SIMD)
+#include <immintrin.h>
+#define RT_SIMD_AVX 1
+static const int kSimdWidth = 8;
+#elif (defined(__SSE2__) || defined(_M_X64)) && !defined(RT_NO_SIMD)
+#include <emmintrin.h>
+#define RT_SIMD_SSE 1
+static const int kSimdWidth = 4;
+#else
+#define RT_SIMD_SCALAR 1
+static const int kSimdWidth = 4;
+#endif
+
+class SimdFloat {
+public:
+	SimdFloat() {}
+	
+#if RT_SIMD_AVX
+	SimdFloat(float s) : v(_mm256_set1_ps(s)) {}
+	SimdFloat(__m256 v) : v(v) {}
+	static SimdFloat load(const float *p) { return _mm256_loadu_ps(p); }
+	void store(float *p) const { _mm256_storeu_ps(p, v); }
+	
+	friend SimdFloat operator+(SimdFloat a, SimdFloat b) { return _mm256_add_ps(a.v, b.v); }
+	friend SimdFloat operator-(SimdFloat a, SimdFloat b) { return _mm256_sub_ps(a.v, b.v); }
+	friend SimdFloat operator*(SimdFloat a, SimdFloat b) { return _mm256_mul_ps(a.v, b.v); }
+	friend SimdFloat operator/(SimdFloat a, SimdFloat b) { return _mm256_div_ps(a.v, b.v); }
+	friend SimdFloat operator<(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+	friend SimdFloat operator<=(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+	friend SimdFloat operator>(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+	friend SimdFloat operator>=(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+	friend SimdFloat operator&(SimdFloat a, SimdFloat b) { return _mm256_and_ps(a.v, b.v); }
+	friend SimdFloat operator|(SimdFloat a, SimdFloat b) { return _mm256_or_ps(a.v, b.v); }
+	friend SimdFloat andNot(SimdFloat mask, SimdFloat a) { return _mm256_andnot_ps(mask.v, a.v); }
+	friend SimdFloat min(SimdFloat a, SimdFloat b) { return _mm256_min_ps(a.v, b.v); }
+	friend SimdFloat max(SimdFloat a, SimdFloat b) { return _mm256_max_ps(a.v, b.v); }
+	friend SimdFloat sqrt(SimdFloat a) { return _mm256_sqrt_ps(a.v); }
+	friend SimdFloat abs(SimdFloat a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+	friend SimdFloat select(SimdFloat mask, SimdFloat a, SimdFloat b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+	friend int moveMask(SimdFloat mask) { return _mm256_movemask_ps(mask.v); }
+	
+	__m256 v;
+#elif RT_SIMD_SSE
+	SimdFloat(float s) : v(_mm_set1_ps(s)) {}
+	SimdFloat(__m128 v) : v(v) {}
+	static SimdFloat load(const float *p) { return _mm_loadu_ps(p); }
+	void store(float *p) const { _mm_storeu_ps(p, v); }
+	
+	friend SimdFloat operator+(SimdFloat a, SimdFloat b) { return _mm_add_ps(a.v, b.v); }
+	friend SimdFloat operator-(SimdFloat a, SimdFloat b) { return _mm_sub_ps(a.v, b.v); }
+	friend SimdFloat operator*(SimdFloat a, SimdFloat b) { return _mm_mul_ps(a.v, b.v); }
+	friend SimdFloat operator/(SimdFloat a, SimdFloat b) { return _mm_div_ps(a.v, b.v); }
+	friend SimdFloat operator<(SimdFloat a, SimdFloat b) { return _mm_cmplt_ps(a.v, b.v); }
+	friend SimdFloat operator<=(SimdFloat a, SimdFloat b) { return _mm_cmple_ps(a.v, b.v); }
+	friend SimdFloat operator>(SimdFloat a, SimdFloat b) { return _mm_cmpgt_ps(a.v, b.v); }
+	friend SimdFloat operator>=(SimdFloat a, SimdFloat b) { return _mm_cmpge_ps(a.v, b.v); }
+	friend SimdFloat operator&(SimdFloat a, SimdFloat b) { return _mm_and_ps(a.v, b.v); }
+	friend SimdFloat operator|(SimdFloat a, SimdFloat b) { return _mm_or_ps(a.v, b.v); }
+	friend SimdFloat andNot(SimdFloat mask, SimdFloat a) { return _mm_andnot_ps(mask.v, a.v); }
+	friend SimdFloat min(SimdFloat a, SimdFloat b) { return _mm_min_ps(a.v, b.v); }
+	friend SimdFloat max(SimdFloat a, SimdFloat b) { return _mm_max_ps(a.v, b.v); }
+	friend SimdFloat sqrt(SimdFloat a) { return _mm_sqrt_ps(a.v); }
+	friend SimdFloat abs(SimdFloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+	friend SimdFloat select(SimdFloat mask, SimdFloat a, SimdFloat b) {
+		return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+	}
+	friend int moveMask(SimdFloat mask) { return _mm_movemask_ps(mask.v); }
+	
+	__m128 v;
+#else
+	SimdFloat(float s) { for (int i = 0; i < kSimdWidth; i++) v[i] = s; }
+	static SimdFloat load(const float *p) { SimdFloat r; for (int i = 0; i < kSimdWidth; i++) r.v[i] = p[i]; return r; }
+	void store(float *p) const { for (int i = 0; i < kSimdWidth; i++) p[i] = v[i]; }
+	
+#define RT_SIMD_OP(op) \
+	friend SimdFloat operator op(SimdFloat a, SimdFloat b) { SimdFloat r; for (int i = 0; i < kSimdWidth; i++) r.v[i] = a.v[i] op b.v[i]; return r; }
+	RT_SIMD_OP(+) RT_SIMD_OP(-) RT_SIMD_OP(*) RT_SIMD_OP(/)
+#undef RT_SIMD_OP
+#define RT_SIMD_CMP(op) \
+	friend SimdFloat operator op(SimdFloat a, SimdFloat b) { SimdFloat r; for (int i = 0; i < kSimdWidth; i++) r.v[i] = lane(a.v[i] op b.v[i]); return r; }
+	RT_SIMD_CMP(<) RT_SIMD_CMP(<=) RT_SIMD_CMP(>) RT_SIMD_CMP(>=)
+#undef RT_SIMD_CMP
+	friend SimdFloat operator&(SimdFloat a, SimdFloat b) { return bitwise(a, b, [](uint32_t x, uint32_t y) { return x & y; }); }
+	friend SimdFloat operator|(SimdFloat a, SimdFloat b) { return bitwise(a, b, [](uint32_t x, uint32_t y) { return x | y; }); }
+	friend SimdFloat andNot(SimdFloat mask, SimdFloat a) { return bitwise(mask, a, [](uint32_t x, uint32_t y) { return ~x & y; }); }
+	friend SimdFloat min(SimdFloat a, SimdFloat b) { SimdFloat r; for (int i = 0; i < kSimdWidth; i++) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return r; }
+	friend SimdFloat max(SimdFloat a, SimdFloat b) { SimdFloat r; for (int i = 0; i < kSimdWidth; i++) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return r; }
+	friend SimdFloat sqrt(SimdFloat a) { SimdFloat r; for (int i = 0; i < kSimdWidth; i++) r.v[i] = std::sqrt(a.v[i]); return r; }
+	friend SimdFloat abs(SimdFloat a) { SimdFloat r; for (int i = 0; i < kSimdWidth; i++) r.v[i] = std::fabs(a.v[i]); return r; }
+	friend SimdFloat select(SimdFloat mask, SimdFloat a, SimdFloat b) { return (mask & a) | andNot(mask, b); }
+	friend int moveMask(SimdFloat mask) {
+		int m = 0;
+		for (int i = 0; i < kSimdWidth; i++) m |= int(bits(mask.v[i]) >> 31) << i;
+		return m;
+	}
+	
+	float v[kSimdWidth];
+	
+private:
+	static uint32_t bits(float f) { uint32_t u; memcpy(&u, &f, 4); return u; }
+	static float lane(bool b) { uint32_t u = b ? 0xffffffffu : 0; float f; memcpy(&f, &u, 4); return f; }
+	template<class Op>
+	static SimdFloat bitwise(SimdFloat a, SimdFloat b, Op op) {
+		SimdFloat r;
+		for (int i = 0; i < kSimdWidth; i++) {
+			uint32_t u = op(bits(a.v[i]), bits(b.v[i]));
+			memcpy(&r.v[i], &u, 4);
+		}
+		return r;
+	}
+#endif
+	
+public:
+	float operator[](int i) const { float lanes[kSimdWidth]; store(lanes); return lanes[i]; }
+	
+	// all lanes set for the lowest n lanes, clear for the rest
+	static SimdFloat firstLanes(int n) {
+		float lanes[kSimdWidth];
+		for (int i = 0; i < kSimdWidth; i++) {
+			uint32_t u = i < n ? 0xffffffffu : 0;
+			memcpy(&lanes[i], &u, 4);
+		}
+		return load(lanes);
+	}
+};
@@ -0,0 +1,109 @@
+#include "Texture.h"
+#include "Fingerprint.h"
+
+#include <cmath>
+#include <algorithm>
+
+//--------------------------------------------------------------
+Texture::Texture(const Image &image) {
+	Level base;
+	base.width = std::max(1, image.getWidth());
+	base.height = std::max(1, image.getHeight());
+	base.texels.assign(size_t(base.width) * base.height, glm::vec4(0));
+	if (image.isAllocated()) {
+		for (int y = 0; y < base.height; y++) {
+			for (int x = 0; x < base.width; x++) {
+				Color c = image.getColor(x, y);
+				base.texels[size_t(y) * base.width + x] = glm::vec4(c.r, c.g, c.b, 255) / 255.0f;
+			}
+		}
+	}
+	Fingerprint f;
+	f.add(base.width); f.add(base.height);
+	f.addArray(base.texels, base.texels.size());
+	hash = f.hash;
+	levels.push_back(std::move(base));
+	
+	// Each level averages 2x2 blocks of the one above.  When a size is odd the
+	// last block also takes in the leftover row or column.
+	while (levels.back().width > 1 || levels.back().height > 1) {
+		const Level &src = levels.back();
+		Level dst;
+		dst.width = std::max(1, src.width / 2);
+		dst.height = std::max(1, src.height / 2);
+		dst.texels.resize(size_t(dst.width) * dst.height);
+		for (int y = 0; y < dst.height; y++) {
+			int y0 = 2 * y, y1 = y == dst.height - 1 ? src.height : std::min(2 * y + 2, src.height);
+			for (int x = 0; x < dst.width; x++) {
+				int x0 = 2 * x, x1 = x == dst.width - 1 ? src.width : std::min(2 * x + 2, src.width);
+				glm::vec4 sum(0);
+				for (int sy = y0; sy < y1; sy++) {
+					for (int sx = x0; sx < x1; sx++) sum += src.texels[size_t(sy) * src.width + sx];
+				}
+				dst.texels[size_t(y) * dst.width + x] = sum / float((x1 - x0) * (y1 - y0));
+			}
+		}
+		levels.push_back(std::move(dst));
+	}
+}
+
+// Wraps a texel coordinate into [0, n)
+//
+static inline int wrap(int i, int n) {
+	i %= n;
+	return i < 0 ? i + n : i;
+}
+
+// Blend of the four texels around (u, v).  Texel centers sit at
+// ((x + 0.5) / width, (y + 0.5) / height), and row 0 is at v = 0.
+//
+glm::vec3 Texture::bilinear(int level, float u, float v) const {
+	const Level &l = levels[level];
+	float x = u * l.width - 0.5f;
+	float y = v * l.height - 0.5f;
+	float fx = std::floor(x), fy = std::floor(y);
+	float tx = x - fx, ty = y - fy;
+	int x0 = wrap(int(fx), l.width), x1 = wrap(int(fx) + 1, l.width);
+	int y0 = wrap(int(fy), l.height), y1 = wrap(int(fy) + 1, l.height);
+	
+	const glm::vec4 *row0 = &l.texels[size_t(y0) * l.width];
+	const glm::vec4 *row1 = &l.texels[size_t(y1) * l.width];
+	glm::vec4 top = row0[x0] + (row0[x1] - row0[x0]) * tx;
+	glm::vec4 bottom = row1[x0] + (row1[x1] - row1[x0]) * tx;
+	return glm::vec3(top + (bottom - top) * ty);
+}
+
+// Chooses the level whose texels are about the size of the footprint, and
+// blends the two levels either side of it.
+//
+glm::vec3 Texture::sample(float u, float v, float du, float dv) const {
+	// keep huge coordinates from overflowing the texel index math
+	u -= std::floor(u);
+	v -= std::floor(v);
+	
+	float texels = std::max(std::fabs(du) * getWidth(), std::fabs(dv) * getHeight());
+	float lod = texels > 1 ? std::log2(texels) : 0;
+	int last = levelCount() - 1;
+	if (lod >= last) return bilinear(last, u, v);
+	
+	int level = int(lod);
+	float t = lod - level;
+	glm::vec3 fine = bilinear(level, u, v);
+	if (t == 0) return fine;
+	return fine + (bilinear(level + 1, u, v) - fine) * t;
+}
+
+//--------------------------------------------------------------
+TextureHandle TextureStore::add(const Image &image, const std::string &name) {
+	textures.push_back(Texture(image));
+	names.push_back(name);
+	return handle(int(textures.size()) - 1);
+}
+
+//--------------------------------------------------------------
+TextureHandle TextureStore::find(const std::string &name) const {
+	for (size_t i = 0; i < names.size(); i++) {
+		if (names[i] == name) return handle(int(i));
+	}
+	return TextureHandle();
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "VecMath.h"
+#include "Color.h"
+#include "Image.h"
+
+//  Reference to a texture in a TextureStore.  Objects and materials hold one
+//  of these; the default refers to no texture.
+//
+struct TextureHandle {
+	int index = -1;
+	
+	bool valid() const { return index >= 0; }
+	bool operator==(const TextureHandle &h) const { return index == h.index; }
+	bool operator!=(const TextureHandle &h) const { return index != h.index; }
+};
+
+//  A texture prepared for rendering: texels converted once to float RGB in
+//  [0, 1], and a full chain of mip-map levels, each half the size of the one
+//  before, down to 1x1.
+//
+//  Texels are stored row by row with a spare fourth channel, so a bilinear
+//  lookup reads two 16-byte texels from each of two rows.  Texture
+//  coordinates repeat outside [0, 1].
+//
+class Texture {
+public:
+	explicit Texture(const Image &image);
+	
+	int getWidth() const { return levels[0].width; }
+	int getHeight() const { return levels[0].height; }
+	int levelCount() const { return int(levels.size()); }
+	uint64_t contentHash() const { return hash; }    // of the texels, for Renderer::fingerprint()
+	
+	// Trilinear lookup.  du and dv are the size of the area being shaded in
+	// texture coordinates (one pixel, say); they pick the mip-map level.
+	//
+	glm::vec3 sample(float u, float v, float du, float dv) const;
+	glm::vec3 bilinear(int level, float u, float v) const;
+	
+private:
+	struct Level {
+		int width, height;
+		std::vector<glm::vec4> texels;
+	};
+	
+	std::vector<Level> levels;
+	uint64_t hash;
+};
+
+//  All the textures of a scene, each held once and referred to by handle
+//
+class TextureStore {
+public:
+	// name identifies the texture in saved scenes, normally the file it came
+	// from (see SceneFile.h)
+	TextureHandle add(const Image &image, const std::string &name = "");
+	void clear() { textures.clear(); names.clear(); }
+	
+	bool contains(TextureHandle h) const { return h.index >= 0 && h.index < int(textures.size()); }
+	const Texture &get(TextureHandle h) const { return textures[h.index]; }
+	size_t size() const { return textures.size(); }
+	
+	// handle of the i'th texture added
+	TextureHandle handle(int i) const { TextureHandle h; h.index = i; return h; }
+	
+	const std::string &name(TextureHandle h) const { return names[h.index]; }
+	TextureHandle find(const std::string &name) const;    // invalid handle if there is none by that name
+	
+private:
+	std::vector<Texture> textures;
+	std::vector<std::string> names;
+};
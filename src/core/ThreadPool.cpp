@@ -0,0 +1,120 @@
+#include "ThreadPool.h"
+
+//--------------------------------------------------------------
+int ThreadPool::hardwareThreads() {
+	unsigned n = std::thread::hardware_concurrency();
+	return n > 0 ? int(n) : 1;
+}
+
+//--------------------------------------------------------------
+ThreadPool::ThreadPool(int numThreads) : remaining(0) {
+	if (numThreads <= 0) numThreads = hardwareThreads();
+	for (int i = 0; i < numThreads; i++) {
+		queues.push_back(std::unique_ptr<Queue>(new Queue()));
+	}
+	// thread 0 is whoever calls parallelFor()
+	for (int i = 1; i < numThreads; i++) {
+		threads.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+	}
+}
+
+//--------------------------------------------------------------
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> guard(batchLock);
+		quit = true;
+	}
+	batchStarted.notify_all();
+	for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+}
+
+//--------------------------------------------------------------
+void ThreadPool::parallelFor(int count, const std::function<void(int, int)> &task) {
+	if (count <= 0) return;
+	if (size() == 1) {
+		for (int i = 0; i < count; i++) task(i, 0);
+		return;
+	}
+	
+	{
+		std::lock_guard<std::mutex> guard(batchLock);
+		this->task = &task;
+		remaining = count;
+	}
+	
+	// Hand each thread a contiguous run of indices before anyone starts, so
+	// that every index is queued by the time a thread finds the queues empty.
+	// A thread still leaving the previous batch may pick these up early, which
+	// is fine now that task is set.
+	int n = size();
+	for (int t = 0; t < n; t++) {
+		std::lock_guard<std::mutex> guard(queues[t]->lock);
+		for (int i = int(long(count) * t / n); i < int(long(count) * (t + 1) / n); i++) {
+			queues[t]->indices.push_back(i);
+		}
+	}
+	{
+		std::lock_guard<std::mutex> guard(batchLock);
+		batch++;
+	}
+	batchStarted.notify_all();
+	
+	runTasks(0);
+	
+	std::unique_lock<std::mutex> guard(batchLock);
+	batchFinished.wait(guard, [this] { return remaining == 0; });
+	this->task = nullptr;
+}
+
+// Takes the next index from the front of this thread's own queue
+//
+bool ThreadPool::pop(int thread, int &index) {
+	Queue &q = *queues[thread];
+	std::lock_guard<std::mutex> guard(q.lock);
+	if (q.indices.empty()) return false;
+	index = q.indices.front();
+	q.indices.pop_front();
+	return true;
+}
+
+// Takes an index from the back of another thread's queue, trying the threads
+// after this one in turn so that thieves spread out over the victims
+//
+bool ThreadPool::steal(int thread, int &index) {
+	int n = size();
+	for (int k = 1; k < n; k++) {
+		Queue &q = *queues[(thread + k) % n];
+		std::lock_guard<std::mutex> guard(q.lock);
+		if (q.indices.empty()) continue;
+		index = q.indices.back();
+		q.indices.pop_back();
+		return true;
+	}
+	return false;
+}
+
+//--------------------------------------------------------------
+void ThreadPool::runTasks(int thread) {
+	int index;
+	while (pop(thread, index) || steal(thread, index)) {
+		(*task)(index, thread);
+		if (--remaining == 0) {
+			std::lock_guard<std::mutex> guard(batchLock);
+			batchFinished.notify_all();
+		}
+	}
+}
+
+//--------------------------------------------------------------
+void ThreadPool::workerLoop(int thread) {
+	unsigned seen = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> guard(batchLock);
+			batchStarted.wait(guard, [&] { return quit || batch != seen; });
+			if (quit) return;
+			seen = batch;
+		}
+		runTasks(thread);
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//  Fixed set of worker threads that run batches of independent tasks.
+//
+//  Each thread has its own queue.  A batch is split into contiguous runs of
+//  indices, one run per queue, so neighbouring tasks (e.g. neighbouring tiles)
+//  tend to run on the same thread.  A thread that empties its own queue steals
+//  from the back of another thread's queue, which keeps every core busy when
+//  some tasks are much more expensive than others.
+//
+class ThreadPool {
+public:
+	// numThreads <= 0 means one thread per hardware thread.  The calling thread
+	// takes part in every batch, so numThreads - 1 threads are spawned.
+	//
+	explicit ThreadPool(int numThreads = 0);
+	~ThreadPool();
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+	
+	int size() const { return int(queues.size()); }
+	
+	// Calls task(index, thread) for every index in [0, count) and returns once
+	// they have all finished.  thread is in [0, size()) and identifies the
+	// worker running the task, for per-thread scratch data.  Only one batch
+	// runs at a time; don't call this from two threads at once.
+	//
+	void parallelFor(int count, const std::function<void(int, int)> &task);
+	
+	static int hardwareThreads();
+	
+private:
+	struct Queue {
+		std::mutex lock;
+		std::deque<int> indices;
+	};
+	
+	bool pop(int thread, int &index);
+	bool steal(int thread, int &index);
+	void runTasks(int thread);
+	void workerLoop(int thread);
+	
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> threads;
+	
+	std::mutex batchLock;
+	std::condition_variable batchStarted;
+	std::condition_variable batchFinished;
+	const std::function<void(int, int)> *task = nullptr;
+	std::atomic<int> remaining;
+	unsigned batch = 0;
+	bool quit = false;
+};
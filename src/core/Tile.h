@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+//  Rectangular block of pixels [x0, x1) x [y0, y1) in image coordinates
+//  (j counted from the bottom, as the renderer traces them).
+//
+struct Tile {
+	int x0, y0, x1, y1;
+	
+	int width() const { return x1 - x0; }
+	int height() const { return y1 - y0; }
+};
+
+// Splits a width x height image into tiles of at most size x size pixels, in
+// scanline order.
+//
+inline std::vector<Tile> makeTiles(int width, int height, int size) {
+	std::vector<Tile> tiles;
+	for (int y = 0; y < height; y += size) {
+		for (int x = 0; x < width; x += size) {
+			Tile t = { x, y, std::min(x + size, width), std::min(y + size, height) };
+			tiles.push_back(t);
+		}
+	}
+	return tiles;
+}
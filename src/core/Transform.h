@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cmath>
+#include "VecMath.h"
+#include "AABB.h"
+
+//  Affine transform: a 3x3 matrix, kept as its columns x, y and z, then a
+//  translation t.  Points, directions and normals each go through it
+//  differently; normals need the inverse transpose, so they are transformed
+//  with transposeVector() of the inverse.
+//
+struct Transform {
+	glm::vec3 x = glm::vec3(1, 0, 0);
+	glm::vec3 y = glm::vec3(0, 1, 0);
+	glm::vec3 z = glm::vec3(0, 0, 1);
+	glm::vec3 t = glm::vec3(0);
+	
+	glm::vec3 point(const glm::vec3 &p) const { return x * p.x + y * p.y + z * p.z + t; }
+	glm::vec3 vector(const glm::vec3 &v) const { return x * v.x + y * v.y + z * v.z; }
+	glm::vec3 transposeVector(const glm::vec3 &v) const { return glm::vec3(glm::dot(x, v), glm::dot(y, v), glm::dot(z, v)); }
+	
+	Transform operator*(const Transform &b) const;    // b, then this
+	Transform inverse() const;                         // all zero if there is none
+	AABB bounds(const AABB &box) const;                // of the transformed box
+	
+	static Transform translate(const glm::vec3 &v);
+	static Transform scale(const glm::vec3 &s);
+	static Transform rotate(float radians, const glm::vec3 &axis);
+};
+
+//--------------------------------------------------------------
+inline Transform Transform::operator*(const Transform &b) const {
+	Transform c;
+	c.x = vector(b.x);
+	c.y = vector(b.y);
+	c.z = vector(b.z);
+	c.t = point(b.t);
+	return c;
+}
+
+// The rows of the inverse of a 3x3 matrix are the cross products of its
+// columns, over the determinant
+//
+//--------------------------------------------------------------
+inline Transform Transform::inverse() const {
+	glm::vec3 r0 = glm::cross(y, z), r1 = glm::cross(z, x), r2 = glm::cross(x, y);
+	float det = glm::dot(x, r0);
+	Transform inv;
+	if (det == 0) {
+		inv.x = inv.y = inv.z = glm::vec3(0);
+		return inv;
+	}
+	r0 /= det; r1 /= det; r2 /= det;
+	inv.x = glm::vec3(r0.x, r1.x, r2.x);
+	inv.y = glm::vec3(r0.y, r1.y, r2.y);
+	inv.z = glm::vec3(r0.z, r1.z, r2.z);
+	inv.t = -inv.vector(t);
+	return inv;
+}
+
+// Arvo's method: each column stretches the box along one axis, by whichever
+// of its ends gives the lower and the higher value
+//
+//--------------------------------------------------------------
+inline AABB Transform::bounds(const AABB &box) const {
+	if (box.empty()) return box;
+	AABB out(t, t);
+	const glm::vec3 *column[3] = { &x, &y, &z };
+	for (int a = 0; a < 3; a++) {
+		glm::vec3 lo = *column[a] * box.min[a], hi = *column[a] * box.max[a];
+		out.min += glm::min(lo, hi);
+		out.max += glm::max(lo, hi);
+	}
+	return out;
+}
+
+//--------------------------------------------------------------
+inline Transform Transform::translate(const glm::vec3 &v) {
+	Transform m;
+	m.t = v;
+	return m;
+}
+
+//--------------------------------------------------------------
+inline Transform Transform::scale(const glm::vec3 &s) {
+	Transform m;
+	m.x.x = s.x;
+	m.y.y = s.y;
+	m.z.z = s.z;
+	return m;
+}
+
+// Counterclockwise seen from the tip of axis (Rodrigues' formula)
+//
+//--------------------------------------------------------------
+inline Transform Transform::rotate(float radians, const glm::vec3 &axis) {
+	glm::vec3 a = glm::normalize(axis);
+	float c = std::cos(radians), s = std::sin(radians);
+	Transform m;
+	m.x = a * (a.x * (1 - c)) + glm::vec3(c, a.z * s, -a.y * s);
+	m.y = a * (a.y * (1 - c)) + glm::vec3(-a.z * s, c, a.x * s);
+	m.z = a * (a.z * (1 - c)) + glm::vec3(a.y * s, -a.x * s, c);
+	return m;
+}
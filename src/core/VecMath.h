@@ -0,0 +1,19 @@
+//
+//  Vector math used by the tracing core.
+//
+//  openFrameworks configures glm before including it (zero-initialised vectors
+//  and the gtx extensions).  The core does not include ofMain.h, so it applies
+//  the same configuration here; every core header includes this file rather
+//  than including glm directly so that the app and the headless build agree.
+//
+#pragma once
+
+#ifndef GLM_FORCE_CTOR_INIT
+#define GLM_FORCE_CTOR_INIT
+#endif
+#ifndef GLM_ENABLE_EXPERIMENTAL
+#define GLM_ENABLE_EXPERIMENTAL
+#endif
+
+#include <glm/glm.hpp>
+#include <glm/gtx/intersect.hpp>
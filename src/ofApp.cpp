@@ -5,6 +5,10 @@
 
 #include "ofApp.h"
 
+static ofColor toOfColor(const Color &c) {
+	return ofColor(c.r, c.g, c.b);
+}
+
 //--------------------------------------------------------------
 void ofApp::setup(){
 	ofSetBackgroundColor(ofColor::black);
@@ -14,6 +18,9 @@ void ofApp::setup(){
 	gui.add(intensityParam.set("Intensity", 0.85, 0, 1));
 	intensityParam.addListener(this, &ofApp::onIntensityChanged);
 	gui.add(pSlider.setup("Power", 30, 10, 10000));
+	gui.add(aaSlider.setup("Antialiasing", 4, 1, 8));
+	gui.add(aaThresholdSlider.setup("AA threshold", 0.04, 0, 0.5));
+	gui.add(shadowToggle.setup("Shadows", true));
 	
 	bHide = false;
 	mainCam.setDistance(15);
@@ -25,22 +32,25 @@ void ofApp::setup(){
 	previewCam.setPosition(0, 0, 15);
 	previewCam.lookAt(glm::vec3(0, 0, -1));
 	
-	scene.push_back(new Plane(glm::vec3(0, -2, 0), glm::vec3(0, 1, 0), ofColor::darkOrchid));
-	shapeCount += 1; // TODO: Make createShape() versatile enough to accommodate planes
-//	createShape(glm::vec3(0.0, 0.0, 2.0), 2.0, ofColor(0, 0, 0));
-//	createShape(glm::vec3(2.0, 0.0, 0.0), 1.75, ofColor(1, 1, 1));
-	createShape(glm::vec3(0.0, 0.0, 2.0), 2.0, ofColor::orangeRed);
-	createShape(glm::vec3(2.0, 0.0, 0.0), 1.75, ofColor::cornflowerBlue);
-	createShape(glm::vec3(-3.0, 0.0, -1.5), 1.5, ofColor::paleGreen);
-	createLight(glm::vec3(5, -1, -3), 0.25, 0.4, ofColor::white);
-	createLight(glm::vec3(-2, 5, 6), 0.1, 0.8, ofColor::white);
-	
-	ofImage texture1, texture2;
-	texture1.load("texture1.jpeg");
-	texture2.load("texture2.jpeg");
-	textures.push_back(texture1);
-	textures.push_back(texture2);
-
+	planePrimitive.rotateDeg(90, 1, 0, 0);
+	
+	buildDefaultScene(scene);
+	scene.rebuildAccel();
+	shapeCount = scene.objects.size();
+	lightCount = scene.lights.size();
+	
+	// Textures are decoded by ofImage and handed to the core as RGB pixels.
+	// Press 't' to put them on the selected object.
+	//
+	const char *textureFiles[] = { "texture1.jpeg", "texture2.jpeg" };
+	for (const char *file : textureFiles) {
+		ofImage texture;
+		if (!texture.load(file)) continue;
+		texture.setImageType(OF_IMAGE_COLOR);
+		Image img;
+		img.setFromPixels(texture.getPixels().getData(), texture.getWidth(), texture.getHeight());
+		scene.textures.add(img, file);
+	}
 }
 
 //--------------------------------------------------------------
@@ -56,6 +66,8 @@ void ofApp::update(){
 		intensityParam = selectedObj->getIntensity();
 	}
 	settingIntensity = false;
+	
+	if (bPreview) updatePreview();
 }
 
 //--------------------------------------------------------------
@@ -64,11 +76,11 @@ void ofApp::draw(){
 	theCam->begin();
 	
 	ofNoFill();
-	for (vector<SceneObject *>::iterator i = scene.begin(); i != scene.end(); ++i) {
-		(*i)->draw();
+	for (vector<SceneObject *>::iterator i = scene.objects.begin(); i != scene.objects.end(); ++i) {
+		drawObject(*i);
 	}
-	for (vector<Light *>::iterator i = lights.begin(); i != lights.end(); ++i) {
-		(*i)->draw();
+	for (vector<Light *>::iterator i = scene.lights.begin(); i != scene.lights.end(); ++i) {
+		drawObject(*i);
 	}
 	
 	for (int j = 0; j < renderCam.view.height(); j++) {
@@ -77,21 +89,91 @@ void ofApp::draw(){
 			float v = (j + 0.5) / renderCam.view.height();
 			Ray ray = renderCam.getRay(u, v);
 			ofSetColor(ofColor::blue);
-			if (bMouseDown) ray.draw(100);
+			if (bMouseDown) ofDrawLine(ray.p, ray.evalPoint(100));
 		}
 	}
 	
 	drawGrid(); // Slow if image size is greater than 6px by 4px
 	
 	mainCam.draw();
-	renderCam.draw();
-	renderCam.view.draw();
+	ofSetColor(ofColor::white);
+	ofNoFill();
+	ofDrawBox(renderCam.position, 1.0);
+	glm::vec3 corners[4] = { renderCam.toWorld(0, 0), renderCam.toWorld(1, 0), renderCam.toWorld(1, 1), renderCam.toWorld(0, 1) };
+	for (int k = 0; k < 4; k++) ofDrawLine(corners[k], corners[(k + 1) % 4]);
 	
 	theCam->end();
 	
+	if (bPreview && previewImage.isAllocated()) {
+		float w = ofGetWidth() / 3.0f;
+		float h = w * previewImage.getHeight() / previewImage.getWidth();
+		ofSetColor(ofColor::white);
+		previewTexture.draw(ofGetWidth() - w - 10, ofGetHeight() - h - 10, w, h);
+	}
+	
 	//    image.draw(0, 0);
 }
 
+// Restarts the preview when the render camera or the settings it uses have
+// changed.  After edits to the scene it only traces again the tiles that the
+// edited objects covered, shadowed or lit, before or after the edit.
+//
+//--------------------------------------------------------------
+void ofApp::updatePreview() {
+	Renderer &r = preview.renderer;
+	float power = pSlider;
+	bool shadows = shadowToggle;
+	int aa = aaSlider;
+	int width = 600;
+	int height = int(width / renderCam.view.getAspect() + 0.5f);
+	if (preview.cameraChanged(renderCam) || r.power != power || r.shadows != shadows ||
+		preview.maxSamples != aa * aa || preview.width != width || preview.height != height) {
+		r.power = power;
+		r.shadows = shadows;
+		preview.maxSamples = aa * aa;
+		preview.width = width;
+		preview.height = height;
+		preview.start(renderCam);
+		previewDirty = false;
+		edited.clear();
+	}
+	else if (previewDirty) {
+		preview.stop();
+		for (size_t i = 0; i < edited.size(); i++) {
+			SceneObject *o = scene.get(edited[i]);    // NULL if it has since been deleted
+			if (o) preview.invalidate(o);
+		}
+		preview.resume();
+		previewDirty = false;
+		edited.clear();
+	}
+	
+	if (preview.fetch(previewImage)) {
+		int w = previewImage.getWidth(), h = previewImage.getHeight();
+		if (!previewTexture.isAllocated() || previewTexture.getWidth() != w || previewTexture.getHeight() != h) {
+			previewTexture.allocate(w, h, GL_RGB);
+		}
+		previewTexture.loadData(previewImage.getPixels(), w, h, GL_RGB);
+	}
+}
+
+// Call before changing o, or right after adding it.  The preview reads meshes
+// and textures while it traces, so it is stopped here; the tiles showing o as
+// it is now are marked for tracing again, and those showing it after the edit
+// are marked by the next update(), which resumes the preview.  NULL means
+// everything may have changed.
+//
+//--------------------------------------------------------------
+void ofApp::editScene(SceneObject *o) {
+	preview.stop();
+	if (o) {
+		preview.invalidate(o);
+		if (std::find(edited.begin(), edited.end(), o->handle) == edited.end()) edited.push_back(o->handle);
+	}
+	else preview.invalidateAll();
+	previewDirty = true;
+}
+
 //--------------------------------------------------------------
 void ofApp::keyPressed(int key){
 	switch (key) {
@@ -131,12 +213,28 @@ void ofApp::keyReleased(int key){
 		case 'l':
 			createLight();
 			break;
+		case 'p':
+			bPreview = !bPreview;
+			if (!bPreview) preview.stop();
+			else previewDirty = true;    // resumed by the next updatePreview(), where it stopped
+			break;
+		case 'w':
+			saveScene();
+			break;
 		case 'r':
 			rayTrace();
 			break;
 		case 's':
 			createShape();
 			break;
+		case 't':
+			if (selectedObj) cycleTexture(selectedObj);
+			break;
+		case 'v':
+			// render from where mainCam is looking
+			renderCam.lookAt(mainCam.getPosition(), mainCam.getPosition() + mainCam.getLookAtDir(), mainCam.getUpDir());
+			renderCam.setFov(mainCam.getFov());
+			break;
 		case OF_KEY_F1:
 			theCam = &mainCam;
 			break;
@@ -163,10 +261,12 @@ void ofApp::mouseMoved(int x, int y){
 //--------------------------------------------------------------
 void ofApp::mouseDragged(int x, int y, int button){
 	if (selectedObj && bDrag) {
+		editScene(selectedObj);
 		glm::vec3 point;
 		mouseToWorld(x, y, point);
 		selectedObj->position += (point - lastPoint);
 		lastPoint = point;
+		scene.refitAccel();
 	}
 }
 
@@ -190,57 +290,16 @@ void ofApp::mousePressed(int x, int y, int button){
 	bMouseDown = true;
 	
 	//
-	// test if something selected
+	// test if something selected; the scene returns the nearest object or
+	// light along the ray
 	//
-	vector<SceneObject *> selected;
-	
 	glm::vec3 p = theCam->screenToWorld(glm::vec3(x, y, 0));
 	glm::vec3 d = p - theCam->getPosition();
 	glm::vec3 dn = glm::normalize(d);
 	
-	// Check for selection of scene objects
-	//
-	for (int i = 0; i < scene.size(); i++) {
-		
-		glm::vec3 point, norm;
-		
-		//  We hit a non-light object
-		//
-		if (scene[i]->intersect(Ray(p, dn), point, norm)) {
-			selected.push_back(scene[i]);
-			selectedObj = scene[i];
-		}
-	}
-	
-	for (int i = 0; i < lights.size(); i++) {
-		
-		glm::vec3 point, norm;
-		
-		//  We hit a light
-		//
-		if (lights[i]->intersect(Ray(p, dn), point, norm)) {
-			selected.push_back(lights[i]);
-			selectedObj = lights[i];
-		}
-	}
+	selectedObj = scene.pick(Ray(p, dn));
 	
-	// if we selected more than one, pick nearest
-	//
-	if (selected.size() > 1) {
-		float nearestDist = std::numeric_limits<float>::infinity();
-		SceneObject *nearestObj = NULL;
-		for (int n = 0; n < selected.size(); n++) {
-			float dist = glm::length(selected[n]->position - theCam->getPosition());
-			if (dist < nearestDist) {
-				nearestDist = dist;
-				selectedObj = selected[n];
-			}
-		}
-	}
-	if (selected.size() == 0) {
-		selectedObj = NULL;
-	}
-	else { // An object is selected
+	if (selectedObj != NULL) { // An object is selected
 		bDrag = true;
 		// If selected object has radius attribute, reflect in slider
 		if (selectedObj->getRadius() != -1) {
@@ -280,116 +339,62 @@ void ofApp::gotMessage(ofMessage msg){
 	
 }
 
+// Dropping .obj or .ply files on the window adds them to the scene as meshes;
+// dropping a scene file (.scene or .txt) replaces the scene
+//
 //--------------------------------------------------------------
 void ofApp::dragEvent(ofDragInfo dragInfo){
-	
-}
-
-//--------------------------------------------------------------
-void ofApp::rayTrace() {
-	image.allocate(imageWidth, imageHeight, OF_IMAGE_COLOR);
-	for (int j = 0; j < imageHeight; j++) {
-		for (int i = 0; i < imageWidth; i++) {
-			float u = (float(i) + 0.5) / float(imageWidth);
-			float v = (float(j) + 0.5) / float(imageHeight);
-			
-			Ray ray = renderCam.getRay(u, v);
-			
-			glm::vec3 intersection, normal;
-			bool hit = false;
-			int nearestObj = -1;
-			
-			// initialize to a very big number
-			float nearestDist = std::numeric_limits<float>::infinity();
-			
-			for (int n = 0; n < scene.size(); n++) {
-				if (scene[n]->intersect(ray, intersection, normal)) {
-					float dist = glm::length(intersection - renderCam.position);
-					
-					if (dist < nearestDist) {
-						nearestDist = dist;
-						nearestObj = n;
-					}
-					hit = true;
-				}
-			}
-			
-			// Set the color of the pixel to the nearest object's pixel
-			// if we didn't hit anything, set it the bg color.
-			// "Unflip" image by adjust in the "j" direction.
-			if (!hit) {
-				image.setColor(i, imageHeight - j - 1, ofColor::black);
-			}
-			else {
-				// If the nearest object is the first one, i.e. the plane, use Phong shading
-				if (nearestObj == 0) {
-					ofColor phongColor = phong(intersection, normal, scene[nearestObj]->diffuseColor, ofColor::white, pSlider);
-					image.setColor(i, imageHeight - j - 1, phongColor);
-				}
-				// Otherwise use texture mapping
-				else {
-					ofColor phongTexture;
-					phongTexture = phong(intersection, normal, textureLookup(textures[int((scene[nearestObj]->diffuseColor).r)], u, v), ofColor::white, pSlider); // only works for two spheres for now
-					image.setColor(i, imageHeight - j - 1, phongTexture);
-				}
+	for (size_t i = 0; i < dragInfo.files.size(); i++) {
+		const std::string &file = dragInfo.files[i];
+		std::string ext = ofToLower(ofFilePath::getFileExt(file));
+		std::string error;
+		if (ext == "scene" || ext == "txt") {
+			editScene(NULL);
+			if (loadScene(scene, renderCam, file, &error)) {
+				edited.clear();    // those objects are gone
+				selectedObj = NULL;
+				shapeCount = scene.objects.size();
+				lightCount = scene.lights.size();
 			}
+			else ofLogError("ofApp") << error;
+			continue;
 		}
+		Mesh *mesh = scene.addMesh(file, glm::vec3(0, 0, 0), Color::grey, &error);
+		if (mesh) editScene(mesh);
+		else ofLogError("ofApp") << error;
 	}
-	image.save("out.png");
+	scene.rebuildAccel();
 }
 
-/** ANTIALIASING RAY TRACE */
-////--------------------------------------------------------------
-//void ofApp::rayTrace() {
-//	image.allocate(imageWidth, imageHeight, OF_IMAGE_COLOR);
-//	int samples = 4;
-//	for (int j = 0; j < imageHeight; j++) {
-//		for (int i = 0; i < imageWidth; i++) {
-//			ofColor antialiased = ofColor(0.0f, 0.0f, 0.0f);
-//			for (int p = 0; p < samples; p++) {
-//				for (int q = 0; q < samples; q++) {
-//					float u = (float(i) + (p + randomEpsilon()) / float(samples)) / float(imageWidth);
-//					float v = (float(j) + (q + randomEpsilon()) / float(samples)) / float(imageHeight);
-//					Ray ray = renderCam.getRay(u, v);
-//
-//					glm::vec3 intersection, normal;
-//					bool hit = false;
-//					int nearestObj = -1;
-//
-//					// initialize to a very big number
-//					float nearestDist = std::numeric_limits<float>::infinity();
-//
-//					for (int n = 0; n < scene.size(); n++) {
-//						if (scene[n]->intersect(ray, intersection, normal)) {
-//							float dist = glm::length(intersection - renderCam.position);
+// Writes the scene as text to bin/data/scene.txt; drop it back on the window
+// to load it
 //
-//							if (dist < nearestDist) {
-//								nearestDist = dist;
-//								nearestObj = n;
-//							}
-//							hit = true;
-//						}
-//					}
-//
-//					// Set the color of the pixel to the nearest object's pixel
-//					// if we didn't hit anything, set it the bg color.
-//					// "Unflip" image by adjust in the "j" direction.
-//					if (!hit) {
-////						image.setColor(i, imageHeight - j - 1, ofColor::black);
-//						antialiased = ofColor::black;
-//					}
-//					else {
-//						//	ofColor lambertColor = lambert(intersection, normal, scene[nearestObj]->diffuseColor);
-//						ofColor phongColor = phong(intersection, normal, scene[nearestObj]->diffuseColor, ofColor::white, pSlider);
-//						antialiased += phongColor / (samples * samples);
-//					}
-//				}
-//			}
-//			image.setColor(i, imageHeight - j - 1, antialiased);
-//		}
-//	}
-//	image.save("out.png");
-//}
+//--------------------------------------------------------------
+void ofApp::saveScene() {
+	std::string error;
+	if (::saveScene(scene, renderCam, ofToDataPath("scene.txt"), &error)) ofLogNotice("ofApp") << "saved scene.txt";
+	else ofLogError("ofApp") << error;
+}
+
+//--------------------------------------------------------------
+void ofApp::rayTrace() {
+	Renderer renderer(scene, renderCam);
+	renderer.imageWidth = imageWidth;
+	renderer.imageHeight = imageHeight;
+	renderer.power = pSlider;
+	renderer.antialias = aaSlider;
+	renderer.aaThreshold = aaThresholdSlider;
+	renderer.shadows = shadowToggle;
+	
+	Image output;
+	renderer.render(output);
+	image.setFromPixels(output.getPixels(), imageWidth, imageHeight, OF_IMAGE_COLOR);
+	image.save("out.png");
+#ifdef RAYTRACER_STATS
+	renderer.stats.save(ofToDataPath("out"));
+#endif
+	ofLogNotice("ofApp") << "rendered with " << renderer.samplesPerPixel << " samples per pixel";
+}
 
 //--------------------------------------------------------------
 void ofApp::drawGrid() {
@@ -397,8 +402,8 @@ void ofApp::drawGrid() {
 	int viewWidth = renderCam.view.width();
 	while (f < viewWidth) {
 		ofSetColor(ofColor::white);
-		glm::vec3 p1 = glm::vec3(renderCam.view.min.x + f, renderCam.view.min.y, 5);
-		glm::vec3 p2 = glm::vec3(renderCam.view.min.x + f, renderCam.view.max.y, 5);
+		glm::vec3 p1 = renderCam.toWorld(f / viewWidth, 0);
+		glm::vec3 p2 = renderCam.toWorld(f / viewWidth, 1);
 		ofDrawLine(p1, p2);
 		f += viewWidth / imageWidth;
 	}
@@ -407,8 +412,8 @@ void ofApp::drawGrid() {
 	int viewHeight = renderCam.view.height();
 	while (g < viewHeight) {
 		ofSetColor(ofColor::white);
-		glm::vec3 p1 = glm::vec3(renderCam.view.min.x, renderCam.view.min.y + g, 5);
-		glm::vec3 p2 = glm::vec3(renderCam.view.max.x, renderCam.view.min.y + g, 5);
+		glm::vec3 p1 = renderCam.toWorld(0, g / viewHeight);
+		glm::vec3 p2 = renderCam.toWorld(1, g / viewHeight);
 		ofDrawLine(p1, p2);
 		g += viewWidth / imageWidth;
 	}
@@ -437,78 +442,17 @@ void ofApp::drawAxis(glm::vec3 position) {
 	ofPopMatrix();
 }
 
-// Intersect Ray with Plane  (wrapper on glm::intersect*
-//
-bool Plane::intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normalAtIntersect) {
-	float dist;
-	bool hit = glm::intersectRayPlane(ray.p, ray.d, position, this->normal, dist);
-	if (hit) {
-		// Set output variables
-		Ray r = ray;
-		point = r.evalPoint(dist);
-		normalAtIntersect = this->normal;
-		// If ray hits plane, determine if intersection is within bounds of the plane
-		glm::vec2 xBounds = glm::vec2(position.x - width * 0.5, position.x + width * 0.5);
-		glm::vec2 zBounds = glm::vec2(position.z - height * 0.5, position.z + height * 0.5);
-		if (point.x < xBounds[1] && point.x > xBounds[0] && point.z < zBounds[1] && point.z > zBounds[0]) {
-			return true;
-		}
-	}
-	return false;
-}
-
-// Convert (u, v) to (x, y, z)
-// We assume u,v is in [0, 1]
-//
-glm::vec3 ViewPlane::toWorld(float u, float v) {
-	float w = width();
-	float h = height();
-	return (glm::vec3((u * w) + min.x, (v * h) + min.y, position.z));
-}
-
-// Get a ray from the current camera position to the (u, v) position on
-// the ViewPlane
-//
-Ray RenderCam::getRay(float u, float v) {
-	glm::vec3 pointOnPlane = view.toWorld(u, v);
-	return(Ray(position, glm::normalize(pointOnPlane - position)));
-}
-
-//--------------------------------------------------------------
-ofColor ofApp::lambert(SceneObject* light, const glm::vec3 &p, const glm::vec3 &norm, const ofColor diffuse) {
-	glm::vec3 l, n;
-	n = glm::normalize(norm);
-	float dot, intensity;
-	l = glm::normalize(light->position - p);
-	dot = glm::dot(n, l);
-	intensity = light->intensity;
-	return diffuse * intensity * glm::max(0.0f, dot);
-}
-
-//--------------------------------------------------------------
-ofColor ofApp::phong(const glm::vec3 &p, const glm::vec3 &norm, const ofColor diffuse, const ofColor specular, float power) {
-	ofColor shadedColor = ofColor(0, 0, 0);
-	glm::vec3 l, v, h, n;
-	n = glm::normalize(norm);
-	float dot, intensity;
-	for (int i = 0; i < lights.size(); i++) {
-		l = glm::normalize(lights[i]->position - p);
-		v = glm::normalize(renderCam.position - p);
-		h = glm::normalize(v + l);
-		dot = glm::dot(n, h);
-		shadedColor += lambert(lights[i], p, norm, diffuse); // lambert shading
-		shadedColor += specular * lights[i]->intensity * glm::pow(glm::max(0.0f, dot), power); // blinn-phong
-	}
-	return shadedColor;
-}
-
 // Listens to radius change on slider and updates selected object radius accordingly
 //
 //--------------------------------------------------------------
 void ofApp::onRadiusChanged(float &r) {
 	if (settingRadius) return; // If the radius is being changed, return
 	else {
-		if (selectedObj != NULL) selectedObj->setRadius(r);
+		if (selectedObj != NULL) {
+			editScene(selectedObj);
+			selectedObj->setRadius(r);
+			scene.refitAccel();
+		}
 	}
 }
 
@@ -518,84 +462,80 @@ void ofApp::onRadiusChanged(float &r) {
 void ofApp::onIntensityChanged(float &i) {
 	if (settingIntensity) return; // If the intensity is being changed, return
 	else {
-		if (selectedObj != NULL) selectedObj->setIntensity(i);
+		if (selectedObj != NULL) {
+			editScene(selectedObj);
+			selectedObj->setIntensity(i);
+		}
 	}
 }
 
 //--------------------------------------------------------------
 void ofApp::createShape() {
-	scene.push_back(new Sphere(glm::vec3(0, 0, 0), 1.0, ofColor::darkGoldenRod, scene.size()));
+	editScene(scene.addSphere(glm::vec3(0, 0, 0), 1.0, Color::darkGoldenRod));
 	shapeCount += 1;
 }
 
 //--------------------------------------------------------------
-void ofApp::createShape(glm::vec3 p, float r, ofColor d) {
-	scene.push_back(new Sphere(p, r, d, scene.size()));
+void ofApp::createShape(glm::vec3 p, float r, Color d) {
+	editScene(scene.addSphere(p, r, d));
 	shapeCount += 1;
 }
 
 //--------------------------------------------------------------
 void ofApp::createLight() {
-	lights.push_back(new Light(glm::vec3(0, 5, 0), 0.2, 0.85, ofColor::white, lights.size()));
+	editScene(scene.addLight(glm::vec3(0, 5, 0), 0.2, 0.85, Color::white));
 	lightCount += 1;
 }
 
 //--------------------------------------------------------------
-void ofApp::createLight(glm::vec3 p, float r, float i, ofColor d) {
-	lights.push_back(new Light(p, r, i, d, lights.size()));
+void ofApp::createLight(glm::vec3 p, float r, float i, Color d) {
+	editScene(scene.addLight(p, r, i, d));
 	lightCount += 1;
 }
 
+// Steps the object through the scene's textures and back to no texture
+//
+//--------------------------------------------------------------
+void ofApp::cycleTexture(SceneObject *o) {
+	editScene(o);
+	int next = o->texture.index + 1;
+	o->texture = next < int(scene.textures.size()) ? scene.textures.handle(next) : TextureHandle();
+}
+
 //--------------------------------------------------------------
 void ofApp::deleteObject(SceneObject *o) {
-	bool isLight = false;
-	// Cheap way of determining whether selected object is a light or a shape
-	if (o->getIntensity() != -1) {
-		isLight = true;
-	}
-	
-	// If selected object is a light, delete it from the light vector
-	if (isLight) {
-		// Update ordinality of all lights after the light to be deleted
-		for (int i = o->ordinality + 1; i < lights.size(); i++) {
-			lights[i]->ordinality -= 1;
-		}
-		
-		// Remove the selected light from the list of lights
-		lights.erase(lights.begin() + o->ordinality);
-	}
-	// Otherwise, selected object is a shape; delete it from the scene vector
-	else {
-		// Update ordinality of all shapes after the shape to be deleted
-		for (int i = o->ordinality + 1; i < scene.size(); i++) {
-			scene[i]->ordinality -= 1;
-		}
-		// Remove the selected shape from the list of shapes
-		scene.erase(scene.begin() + o->ordinality);
-	}
+	editScene(o);
+	scene.remove(o);    // destroys it; its handle in edited goes stale
 	
 	// Clear selection
 	selectedObj = NULL;
 }
 
-// Returns a random uniform number in the range [0, 1)
+// Draws a scene object in the viewport.  The core classes have no GL
+// dependency, so drawing lives here rather than on the objects.
 //
 //--------------------------------------------------------------
-float ofApp::randomEpsilon() {
-	float epsilon = 0.001;
-	int max = 999;
-	int min = 0;
-	int random = rand() % (max - min + 1); // Generates random number between 0 and 99
-	epsilon *= random; // Brings random number into range of [0, 1)
-	return epsilon;
-}
-
-
-// Converts texture coordinates (u, v) to the color at texel coordinates (i, j)
-//
-//--------------------------------------------------------------
-ofColor ofApp::textureLookup(ofImage img, float u, float v) {
-	int i = int(u * img.getWidth() - 0.5);
-	int j = int(v * img.getHeight() - 0.5);
-	return img.getColor(i % int(img.getWidth()), j % int(img.getHeight()));
+void ofApp::drawObject(SceneObject *o) {
+	ofSetColor(toOfColor(o->diffuseColor));
+	if (Plane *plane = dynamic_cast<Plane *>(o)) {
+		planePrimitive.setPosition(plane->position);
+		planePrimitive.setWidth(plane->width);
+		planePrimitive.setHeight(plane->height);
+		planePrimitive.setResolution(4, 4);
+		planePrimitive.drawWireframe();
+	}
+	else if (Sphere *sphere = dynamic_cast<Sphere *>(o)) {
+		ofDrawSphere(sphere->position, sphere->getRadius());
+	}
+	else if (Mesh *mesh = dynamic_cast<Mesh *>(o)) {
+		// meshes can be far too big to draw every frame; show their bounds
+		AABB box;
+		if (mesh->getBounds(box)) {
+			glm::vec3 size = box.extent();
+			ofPushStyle();
+			ofNoFill();
+			ofDrawBox(box.center(), size.x, size.y, size.z);
+			ofPopStyle();
+		}
+	}
 }